@@ -0,0 +1,355 @@
+// @desc     Host-native benchmark of the kernel heap and ordered arrays (built with 'make bench', not part of the kernel)
+// @author   Davide Della Giustina
+// @date     19/10/2026
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/mman.h>
+
+// The kernel sources are compiled with the memory primitives renamed (see the makefile), so that they do not clash with the C library
+#define memcpy k_memcpy
+#define memset k_memset
+#include "../kernel/heap.h"
+#include "../data_structures/ordered_array.h"
+
+#define BENCH_REGION        ((void *)0x40000000) // Backing region (below 4GB, since the heap stores addresses in 32 bits)
+#define BENCH_REGION_SIZE   0x4000000
+#define BENCH_HEAP_INITIAL  0x100000
+#define BENCH_SLOTS         4096 // Maximum number of live allocations
+#define BENCH_OPS           200000 // Default number of operations per trace
+#define BENCH_ARRAY_SIZE    4096 // Maximum number of elements in the ordered array
+
+#define OP_ALLOC            0
+#define OP_ALLOC_ALIGNED    1
+#define OP_FREE             2
+#define OP_REALLOC          3
+
+// Operation of a trace
+typedef struct {
+    uint8_t type;
+    uint32_t slot; // Slot holding the pointer
+    uint32_t size;
+} bench_op_t;
+
+// Result of a trace
+typedef struct {
+    double ops_per_sec;
+    uint64_t p50, p90, p99, max; // Latencies (in ns)
+    uint32_t heap_size; // Heap size at the peak of the live set
+    uint32_t live_bytes; // Requested bytes live at the peak
+    uint32_t hole_bytes, largest_hole; // Holes at the peak
+} bench_result_t;
+
+extern heap_t *kernel_heap;
+void abort(void);
+void qsort(void *base, size_t n, size_t size, int (*cmp)(const void *, const void *));
+int atoi(const char *str);
+
+bench_op_t ops[BENCH_OPS * 2];
+uint64_t latencies[BENCH_OPS * 2];
+void *slots[BENCH_SLOTS];
+uint32_t slot_sizes[BENCH_SLOTS];
+uint32_t rng_state = 1;
+
+// Private functions
+
+static uint32_t rng();
+static uint32_t random_size();
+static uint32_t gen_random(uint32_t nops, uint8_t aligned);
+static uint32_t gen_lifo(uint32_t nops);
+static uint32_t gen_fifo(uint32_t nops);
+static uint32_t gen_realloc(uint32_t nops);
+static uint64_t now_ns();
+static heap_t *fresh_heap();
+static void replay(uint32_t nops, uint8_t timed, bench_result_t *result);
+static void run_trace(char *name, uint32_t nops);
+static void bench_ordered_array(uint32_t nops);
+static int compare_u64(const void *a, const void *b);
+static void print_latencies(char *name, uint32_t nops, double ops_per_sec, uint64_t *lat);
+
+/* Run every trace and print a report.
+ * Usage: heap_bench [operations per trace] [seed]
+ */
+int main(int argc, char **argv) {
+    uint32_t nops = (argc > 1)? (uint32_t)atoi(argv[1]) : BENCH_OPS;
+    uint32_t seed = (argc > 2)? (uint32_t)atoi(argv[2]) : 1;
+    if (nops == 0 || nops > BENCH_OPS) nops = BENCH_OPS;
+    if (mmap(BENCH_REGION, BENCH_REGION_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0) != BENCH_REGION) {
+        printf("Cannot map the backing region at %p\n", BENCH_REGION);
+        return 1;
+    }
+    printf("Block layout: %u-bit pointers%s\n\n", (unsigned)(8 * sizeof(void *)),
+        (sizeof(void *) == 4)? "" : " (not the layout of the i386 kernel heap: build with HOST_ARCH=-m32)");
+    printf("%-12s %8s %9s %7s %7s %7s %8s %9s %9s %6s %6s\n", "trace", "ops", "Mops/s", "p50 ns", "p90 ns", "p99 ns", "max ns", "heap KB", "live KB", "frag", "util");
+    rng_state = seed;
+    run_trace("random", gen_random(nops, 0));
+    rng_state = seed;
+    run_trace("lifo", gen_lifo(nops));
+    rng_state = seed;
+    run_trace("fifo", gen_fifo(nops));
+    rng_state = seed;
+    run_trace("page-mix", gen_random(nops, 1));
+    rng_state = seed;
+    run_trace("realloc", gen_realloc(nops));
+    rng_state = seed;
+    bench_ordered_array(nops);
+    return 0;
+}
+
+// Kernel functions the heap depends on
+
+void panic(char *msg) {
+    fflush(stdout);
+    fprintf(stderr, "PANIC: %s\n", msg);
+    abort();
+}
+
+void kprint(char *msg) {
+    printf("%s", msg);
+}
+
+void *kpage_alloc(uint32_t npages, physaddr_t *phys) { // Page-aligned kernel allocations are not benchmarked here
+    (void)npages;
+    (void)phys;
+    panic("kpage_alloc() is not available in the benchmark");
+    return NULL;
+}
+
+void kpage_free(void *p) {
+    (void)p;
+}
+
+int is_kpage(void *p) {
+    (void)p;
+    return 0;
+}
+
+uint32_t kpage_size(void *p) {
+    (void)p;
+    return 0;
+}
+
+uint32_t spin_lock_irqsave(spinlock_t *lock) { // Single-threaded: locks cost nothing here
+    (void)lock;
+    return 0;
+}
+
+void spin_unlock_irqrestore(spinlock_t *lock, uint32_t flags) {
+    (void)lock;
+    (void)flags;
+}
+
+// Private functions
+
+/* Generate a pseudo-random number (xorshift), so that traces do not depend on the C library.
+ * @return              Random number.
+ */
+static uint32_t rng() {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+/* Pick an allocation size: mostly small objects, some buffers, a few large areas.
+ * @return              Size (in bytes).
+ */
+static uint32_t random_size() {
+    uint32_t r = rng() % 100;
+    if (r < 70) return 4 + rng() % 60;
+    if (r < 95) return 64 + rng() % 1984;
+    return 2048 + rng() % 30720;
+}
+
+/* Generate a trace of random allocations and frees over a live set of random size.
+ * @param nops          Number of operations.
+ * @param aligned       Make one allocation out of eight page-aligned.
+ * @return              Number of operations generated.
+ */
+static uint32_t gen_random(uint32_t nops, uint8_t aligned) {
+    uint32_t n = 0, i;
+    for (i = 0; i < BENCH_SLOTS; ++i) slot_sizes[i] = 0;
+    while (n < nops) {
+        uint32_t slot = rng() % BENCH_SLOTS;
+        if (slot_sizes[slot]) {
+            ops[n++] = (bench_op_t){ OP_FREE, slot, 0 };
+            slot_sizes[slot] = 0;
+        } else {
+            uint32_t size = random_size();
+            ops[n++] = (bench_op_t){ (aligned && rng() % 8 == 0)? OP_ALLOC_ALIGNED : OP_ALLOC, slot, size };
+            slot_sizes[slot] = size;
+        }
+    }
+    for (i = 0; i < BENCH_SLOTS; ++i) if (slot_sizes[i]) ops[n++] = (bench_op_t){ OP_FREE, i, 0 };
+    return n;
+}
+
+/* Generate a trace of stack-like phases: a burst of allocations, then frees in reverse order.
+ * @param nops          Number of operations.
+ * @return              Number of operations generated.
+ */
+static uint32_t gen_lifo(uint32_t nops) {
+    uint32_t n = 0;
+    while (n < nops) {
+        uint32_t depth = 1 + rng() % (BENCH_SLOTS / 4), i;
+        for (i = 0; i < depth; ++i) ops[n++] = (bench_op_t){ OP_ALLOC, i, random_size() };
+        while (depth > 0) ops[n++] = (bench_op_t){ OP_FREE, --depth, 0 };
+    }
+    return n;
+}
+
+/* Generate a producer-consumer trace: a queue where the oldest allocation is freed first.
+ * @param nops          Number of operations.
+ * @return              Number of operations generated.
+ */
+static uint32_t gen_fifo(uint32_t nops) {
+    uint32_t n = 0, head = 0, tail = 0;
+    uint32_t target = BENCH_SLOTS / 2; // Queue length the producer aims for
+    while (n < nops) {
+        if (tail - head < BENCH_SLOTS && (tail == head || rng() % (2 * target) >= tail - head)) {
+            ops[n++] = (bench_op_t){ OP_ALLOC, tail++ % BENCH_SLOTS, random_size() };
+        } else ops[n++] = (bench_op_t){ OP_FREE, head++ % BENCH_SLOTS, 0 };
+    }
+    while (head != tail) ops[n++] = (bench_op_t){ OP_FREE, head++ % BENCH_SLOTS, 0 };
+    return n;
+}
+
+/* Generate a trace of buffers growing (and sometimes shrinking) through krealloc().
+ * @param nops          Number of operations.
+ * @return              Number of operations generated.
+ */
+static uint32_t gen_realloc(uint32_t nops) {
+    uint32_t n = 0, i;
+    for (i = 0; i < BENCH_SLOTS; ++i) slot_sizes[i] = 0;
+    while (n < nops) {
+        uint32_t slot = rng() % (BENCH_SLOTS / 4);
+        uint32_t r = rng() % 16;
+        if (slot_sizes[slot] && r == 0) {
+            ops[n++] = (bench_op_t){ OP_FREE, slot, 0 };
+            slot_sizes[slot] = 0;
+        } else {
+            uint32_t size = (slot_sizes[slot] && r > 3)? slot_sizes[slot] + slot_sizes[slot] / 2 + 1 : 8 + rng() % 256; // Mostly grow by 1.5x
+            if (size > 16384) size = 8 + rng() % 256;
+            ops[n++] = (bench_op_t){ OP_REALLOC, slot, size };
+            slot_sizes[slot] = size;
+        }
+    }
+    for (i = 0; i < BENCH_SLOTS; ++i) if (slot_sizes[i]) ops[n++] = (bench_op_t){ OP_FREE, i, 0 };
+    return n;
+}
+
+/* Read a monotonic clock.
+ * @return              Time (in ns).
+ */
+static uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/* Create an empty heap over the backing region, and make it the kernel heap (for krealloc()).
+ * @return              Heap.
+ */
+static heap_t *fresh_heap() {
+    char *start = (char *)BENCH_REGION;
+    kernel_heap = create_heap(start, start + BENCH_HEAP_INITIAL, start + BENCH_REGION_SIZE, 1, 0);
+    return kernel_heap;
+}
+
+/* Replay a trace on a fresh heap.
+ * @param nops          Number of operations.
+ * @param timed         Time every operation (into latencies[]) instead of the whole trace.
+ * @param result        Where throughput or fragmentation are stored.
+ */
+static void replay(uint32_t nops, uint8_t timed, bench_result_t *result) {
+    heap_t *heap = fresh_heap();
+    uint32_t i, live = 0, peak = 0;
+    for (i = 0; i < BENCH_SLOTS; ++i) slots[i] = NULL;
+    uint64_t start = now_ns(), t = 0;
+    for (i = 0; i < nops; ++i) {
+        bench_op_t *op = &ops[i];
+        if (timed) t = now_ns(); // Latencies include the cost of reading the clock
+        switch (op->type) {
+            case OP_ALLOC: slots[op->slot] = heap_alloc(heap, op->size, 0); break;
+            case OP_ALLOC_ALIGNED: slots[op->slot] = heap_alloc(heap, op->size, 1); break;
+            case OP_FREE:
+                heap_free(heap, slots[op->slot]);
+                slots[op->slot] = NULL; // The next krealloc() of this slot starts from scratch
+                break;
+            case OP_REALLOC: slots[op->slot] = krealloc(slots[op->slot], op->size); break;
+        }
+        if (timed) {
+            latencies[i] = now_ns() - t;
+            continue;
+        }
+        // Track the live set, to sample fragmentation at its peak
+        if (op->type == OP_FREE) live -= slot_sizes[op->slot];
+        else live += op->size - ((op->type == OP_REALLOC)? slot_sizes[op->slot] : 0);
+        slot_sizes[op->slot] = (op->type == OP_FREE)? 0 : op->size;
+        if (live > peak) {
+            peak = live;
+            result->heap_size = heap->end_addr - heap->start_addr;
+            result->live_bytes = live;
+            result->hole_bytes = heap->stats.hole_bytes;
+            result->largest_hole = largest_hole(heap);
+        }
+    }
+    if (!timed) result->ops_per_sec = nops / ((now_ns() - start) / 1e9);
+}
+
+/* Replay a trace twice (for throughput, then for latencies) and print its results.
+ * @param name          Name of the trace.
+ * @param nops          Number of operations.
+ */
+static void run_trace(char *name, uint32_t nops) {
+    bench_result_t result = { 0 };
+    uint32_t i;
+    for (i = 0; i < BENCH_SLOTS; ++i) slot_sizes[i] = 0;
+    replay(nops, 0, &result);
+    replay(nops, 1, &result);
+    print_latencies(name, nops, result.ops_per_sec, latencies);
+    printf(" %9u %9u %6.3f %6.3f\n", result.heap_size / 1024, result.live_bytes / 1024,
+        (result.hole_bytes)? 1.0 - (double)result.largest_hole / result.hole_bytes : 0.0, // External fragmentation
+        (result.heap_size)? (double)result.live_bytes / result.heap_size : 0.0); // Utilization
+}
+
+/* Benchmark insertions into (and removals from) an ordered array of random keys.
+ * @param nops          Number of operations.
+ */
+static void bench_ordered_array(uint32_t nops) {
+    static type_t storage[BENCH_ARRAY_SIZE + 1]; // One spare element, since removals read past the last one
+    ordered_array_t array = place_ordered_array(storage, BENCH_ARRAY_SIZE, &standard_lessthan_predicate);
+    uint64_t start = now_ns();
+    uint32_t i;
+    for (i = 0; i < nops; ++i) {
+        uint64_t t = now_ns();
+        if (array.size < BENCH_ARRAY_SIZE && (array.size == 0 || rng() % 2)) insert_ordered_array(&array, (type_t)(uintptr_t)rng());
+        else remove_ordered_array(&array, rng() % array.size);
+        latencies[i] = now_ns() - t;
+    }
+    print_latencies("ordered_arr", nops, nops / ((now_ns() - start) / 1e9), latencies);
+    printf("\n");
+}
+
+/* Compare two latencies (for qsort()).
+ * @param a             First latency.
+ * @param b             Second latency.
+ * @return              Negative, zero or positive if #a is less than, equal to or greater than #b.
+ */
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/* Print throughput and latency percentiles of a trace.
+ * @param name          Name of the trace.
+ * @param nops          Number of operations.
+ * @param ops_per_sec   Throughput.
+ * @param lat           Latencies of the operations (sorted in place).
+ */
+static void print_latencies(char *name, uint32_t nops, double ops_per_sec, uint64_t *lat) {
+    qsort(lat, nops, sizeof(uint64_t), &compare_u64);
+    printf("%-12s %8u %9.2f %7lu %7lu %7lu %8lu", name, nops, ops_per_sec / 1e6,
+        (unsigned long)lat[nops / 2], (unsigned long)lat[nops * 9 / 10], (unsigned long)lat[nops * 99 / 100], (unsigned long)lat[nops - 1]);
+}
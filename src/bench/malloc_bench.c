@@ -0,0 +1,97 @@
+// @desc     Host-native microbenchmark of the user-space allocator (built with 'make bench', not part of the kernel)
+// @author   Davide Della Giustina
+// @date     19/10/2026
+
+#include <stdio.h>
+#include <stdint.h>
+#include <sys/mman.h>
+
+// malloc.c is compiled unchanged, with the allocator and the system calls renamed (see the makefile) so that they do not
+// clash with the C library. The program break lives in a region mmap'd below 4GB, since the page map of the allocator
+// indexes 32-bit addresses.
+#include "../libc/malloc.h"
+
+#define BENCH_REGION        ((void *)0x50000000) // Backing region of the program break
+#define BENCH_REGION_SIZE   0x4000000
+#define BENCH_OPS           10000
+#define BENCH_LIVE          1000 // Objects alive at once in the batch and mixed workloads
+
+static uint32_t bench_rng_state = 1;
+static void *bench_objects[BENCH_LIVE];
+static uint8_t *bench_brk = (uint8_t *)BENCH_REGION;
+
+/* Read the time stamp counter.
+ * @return              Number of CPU cycles.
+ */
+static uint64_t bench_tsc() {
+    return __builtin_ia32_rdtsc();
+}
+
+/* Print the average cost of the operations of a workload.
+ * @param name          Name of the workload.
+ * @param cycles        Total number of cycles.
+ * @param ops           Number of operations.
+ */
+static void bench_report(char *name, uint64_t cycles, uint32_t ops) {
+    printf("%-32s %8llu cycles/op\n", name, (unsigned long long)(cycles / ops));
+}
+
+/* Generate a pseudo-random number (xorshift).
+ * @return              Random number.
+ */
+static uint32_t bench_rng() {
+    bench_rng_state ^= bench_rng_state << 13;
+    bench_rng_state ^= bench_rng_state >> 17;
+    bench_rng_state ^= bench_rng_state << 5;
+    return bench_rng_state;
+}
+
+/* Run the allocator microbenchmark: every workload reports the average number of cycles per call.
+ */
+int main() {
+    uint32_t i, j;
+    uint64_t start;
+    if (mmap(BENCH_REGION, BENCH_REGION_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0) != BENCH_REGION) {
+        printf("Cannot map the backing region at %p\n", BENCH_REGION);
+        return 1;
+    }
+    printf("Allocator layout: %u-bit pointers%s\n\n", (unsigned)(8 * sizeof(void *)),
+        (sizeof(void *) == 4)? "" : " (not the layout of i386 programs: build with HOST_ARCH=-m32)");
+    // Allocate and immediately free (always served by the per-class cache)
+    start = bench_tsc();
+    for (i = 0; i < BENCH_OPS; ++i) free(malloc(32));
+    bench_report("malloc+free pairs", bench_tsc() - start, 2 * BENCH_OPS);
+    // Allocate a batch of small objects, then free all of them (spills to the central lists)
+    start = bench_tsc();
+    for (i = 0; i < BENCH_OPS / BENCH_LIVE; ++i) {
+        for (j = 0; j < BENCH_LIVE; ++j) bench_objects[j] = malloc(8 + bench_rng() % 248);
+        for (j = 0; j < BENCH_LIVE; ++j) free(bench_objects[j]);
+    }
+    bench_report("batch small", bench_tsc() - start, 2 * BENCH_OPS);
+    // Random frees and allocations of mixed sizes over a live set
+    for (j = 0; j < BENCH_LIVE; ++j) bench_objects[j] = NULL;
+    start = bench_tsc();
+    for (i = 0; i < BENCH_OPS; ++i) {
+        j = bench_rng() % BENCH_LIVE;
+        free(bench_objects[j]);
+        bench_objects[j] = malloc((bench_rng() % 8 == 0)? 2048 + bench_rng() % 14336 : 8 + bench_rng() % 504);
+    }
+    bench_report("mixed live set", bench_tsc() - start, 2 * BENCH_OPS);
+    for (j = 0; j < BENCH_LIVE; ++j) free(bench_objects[j]);
+    // Grow a buffer a few bytes at a time
+    void *buf = NULL;
+    start = bench_tsc();
+    for (i = 1; i <= BENCH_OPS; ++i) buf = realloc(buf, i * 8);
+    bench_report("realloc growth", bench_tsc() - start, BENCH_OPS);
+    free(buf);
+    return 0;
+}
+
+// System calls the allocator depends on
+
+void *sbrk(int incr) {
+    uint8_t *old = bench_brk;
+    if (old + incr < (uint8_t *)BENCH_REGION || old + incr > (uint8_t *)BENCH_REGION + BENCH_REGION_SIZE) return (void *)-1;
+    bench_brk += incr;
+    return old;
+}
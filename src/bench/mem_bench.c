@@ -0,0 +1,172 @@
+// @desc     Host-native benchmark of the kernel memory primitives (built with 'make bench', not part of the kernel)
+// @author   Davide Della Giustina
+// @date     19/10/2026
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+// The kernel sources are compiled with the memory primitives renamed (see the makefile), so that they do not clash with the C library
+#include "../libc/mem.h"
+
+#define BENCH_MAX_SIZE      0x10000 // Largest size measured (64KB)
+#define BENCH_MIN_SIZE      8
+#define BENCH_BYTES         (1 << 28) // Bytes processed for every measurement
+#define BENCH_CHECK_SIZE    600 // Largest size checked against the reference implementations
+
+extern uint8_t mem_sse;
+int atoi(const char *str);
+
+uint8_t src_buf[BENCH_MAX_SIZE + 64] __attribute__((aligned(64)));
+uint8_t dst_buf[BENCH_MAX_SIZE + 64] __attribute__((aligned(64)));
+uint8_t ref_buf[BENCH_MAX_SIZE + 64] __attribute__((aligned(64)));
+
+// Private functions
+
+static void byte_memcpy(void *destination, const void *source, size_t nbytes);
+static void byte_memset(void *destination, uint8_t val, size_t len);
+static uint64_t now_ns();
+static uint8_t self_check();
+static double measure(uint8_t op, uint8_t sse, size_t size, size_t misalign, uint64_t bytes);
+
+#define OP_BYTE_COPY        0
+#define OP_MEMCPY           1
+#define OP_BYTE_SET         2
+#define OP_MEMSET           3
+#define OP_MEMMOVE          4 // Overlapping, copied backwards
+#define OP_MEMCMP           5 // Equal areas (the worst case)
+
+/* Check the primitives against byte loops, then print the throughput (in GB/s) of every implementation for sizes from
+ * 8 bytes to 64KB. 'byte' is the previous byte-at-a-time code (built without optimizations, like the kernel), 'rep' the
+ * word-sized string instructions alone and 'sse' the primitives with SSE2 enabled, as the kernel runs them.
+ * Usage: mem_bench [bytes per measurement]
+ */
+int main(int argc, char **argv) {
+    uint64_t bytes = (argc > 1 && atoi(argv[1]) > 0)? (uint64_t)atoi(argv[1]) : BENCH_BYTES;
+    size_t size;
+    mem_sse = 0;
+    if (!self_check()) return 1;
+    mem_sse = 1;
+    if (!self_check()) return 1;
+    printf("Memory primitives, GB/s (%llu bytes per measurement)\n\n", (unsigned long long)bytes);
+    printf("%8s | %20s | %13s | %20s | %7s | %6s\n", "", "memcpy (aligned)", "memcpy (+1/+3)", "memset", "memmove", "memcmp");
+    printf("%8s | %6s %6s %6s | %6s %6s | %6s %6s %6s | %7s | %6s\n", "size", "byte", "rep", "sse", "rep", "sse",
+           "byte", "rep", "sse", "back", "word");
+    for (size = BENCH_MIN_SIZE; size <= BENCH_MAX_SIZE; size <<= 1) {
+        printf("%8zu | %6.2f %6.2f %6.2f | %6.2f %6.2f | %6.2f %6.2f %6.2f | %7.2f | %6.2f\n", size,
+               measure(OP_BYTE_COPY, 0, size, 0, bytes / 8), measure(OP_MEMCPY, 0, size, 0, bytes), measure(OP_MEMCPY, 1, size, 0, bytes),
+               measure(OP_MEMCPY, 0, size, 1, bytes), measure(OP_MEMCPY, 1, size, 1, bytes),
+               measure(OP_BYTE_SET, 0, size, 0, bytes / 8), measure(OP_MEMSET, 0, size, 0, bytes), measure(OP_MEMSET, 1, size, 0, bytes),
+               measure(OP_MEMMOVE, 0, size, 0, bytes), measure(OP_MEMCMP, 0, size, 0, bytes));
+    }
+    return 0;
+}
+
+// Private functions
+
+/* Copy a portion of memory one byte at a time (the previous kernel implementation).
+ * @param destination   Destination address.
+ * @param source        Source address.
+ * @param nbytes        Number of bytes to copy.
+ */
+__attribute__((optimize("O0"))) static void byte_memcpy(void *destination, const void *source, size_t nbytes) {
+    size_t i;
+    for (i = 0; i < nbytes; ++i) *((uint8_t *)destination + i) = *((const uint8_t *)source + i);
+}
+
+/* Set a portion of memory one byte at a time (the previous kernel implementation).
+ * @param destination   Base memory address.
+ * @param val           Value to set.
+ * @param len           Length of memory portion (in bytes).
+ */
+__attribute__((optimize("O0"))) static void byte_memset(void *destination, uint8_t val, size_t len) {
+    uint8_t *p = (uint8_t *)destination;
+    for (; len != 0; --len) *p++ = val;
+}
+
+/* Read a monotonic clock.
+ * @return              Time (in ns).
+ */
+static uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Check every primitive against byte loops, for all sizes up to BENCH_CHECK_SIZE and all alignments.
+ * @return              Zero if a result differs.
+ */
+static uint8_t self_check() {
+    size_t i, n, s, d;
+    for (i = 0; i < sizeof(src_buf); ++i) src_buf[i] = (uint8_t)(i * 7 + 3);
+    for (n = 0; n <= BENCH_CHECK_SIZE; ++n) {
+        for (s = 0; s < 16; ++s) for (d = 0; d < 16; ++d) {
+            // memcpy and memset
+            byte_memset(dst_buf, 0xaa, n + 32);
+            byte_memset(ref_buf, 0xaa, n + 32);
+            byte_memcpy(ref_buf + d, src_buf + s, n);
+            if (memcpy(dst_buf + d, src_buf + s, n) != dst_buf + d || memcmp(dst_buf, ref_buf, n + 32) != 0) {
+                printf("memcpy differs (size %zu, offsets %zu/%zu, sse %u)\n", n, s, d, mem_sse);
+                return 0;
+            }
+            byte_memset(ref_buf + d, (uint8_t)n, n);
+            if (memset(dst_buf + d, (uint8_t)n, n) != dst_buf + d || memcmp(dst_buf, ref_buf, n + 32) != 0) {
+                printf("memset differs (size %zu, offset %zu, sse %u)\n", n, d, mem_sse);
+                return 0;
+            }
+            // memmove, in both directions, over the same buffer
+            byte_memcpy(dst_buf, src_buf, n + 32);
+            byte_memcpy(ref_buf, src_buf, n + 32);
+            byte_memcpy(ref_buf + 2048, ref_buf + s, n); // The reference goes through a scratch area
+            byte_memcpy(ref_buf + d, ref_buf + 2048, n);
+            memmove(dst_buf + d, dst_buf + s, n);
+            if (memcmp(dst_buf, ref_buf, n + 16) != 0) {
+                printf("memmove differs (size %zu, offsets %zu/%zu, sse %u)\n", n, s, d, mem_sse);
+                return 0;
+            }
+        }
+        // memcmp: the sign must follow the first differing byte, wherever it is
+        byte_memcpy(dst_buf, src_buf, n);
+        if (memcmp(dst_buf, src_buf, n) != 0) {
+            printf("memcmp differs (size %zu)\n", n);
+            return 0;
+        }
+        for (i = 0; i < n; ++i) {
+            dst_buf[i] = src_buf[i] ^ 0x81; // Differs both in the sign bit and in the lowest one
+            if (memcmp(dst_buf, src_buf, n) != (int)dst_buf[i] - (int)src_buf[i] || memcmp(src_buf, dst_buf, n) != (int)src_buf[i] - (int)dst_buf[i]) {
+                printf("memcmp differs (size %zu, position %zu)\n", n, i);
+                return 0;
+            }
+            dst_buf[i] = src_buf[i];
+        }
+    }
+    return 1;
+}
+
+/* Measure the throughput of a primitive.
+ * @param op            Operation (OP_*).
+ * @param sse           Value of the SSE switch.
+ * @param size          Size of every call.
+ * @param misalign      Nonzero to offset the destination by 1 and the source by 3 bytes.
+ * @param bytes         Total number of bytes to process.
+ * @return              Throughput (in GB/s).
+ */
+static double measure(uint8_t op, uint8_t sse, size_t size, size_t misalign, uint64_t bytes) {
+    uint64_t iterations = bytes / size, i, start;
+    uint8_t *dst = dst_buf + misalign, *src = src_buf + 3 * misalign;
+    volatile int sink = 0;
+    mem_sse = sse;
+    byte_memcpy(dst_buf, src_buf, sizeof(dst_buf)); // Make memcmp scan everything
+    start = now_ns();
+    for (i = 0; i < iterations; ++i) {
+        switch (op) {
+            case OP_BYTE_COPY: byte_memcpy(dst, src, size); break;
+            case OP_MEMCPY: memcpy(dst, src, size); break;
+            case OP_BYTE_SET: byte_memset(dst, (uint8_t)i, size); break;
+            case OP_MEMSET: memset(dst, (uint8_t)i, size); break;
+            case OP_MEMMOVE: memmove(dst_buf + 32, dst_buf, size); break;
+            case OP_MEMCMP: sink += memcmp(dst_buf, src_buf, size); break;
+        }
+    }
+    return (double)(iterations * size) / (double)(now_ns() - start + 1);
+}
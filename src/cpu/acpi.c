@@ -0,0 +1,94 @@
+// @desc     ACPI tables
+// @author   Davide Della Giustina
+// @date     19/10/2026
+
+#include "acpi.h"
+
+#define EBDA_SEGMENT_PTR    0x40e // Where the BIOS data area keeps the segment of the EBDA
+#define BIOS_AREA_START     0xe0000
+#define BIOS_AREA_END       0x100000
+#define ACPI_MAX_TABLES     32
+
+// Root System Description Pointer (ACPI 1.0 part)
+typedef struct {
+    char signature[8]; // "RSD PTR "
+    uint8_t checksum;
+    char oem_id[6];
+    uint8_t revision;
+    uint32_t rsdt_address; // Physical address of the RSDT
+} __attribute__((packed)) acpi_rsdp_t;
+
+acpi_header_t *acpi_tables[ACPI_MAX_TABLES]; // Tables listed by the RSDT (mapped once, on the first lookup)
+uint32_t acpi_ntables = 0;
+uint8_t acpi_searched = 0;
+
+// Private functions
+
+static acpi_rsdp_t *find_rsdp(physaddr_t start, physaddr_t end);
+static acpi_header_t *map_table(physaddr_t phys);
+static uint8_t checksum(const void *p, uint32_t len);
+
+// Public functions
+
+/* Find an ACPI table (paging must be set up: the tables are mapped with kmap_io()).
+ * @param signature Signature of the table (e.g. "APIC" for the MADT).
+ * @return          Pointer to the whole table, or NULL if the firmware does not provide it.
+ */
+acpi_header_t *acpi_find_table(const char *signature) {
+    uint32_t i;
+    if (!acpi_searched) {
+        acpi_searched = 1;
+        physaddr_t ebda = (physaddr_t)*(uint16_t *)(KERNEL_VIRT_BASE + EBDA_SEGMENT_PTR) << 4;
+        acpi_rsdp_t *rsdp = (ebda != 0)? find_rsdp(ebda, ebda + 0x400) : NULL; // The first KB of the EBDA...
+        if (rsdp == NULL) rsdp = find_rsdp(BIOS_AREA_START, BIOS_AREA_END); // ... or the BIOS read-only area
+        acpi_header_t *rsdt = (rsdp != NULL)? map_table(rsdp->rsdt_address) : NULL;
+        if (rsdt == NULL) return NULL;
+        uint32_t *entries = (uint32_t *)(rsdt + 1), n = (rsdt->length - sizeof(acpi_header_t)) / 4;
+        for (i = 0; i < n && acpi_ntables < ACPI_MAX_TABLES; ++i) {
+            acpi_header_t *table = map_table(entries[i]);
+            if (table != NULL) acpi_tables[acpi_ntables++] = table;
+        }
+    }
+    for (i = 0; i < acpi_ntables; ++i) {
+        if (strncmp(acpi_tables[i]->signature, signature, 4) == 0) return acpi_tables[i];
+    }
+    return NULL;
+}
+
+// Private functions
+
+/* Look for the RSDP in low memory (which is mapped linearly).
+ * @param start     First physical address to look at (16-byte aligned).
+ * @param end       End of the area.
+ * @return          Pointer to the RSDP, or NULL if not found.
+ */
+static acpi_rsdp_t *find_rsdp(physaddr_t start, physaddr_t end) {
+    physaddr_t p;
+    for (p = start; p + sizeof(acpi_rsdp_t) <= end; p += 16) { // It is always on a 16-byte boundary
+        acpi_rsdp_t *rsdp = (acpi_rsdp_t *)(KERNEL_VIRT_BASE + p);
+        if (strncmp(rsdp->signature, "RSD PTR ", 8) == 0 && checksum(rsdp, sizeof(acpi_rsdp_t)) == 0) return rsdp;
+    }
+    return NULL;
+}
+
+/* Map a whole table and validate it.
+ * @param phys      Physical address of the table.
+ * @return          Pointer to the table, or NULL if its checksum is wrong.
+ */
+static acpi_header_t *map_table(physaddr_t phys) {
+    acpi_header_t *header = (acpi_header_t *)kmap_io(phys, sizeof(acpi_header_t)); // Just to read the length
+    acpi_header_t *table = (acpi_header_t *)kmap_io(phys, header->length);
+    return (checksum(table, table->length) == 0)? table : NULL;
+}
+
+/* Add up bytes.
+ * @param p         First byte.
+ * @param len       Number of bytes.
+ * @return          Sum (modulo 256).
+ */
+static uint8_t checksum(const void *p, uint32_t len) {
+    const uint8_t *bytes = (const uint8_t *)p;
+    uint8_t sum = 0;
+    while (len-- > 0) sum += *bytes++;
+    return sum;
+}
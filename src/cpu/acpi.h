@@ -0,0 +1,31 @@
+// @desc     ACPI tables header
+// @author   Davide Della Giustina
+// @date     19/10/2026
+
+#ifndef ACPI_H
+#define ACPI_H
+
+#include <stdint.h>
+#include "../libc/string.h"
+#include "paging.h"
+
+// Header common to all the ACPI tables
+typedef struct {
+    char signature[4];
+    uint32_t length; // Length of the whole table (header included)
+    uint8_t revision;
+    uint8_t checksum; // All the bytes of the table add up to zero
+    char oem_id[6];
+    char oem_table_id[8];
+    uint32_t oem_revision;
+    uint32_t creator_id;
+    uint32_t creator_revision;
+} __attribute__((packed)) acpi_header_t;
+
+/* Find an ACPI table (paging must be set up: the tables are mapped with kmap_io()).
+ * @param signature Signature of the table (e.g. "APIC" for the MADT).
+ * @return          Pointer to the whole table, or NULL if the firmware does not provide it.
+ */
+acpi_header_t *acpi_find_table(const char *signature);
+
+#endif
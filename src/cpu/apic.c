@@ -0,0 +1,248 @@
+// @desc     Local APIC and I/O APIC
+// @author   Davide Della Giustina
+// @date     19/10/2026
+
+#include "apic.h"
+#include "../kernel/klog.h"
+#include "acpi.h"
+#include "isr.h"
+
+#define IA32_APIC_BASE_MSR  0x1b
+#define APIC_BASE_ENABLE    (0x1 << 11) // Global enable bit of the APIC base MSR
+#define LAPIC_SVR_ENABLE    (0x1 << 8) // Software enable bit of the spurious interrupt vector register
+#define IOAPIC_REGSEL       0x0 // Register selector (byte offsets)...
+#define IOAPIC_WINDOW       0x10 // ... and data window
+#define IOAPIC_VERSION      0x1 // Version and number of redirection entries
+#define IOAPIC_REDTBL       0x10 // First redirection entry (two registers each)
+#define REDTBL_ACTIVE_LOW   (0x1 << 13)
+#define REDTBL_LEVEL        (0x1 << 15)
+#define REDTBL_MASKED       (0x1 << 16)
+#define ISA_IRQS            16
+
+// MADT (Multiple APIC Description Table)
+typedef struct {
+    acpi_header_t header;
+    uint32_t lapic_address; // Physical address of the local APICs
+    uint32_t flags; // Bit 0: the system also has 8259 PICs
+} __attribute__((packed)) madt_t;
+
+// Entry of the MADT (followed by type-specific fields)
+typedef struct {
+    uint8_t type;
+    uint8_t length;
+} __attribute__((packed)) madt_entry_t;
+
+#define MADT_LAPIC          0 // Processor: ACPI ID (1 byte), APIC ID (1 byte), flags (4 bytes, bit 0 = enabled)
+#define MADT_IOAPIC         1 // I/O APIC: ID (1 byte), reserved (1 byte), address (4 bytes), first GSI (4 bytes)
+#define MADT_OVERRIDE       2 // ISA IRQ override: bus (1 byte), IRQ (1 byte), GSI (4 bytes), flags (2 bytes)
+
+// I/O APIC
+typedef struct {
+    volatile uint32_t *regs; // Mapped registers
+    uint32_t gsi_base; // First global system interrupt it handles
+    uint32_t gsi_count; // Number of redirection entries
+} ioapic_t;
+
+volatile uint32_t *lapic = NULL; // Mapped local APIC registers (NULL while the PICs are in use)
+ioapic_t ioapics[IOAPIC_MAX];
+uint32_t ioapic_count = 0;
+uint8_t cpu_apic_ids[APIC_MAX_CPUS];
+uint32_t cpu_count = 0;
+uint32_t isa_gsi[ISA_IRQS]; // Global system interrupt of each ISA IRQ (the identity, unless the MADT overrides it)
+uint32_t isa_flags[ISA_IRQS]; // Polarity and trigger mode of each ISA IRQ (REDTBL_* bits)
+
+// Private functions
+
+static uint8_t parse_madt(madt_t *madt);
+static ioapic_t *find_ioapic(uint32_t gsi);
+static uint32_t ioapic_read(ioapic_t *ioapic, uint32_t reg);
+static void ioapic_write(ioapic_t *ioapic, uint32_t reg, uint32_t value);
+static void route_irq(uint8_t irq, uint8_t masked);
+
+// Public functions
+
+/* Switch interrupt delivery from the 8259 PICs to the local APIC and the I/O APIC, if the ACPI MADT describes them
+ * (paging must be set up). The IRQ lines enabled on the PICs stay enabled, on the same vectors.
+ * @return          Zero if there is no APIC (the PICs stay in use).
+ */
+uint8_t apic_init() {
+    uint32_t eax = 1, ebx, ecx, edx, i, low, high;
+    asm volatile("cpuid" : "+a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx));
+    if (!(edx & (0x1 << 9))) return 0; // No local APIC
+    madt_t *madt = (madt_t *)acpi_find_table("APIC");
+    if (madt == NULL || !parse_madt(madt)) return 0;
+    uint32_t flags;
+    asm volatile("pushf; pop %0; cli" : "=r" (flags) : : "memory");
+    // Take the state of the PICs, then silence them
+    uint16_t masks = inb(PIC_MASTER_DATA) | (inb(PIC_SLAVE_DATA) << 8);
+    outb(PIC_MASTER_COMMAND, 0x0a); // Next read: interrupt request register
+    outb(PIC_SLAVE_COMMAND, 0x0a);
+    uint16_t pending = inb(PIC_MASTER_COMMAND) | (inb(PIC_SLAVE_COMMAND) << 8);
+    outb(PIC_MASTER_DATA, 0xff);
+    outb(PIC_SLAVE_DATA, 0xff);
+    // Enable the local APIC
+    asm volatile("rdmsr" : "=a" (low), "=d" (high) : "c" (IA32_APIC_BASE_MSR));
+    asm volatile("wrmsr" : : "a" (low | APIC_BASE_ENABLE), "d" (high), "c" (IA32_APIC_BASE_MSR));
+    lapic = (volatile uint32_t *)kmap_io(madt->lapic_address, 0x1000);
+    lapic_enable();
+    // Route the ISA IRQs to the vectors the PICs used, enabling the same lines
+    for (i = 0; i < ioapic_count; ++i) {
+        uint32_t j;
+        for (j = 0; j < ioapics[i].gsi_count; ++j) ioapic_write(&ioapics[i], IOAPIC_REDTBL + 2 * j, REDTBL_MASKED);
+    }
+    for (i = 0; i < ISA_IRQS; ++i) {
+        if (i != 2) route_irq(i, (masks >> i) & 0x1); // IRQ2 is the cascade of the PICs
+    }
+    // Edges the PICs received but did not deliver are gone: replay them, or their devices would wait forever
+    for (i = 0; i < ISA_IRQS; ++i) {
+        if (i != 2 && ((pending & ~masks) >> i) & 0x1) lapic_write(LAPIC_ICR_LOW, ICR_SELF | ICR_ASSERT | (IRQ0 + i));
+    }
+    asm volatile("push %0; popf" : : "r" (flags) : "memory", "cc");
+    klog(KLOG_INFO, "APIC: %u CPU(s), %u I/O APIC(s), local APIC at 0x%x\n", cpu_count, ioapic_count, madt->lapic_address);
+    return 1;
+}
+
+/* Enable the local APIC of this processor (apic_init() does it on the boot processor).
+ */
+void lapic_enable() {
+    lapic_write(LAPIC_TPR, 0); // Accept every vector
+    lapic_write(LAPIC_SVR, LAPIC_SVR_ENABLE | APIC_SPURIOUS_VECTOR);
+}
+
+/* Send an inter-processor interrupt, and wait until the local APIC has sent it.
+ * @param apic_id   Local APIC ID of the destination.
+ * @param icr       Low half of the interrupt command (vector, delivery mode, ICR_* flags).
+ */
+void apic_send_ipi(uint8_t apic_id, uint32_t icr) {
+    lapic_write(LAPIC_ICR_HIGH, (uint32_t)apic_id << 24);
+    lapic_write(LAPIC_ICR_LOW, icr);
+    while (lapic_read(LAPIC_ICR_LOW) & ICR_PENDING) asm volatile("pause");
+}
+
+/* Check whether interrupts are delivered by the APICs.
+ * @return          Nonzero after a successful apic_init().
+ */
+uint8_t apic_enabled() {
+    return lapic != NULL;
+}
+
+/* Acknowledge the interrupt being handled.
+ */
+void apic_eoi() {
+    lapic[LAPIC_EOI / 4] = 0;
+}
+
+/* Enable or disable an ISA IRQ line on the I/O APIC.
+ * @param irq       IRQ line (0-15).
+ * @param masked    Nonzero to disable it.
+ */
+void ioapic_set_mask(uint8_t irq, uint8_t masked) {
+    if (irq < ISA_IRQS) route_irq(irq, masked);
+}
+
+/* Read a local APIC register.
+ * @param reg       Register (LAPIC_*).
+ * @return          Value.
+ */
+uint32_t lapic_read(uint32_t reg) {
+    return lapic[reg / 4];
+}
+
+/* Write a local APIC register.
+ * @param reg       Register (LAPIC_*).
+ * @param value     Value.
+ */
+void lapic_write(uint32_t reg, uint32_t value) {
+    lapic[reg / 4] = value;
+}
+
+/* Get the number of processors listed by the MADT.
+ * @return          Number of (enabled) processors.
+ */
+uint32_t apic_cpu_count() {
+    return cpu_count;
+}
+
+/* Get the local APIC ID of a processor.
+ * @param cpu       Index of the processor (in MADT order).
+ * @return          Local APIC ID.
+ */
+uint8_t apic_cpu_id(uint32_t cpu) {
+    return cpu_apic_ids[cpu];
+}
+
+// Private functions
+
+/* Collect processors, I/O APICs and IRQ overrides from the MADT.
+ * @param madt      MADT.
+ * @return          Zero if there is no usable I/O APIC.
+ */
+static uint8_t parse_madt(madt_t *madt) {
+    uint32_t i;
+    for (i = 0; i < ISA_IRQS; ++i) {
+        isa_gsi[i] = i;
+        isa_flags[i] = 0; // ISA default: active high, edge triggered
+    }
+    uint8_t *p = (uint8_t *)(madt + 1), *end = (uint8_t *)madt + madt->header.length;
+    while (p + sizeof(madt_entry_t) <= end && ((madt_entry_t *)p)->length >= sizeof(madt_entry_t)) {
+        madt_entry_t *entry = (madt_entry_t *)p;
+        if (entry->type == MADT_LAPIC && (*(uint32_t *)(p + 4) & 0x1) && cpu_count < APIC_MAX_CPUS) {
+            cpu_apic_ids[cpu_count++] = p[3];
+        } else if (entry->type == MADT_IOAPIC && ioapic_count < IOAPIC_MAX) {
+            ioapic_t *ioapic = &ioapics[ioapic_count++];
+            ioapic->regs = (volatile uint32_t *)kmap_io(*(uint32_t *)(p + 4), 0x20);
+            ioapic->gsi_base = *(uint32_t *)(p + 8);
+            ioapic->gsi_count = ((ioapic_read(ioapic, IOAPIC_VERSION) >> 16) & 0xff) + 1;
+        } else if (entry->type == MADT_OVERRIDE && p[3] < ISA_IRQS) {
+            uint16_t mps = *(uint16_t *)(p + 8); // Bits 0-1: polarity (3 = active low), bits 2-3: trigger (3 = level)
+            isa_gsi[p[3]] = *(uint32_t *)(p + 4);
+            isa_flags[p[3]] = (((mps & 0x3) == 0x3)? REDTBL_ACTIVE_LOW : 0) | ((((mps >> 2) & 0x3) == 0x3)? REDTBL_LEVEL : 0);
+        }
+        p += entry->length;
+    }
+    return ioapic_count > 0 && find_ioapic(isa_gsi[0]) != NULL;
+}
+
+/* Find the I/O APIC that handles a global system interrupt.
+ * @param gsi       Global system interrupt.
+ * @return          I/O APIC, or NULL if none does.
+ */
+static ioapic_t *find_ioapic(uint32_t gsi) {
+    uint32_t i;
+    for (i = 0; i < ioapic_count; ++i) {
+        if (gsi >= ioapics[i].gsi_base && gsi < ioapics[i].gsi_base + ioapics[i].gsi_count) return &ioapics[i];
+    }
+    return NULL;
+}
+
+/* Read an I/O APIC register.
+ * @param ioapic    I/O APIC.
+ * @param reg       Register.
+ * @return          Value.
+ */
+static uint32_t ioapic_read(ioapic_t *ioapic, uint32_t reg) {
+    ioapic->regs[IOAPIC_REGSEL / 4] = reg;
+    return ioapic->regs[IOAPIC_WINDOW / 4];
+}
+
+/* Write an I/O APIC register.
+ * @param ioapic    I/O APIC.
+ * @param reg       Register.
+ * @param value     Value.
+ */
+static void ioapic_write(ioapic_t *ioapic, uint32_t reg, uint32_t value) {
+    ioapic->regs[IOAPIC_REGSEL / 4] = reg;
+    ioapic->regs[IOAPIC_WINDOW / 4] = value;
+}
+
+/* Program the redirection entry of an ISA IRQ: its vector is the one the PICs used, its destination this processor.
+ * @param irq       IRQ line (0-15).
+ * @param masked    Nonzero to disable it.
+ */
+static void route_irq(uint8_t irq, uint8_t masked) {
+    ioapic_t *ioapic = find_ioapic(isa_gsi[irq]);
+    if (ioapic == NULL) return;
+    uint32_t entry = IOAPIC_REDTBL + 2 * (isa_gsi[irq] - ioapic->gsi_base);
+    ioapic_write(ioapic, entry + 1, lapic_read(LAPIC_ID) & 0xff000000); // Physical destination: the local APIC ID
+    ioapic_write(ioapic, entry, (IRQ0 + irq) | isa_flags[irq] | (masked? REDTBL_MASKED : 0));
+}
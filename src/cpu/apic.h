@@ -0,0 +1,95 @@
+// @desc     Local APIC and I/O APIC header
+// @author   Davide Della Giustina
+// @date     19/10/2026
+
+#ifndef APIC_H
+#define APIC_H
+
+#include <stdint.h>
+
+#define APIC_SPURIOUS_VECTOR 0xff // Spurious interrupts of the local APIC (never acknowledged)
+#define APIC_MAX_CPUS       16
+#define IOAPIC_MAX          4
+
+// Local APIC registers (byte offsets)
+#define LAPIC_ID            0x20
+#define LAPIC_VERSION       0x30
+#define LAPIC_TPR           0x80 // Task priority
+#define LAPIC_EOI           0xb0
+#define LAPIC_SVR           0xf0 // Spurious interrupt vector (and software enable)
+#define LAPIC_ICR_LOW       0x300 // Interrupt command (writing the low half sends the IPI)
+#define LAPIC_ICR_HIGH      0x310
+#define LAPIC_LVT_TIMER     0x320
+#define LAPIC_LVT_LINT0     0x350
+#define LAPIC_LVT_LINT1     0x360
+#define LAPIC_TIMER_INITIAL 0x380
+#define LAPIC_TIMER_CURRENT 0x390
+#define LAPIC_TIMER_DIVIDE  0x3e0
+
+// Interrupt command register (low half)
+#define ICR_INIT            0x500 // Delivery mode: INIT
+#define ICR_STARTUP         0x600 // Delivery mode: startup (the vector is the page of the startup code)
+#define ICR_PENDING         (0x1 << 12) // Delivery status: not sent yet
+#define ICR_ASSERT          (0x1 << 14)
+#define ICR_SELF            (0x1 << 18) // Destination shorthand: the sending processor
+
+// Local APIC timer
+#define LAPIC_TIMER_PERIODIC (0x1 << 17) // LVT timer mode
+#define LAPIC_LVT_MASKED    (0x1 << 16)
+#define LAPIC_TIMER_DIV16   0x3 // Divide configuration: bus clock / 16
+
+/* Switch interrupt delivery from the 8259 PICs to the local APIC and the I/O APIC, if the ACPI MADT describes them
+ * (paging must be set up). The IRQ lines enabled on the PICs stay enabled, on the same vectors.
+ * @return          Zero if there is no APIC (the PICs stay in use).
+ */
+uint8_t apic_init();
+
+/* Enable the local APIC of this processor (apic_init() does it on the boot processor).
+ */
+void lapic_enable();
+
+/* Send an inter-processor interrupt, and wait until the local APIC has sent it.
+ * @param apic_id   Local APIC ID of the destination.
+ * @param icr       Low half of the interrupt command (vector, delivery mode, ICR_* flags).
+ */
+void apic_send_ipi(uint8_t apic_id, uint32_t icr);
+
+/* Check whether interrupts are delivered by the APICs.
+ * @return          Nonzero after a successful apic_init().
+ */
+uint8_t apic_enabled();
+
+/* Acknowledge the interrupt being handled.
+ */
+void apic_eoi();
+
+/* Enable or disable an ISA IRQ line on the I/O APIC.
+ * @param irq       IRQ line (0-15).
+ * @param masked    Nonzero to disable it.
+ */
+void ioapic_set_mask(uint8_t irq, uint8_t masked);
+
+/* Read a local APIC register.
+ * @param reg       Register (LAPIC_*).
+ * @return          Value.
+ */
+uint32_t lapic_read(uint32_t reg);
+
+/* Write a local APIC register.
+ * @param reg       Register (LAPIC_*).
+ * @param value     Value.
+ */
+void lapic_write(uint32_t reg, uint32_t value);
+
+/* Get the number of processors listed by the MADT.
+ * @return          Number of (enabled) processors.
+ */
+uint32_t apic_cpu_count();
+
+/* Get the local APIC ID of a processor.
+ * @param cpu       Index of the processor (in MADT order).
+ * @return          Local APIC ID.
+ */
+uint8_t apic_cpu_id(uint32_t cpu);
+
+#endif
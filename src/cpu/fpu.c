@@ -0,0 +1,195 @@
+// @desc     FPU and SSE
+// @author   Davide Della Giustina
+// @date     19/10/2026
+
+#include "fpu.h"
+#include "smp.h"
+
+#define CR0_MP              (0x1 << 1) // Monitor coprocessor (WAIT honours TS)
+#define CR0_EM              (0x1 << 2) // Emulate the FPU (every FPU instruction traps)
+#define CR0_TS              (0x1 << 3) // Task switched (the next FPU/SSE instruction traps)
+#define CR0_NE              (0x1 << 5) // Report FPU errors as exceptions
+#define CR4_OSFXSR          (0x1 << 9) // FXSAVE/FXRSTOR and SSE enabled
+#define CR4_OSXMMEXCPT      (0x1 << 10) // SIMD floating point exceptions enabled
+
+extern uint8_t mem_sse; // From mem.c
+
+// The registers of each processor hold the state of one process at most (the owner, in cpu_t). Switching processes only
+// sets CR0.TS: the state is saved and the new one loaded when the next process actually executes an FPU/SSE
+// instruction, so processes that never do pay nothing. With more than one processor online the state is saved when the
+// process is switched out instead, since it may run next on another processor.
+
+fpu_state_t fpu_initial; // State right after initialization (loaded on the first use by a process)
+cache_t *fpu_state_cache = NULL;
+uint8_t fpu_present = 0;
+uint8_t fpu_fxsr = 0; // FXSAVE/FXRSTOR supported
+uint8_t fpu_sse2 = 0; // SSE2 supported
+uint32_t fpu_cr4 = 0; // CR4 bits set by fpu_init() (the application processors set them too)
+
+// Private functions
+
+static void fpu_handler(registers_t *r);
+static void fpu_save_owner(cpu_t *cpu);
+static void fpu_save(fpu_state_t *state);
+static void fpu_restore(fpu_state_t *state);
+static void set_ts();
+static void clear_ts();
+
+// Public functions
+
+/* Initialize the FPU (and SSE, if supported), and install the lazy context switch handler.
+ */
+void fpu_init() {
+    uint32_t eax = 1, ebx, ecx, edx;
+    asm volatile("cpuid" : "+a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx));
+    unsigned long cr0, cr4;
+    asm volatile("mov %%cr0, %0" : "=r" (cr0));
+    if (!(edx & 0x1)) { // No FPU: make every FPU instruction trap
+        cr0 = (cr0 | CR0_EM) & ~CR0_MP;
+        asm volatile("mov %0, %%cr0" : : "r" (cr0));
+        return;
+    }
+    cr0 = (cr0 & ~(CR0_EM | CR0_TS)) | CR0_MP | CR0_NE;
+    asm volatile("mov %0, %%cr0" : : "r" (cr0));
+    asm volatile("fninit");
+    fpu_present = 1;
+    fpu_fxsr = (edx >> 24) & 0x1;
+    if (fpu_fxsr && (edx & (0x1 << 25))) { // SSE
+        fpu_cr4 = CR4_OSFXSR | CR4_OSXMMEXCPT;
+        asm volatile("mov %%cr4, %0" : "=r" (cr4));
+        asm volatile("mov %0, %%cr4" : : "r" (cr4 | fpu_cr4));
+        fpu_sse2 = (edx >> 26) & 0x1;
+    }
+    fpu_save(&fpu_initial);
+    mem_sse = fpu_sse2;
+    register_interrupt_handler(FPU_NM_VECTOR, fpu_handler);
+}
+
+/* Enable the FPU (and SSE) of an application processor, the same way fpu_init() did on the boot processor.
+ */
+void fpu_ap_init() {
+    unsigned long cr0, cr4;
+    asm volatile("mov %%cr0, %0" : "=r" (cr0));
+    if (!fpu_present) { // Make every FPU instruction trap
+        cr0 = (cr0 | CR0_EM) & ~CR0_MP;
+        asm volatile("mov %0, %%cr0" : : "r" (cr0));
+        return;
+    }
+    cr0 = (cr0 & ~(CR0_EM | CR0_TS)) | CR0_MP | CR0_NE;
+    asm volatile("mov %0, %%cr0" : : "r" (cr0));
+    asm volatile("fninit");
+    if (fpu_cr4) {
+        asm volatile("mov %%cr4, %0" : "=r" (cr4));
+        asm volatile("mov %0, %%cr4" : : "r" (cr4 | fpu_cr4));
+    }
+}
+
+/* Tell which FPU state belongs to the process that is about to run. Its registers are not loaded: the first FPU/SSE
+ * instruction it executes traps, and only then the registers are switched.
+ * @param state         Pointer to the state slot of the process (the state is allocated on first use).
+ */
+void fpu_switch(fpu_state_t **state) {
+    cpu_t *cpu = this_cpu();
+    if (smp_cpu_count() > 1 && cpu->fpu_owner != NULL) { // The process switched out may run next on another processor
+        asm volatile("clts"); // The registers may be saved with TS set
+        fpu_save_owner(cpu);
+    }
+    cpu->fpu_current = state;
+    if (*state != NULL && *state == cpu->fpu_owner && (*state)->cpu == cpu->index) clear_ts(); // Still in the registers
+    else set_ts();
+}
+
+/* Release the FPU state of a process that is going away.
+ * @param state         State (may be NULL).
+ */
+void fpu_release(fpu_state_t *state) {
+    if (state == NULL) return;
+    cpu_t *cpu = this_cpu();
+    if (state == cpu->fpu_owner) cpu->fpu_owner = NULL;
+    state->cpu = FPU_CPU_NONE;
+    cache_free(fpu_state_cache, state);
+}
+
+/* Let kernel code use any FPU/SSE register (saving the state of the process that owns them). Interrupts are disabled
+ * until kernel_fpu_end(), and the two calls cannot be nested.
+ */
+void kernel_fpu_begin() {
+    uint32_t flags;
+    asm volatile("pushf; pop %0; cli" : "=r" (flags) : : "memory");
+    cpu_t *cpu = this_cpu();
+    cpu->kernel_fpu_flags = flags;
+    clear_ts();
+    fpu_save_owner(cpu);
+}
+
+/* End a kernel_fpu_begin() section.
+ */
+void kernel_fpu_end() {
+    cpu_t *cpu = this_cpu();
+    if (cpu->fpu_current != NULL) set_ts(); // The running process reloads its registers on its next use
+    asm volatile("push %0; popf" : : "r" (cpu->kernel_fpu_flags) : "memory", "cc");
+}
+
+// Private functions
+
+/* Handler of the "No Coprocessor" exception: give the registers to the running process.
+ * @param r             CPU state (registers).
+ */
+static void fpu_handler(registers_t *r) {
+    (void)(r); // Unused parameter
+    cpu_t *cpu = this_cpu();
+    fpu_state_t **current = cpu->fpu_current;
+    clear_ts();
+    if (current == NULL || (*current != NULL && *current == cpu->fpu_owner && (*current)->cpu == cpu->index)) return; // No process yet, or its state is already loaded
+    fpu_save_owner(cpu);
+    if (*current == NULL) { // First use by this process
+        if (fpu_state_cache == NULL) fpu_state_cache = cache_create("fpu_state", sizeof(fpu_state_t), 16, NULL);
+        *current = (fpu_state_t *)cache_alloc(fpu_state_cache);
+        memcpy(*current, &fpu_initial, sizeof(fpu_state_t));
+    }
+    fpu_restore(*current);
+    (*current)->cpu = cpu->index;
+    cpu->fpu_owner = *current;
+}
+
+/* Save the registers of a processor into the state of their owner, if any (TS must be clear).
+ * @param cpu           This processor.
+ */
+static void fpu_save_owner(cpu_t *cpu) {
+    fpu_state_t *owner = cpu->fpu_owner;
+    if (owner == NULL) return;
+    if (owner->cpu == cpu->index) fpu_save(owner); // Otherwise another processor loaded it since (and saves it)
+    cpu->fpu_owner = NULL;
+}
+
+/* Save the registers.
+ * @param state         Where to save them (16-byte aligned).
+ */
+static void fpu_save(fpu_state_t *state) {
+    if (fpu_fxsr) asm volatile("fxsave (%0)" : : "r" (state) : "memory");
+    else asm volatile("fnsave (%0); fwait" : : "r" (state) : "memory");
+}
+
+/* Load the registers.
+ * @param state         Saved registers (16-byte aligned).
+ */
+static void fpu_restore(fpu_state_t *state) {
+    if (fpu_fxsr) asm volatile("fxrstor (%0)" : : "r" (state) : "memory");
+    else asm volatile("frstor (%0)" : : "r" (state) : "memory");
+}
+
+/* Make the next FPU/SSE instruction trap (the memory primitives stop using SSE meanwhile, to avoid the trap).
+ */
+static void set_ts() {
+    unsigned long cr0;
+    asm volatile("mov %%cr0, %0" : "=r" (cr0));
+    asm volatile("mov %0, %%cr0" : : "r" (cr0 | CR0_TS));
+    mem_sse = 0;
+}
+
+/* Let FPU/SSE instructions run.
+ */
+static void clear_ts() {
+    asm volatile("clts");
+    mem_sse = fpu_sse2 && smp_cpu_count() == 1; // mem_sse is shared: another processor may have TS set
+}
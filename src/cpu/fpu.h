@@ -0,0 +1,50 @@
+// @desc     FPU and SSE header
+// @author   Davide Della Giustina
+// @date     19/10/2026
+
+#ifndef FPU_H
+#define FPU_H
+
+#include <stdint.h>
+#include "../kernel/slab.h"
+#include "../libc/mem.h"
+#include "isr.h"
+
+#define FPU_NM_VECTOR       7 // "No Coprocessor" (device not available) exception
+#define FPU_CPU_NONE        0xffffffff // State not loaded on any processor
+
+// Saved FPU/MMX/SSE registers, in FXSAVE format (or FNSAVE format, on CPUs without FXSR)
+typedef struct {
+    uint8_t data[512];
+    uint32_t cpu; // Index of the processor that loaded it last
+} __attribute__((aligned(16))) fpu_state_t;
+
+/* Initialize the FPU (and SSE, if supported), and install the lazy context switch handler.
+ */
+void fpu_init();
+
+/* Enable the FPU (and SSE) of an application processor, the same way fpu_init() did on the boot processor.
+ */
+void fpu_ap_init();
+
+/* Tell which FPU state belongs to the process that is about to run. Its registers are not loaded: the first FPU/SSE
+ * instruction it executes traps, and only then the registers are switched.
+ * @param state         Pointer to the state slot of the process (the state is allocated on first use).
+ */
+void fpu_switch(fpu_state_t **state);
+
+/* Release the FPU state of a process that is going away.
+ * @param state         State (may be NULL).
+ */
+void fpu_release(fpu_state_t *state);
+
+/* Let kernel code use any FPU/SSE register (saving the state of the process that owns them). Interrupts are disabled
+ * until kernel_fpu_end(), and the two calls cannot be nested.
+ */
+void kernel_fpu_begin();
+
+/* End a kernel_fpu_begin() section.
+ */
+void kernel_fpu_end();
+
+#endif
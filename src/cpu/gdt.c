@@ -0,0 +1,61 @@
+// @desc     Global Descriptor Table (GDT) and Task State Segment (TSS)
+// @author   Davide Della Giustina
+// @date     19/10/2026
+
+#include "gdt.h"
+
+// Private functions
+
+static void set_entry(gdt_entry_t *entry, uint32_t base, uint32_t limit, uint8_t access, uint8_t flags);
+
+// Public functions
+
+/* Build the GDT of a processor and load it, along with its TSS.
+ * @param gdt           GDT of the processor (GDT_ENTRIES entries).
+ * @param tss           TSS of the processor.
+ * @param percpu        Data of the processor (the base of the %gs segment).
+ * @param percpu_size   Size of the data.
+ * @param stack_top     Top of the kernel stack of the processor.
+ */
+void gdt_load(gdt_entry_t *gdt, tss_t *tss, void *percpu, uint32_t percpu_size, uint32_t stack_top) {
+    set_entry(&gdt[0], 0, 0, 0, 0); // Mandatory null descriptor
+    set_entry(&gdt[GDT_KERNEL_CODE / 8], 0, 0xfffff, 0x9a, 0xc); // Present, ring 0, code, readable; 4KB granularity, 32-bit
+    set_entry(&gdt[GDT_KERNEL_DATA / 8], 0, 0xfffff, 0x92, 0xc); // Present, ring 0, data, writable; 4KB granularity, 32-bit
+    set_entry(&gdt[GDT_PERCPU / 8], (uint32_t)percpu, percpu_size - 1, 0x92, 0x4); // Byte granularity
+    set_entry(&gdt[GDT_TSS / 8], (uint32_t)tss, sizeof(tss_t) - 1, 0x89, 0x0); // Present, ring 0, available 32-bit TSS
+    uint32_t i;
+    for (i = 0; i < sizeof(tss_t) / 4; ++i) ((uint32_t *)tss)[i] = 0;
+    tss->esp0 = stack_top;
+    tss->ss0 = GDT_KERNEL_DATA;
+    tss->iomap_base = sizeof(tss_t);
+    gdt_register_t reg = { GDT_ENTRIES * sizeof(gdt_entry_t) - 1, (uint32_t)gdt };
+    asm volatile("lgdt (%0)" : : "r" (&reg) : "memory");
+    asm volatile("                      \
+        ljmp %0, $1f;                   \
+        1:                              \
+        mov %1, %%ds;                   \
+        mov %1, %%es;                   \
+        mov %1, %%fs;                   \
+        mov %1, %%ss;                   \
+        mov %2, %%gs;                   \
+        ltr %3"
+        : : "i" (GDT_KERNEL_CODE), "r" (GDT_KERNEL_DATA), "r" (GDT_PERCPU), "r" ((uint16_t)GDT_TSS) : "memory");
+}
+
+// Private functions
+
+/* Fill a segment descriptor.
+ * @param entry         Descriptor.
+ * @param base          Base address.
+ * @param limit         Limit (20 bits, in pages if the granularity flag is set).
+ * @param access        Access byte.
+ * @param flags         Flags (granularity, size).
+ */
+static void set_entry(gdt_entry_t *entry, uint32_t base, uint32_t limit, uint8_t access, uint8_t flags) {
+    entry->limit_low = limit & 0xffff;
+    entry->base_low = base & 0xffff;
+    entry->base_mid = (base >> 16) & 0xff;
+    entry->access = access;
+    entry->granularity = ((flags & 0xf) << 4) | ((limit >> 16) & 0xf);
+    entry->base_high = (base >> 24) & 0xff;
+}
@@ -0,0 +1,52 @@
+// @desc     Global Descriptor Table (GDT) and Task State Segment (TSS) header
+// @author   Davide Della Giustina
+// @date     19/10/2026
+
+#ifndef GDT_H
+#define GDT_H
+
+#include <stdint.h>
+
+// Selectors (the kernel code and data ones are the same as in the boot GDT)
+#define GDT_KERNEL_CODE     0x08
+#define GDT_KERNEL_DATA     0x10
+#define GDT_PERCPU          0x18 // Data of the processor (loaded in %gs)
+#define GDT_TSS             0x20
+#define GDT_ENTRIES         5
+
+// Segment descriptor
+typedef struct {
+    uint16_t limit_low; // Limit (0-15)
+    uint16_t base_low; // Base (0-15)
+    uint8_t base_mid; // Base (16-23)
+    uint8_t access; // Present, privilege, type
+    uint8_t granularity; // Flags + limit (16-19)
+    uint8_t base_high; // Base (24-31)
+} __attribute__((packed)) gdt_entry_t;
+
+// GDT descriptor (loaded by 'lgdt' assembly instruction)
+typedef struct {
+    uint16_t limit;
+    uint32_t base;
+} __attribute__((packed)) gdt_register_t;
+
+// Task state segment (only the ring 0 stack is used: there is no hardware task switching)
+typedef struct {
+    uint32_t prev_tss;
+    uint32_t esp0; // Stack loaded when an interrupt comes from a lower privilege level
+    uint32_t ss0;
+    uint32_t unused[22]; // Saved registers and stacks of the other rings
+    uint16_t trap;
+    uint16_t iomap_base; // Offset of the I/O permission bitmap (none: past the end of the segment)
+} __attribute__((packed)) tss_t;
+
+/* Build the GDT of a processor and load it, along with its TSS.
+ * @param gdt           GDT of the processor (GDT_ENTRIES entries).
+ * @param tss           TSS of the processor.
+ * @param percpu        Data of the processor (the base of the %gs segment).
+ * @param percpu_size   Size of the data.
+ * @param stack_top     Top of the kernel stack of the processor.
+ */
+void gdt_load(gdt_entry_t *gdt, tss_t *tss, void *percpu, uint32_t percpu_size, uint32_t stack_top);
+
+#endif
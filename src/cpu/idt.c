@@ -16,6 +16,15 @@ void set_idt_gate(int n, uint32_t handler) {
     idt[n].high_offset = (uint16_t)((handler >> 16) & 0xffff);
 }
 
+/* Set an interrupt handler that can also be triggered from user mode (e.g. system calls).
+ * @param n         Index inside the IDT (i.e. interrupt number).
+ * @param handler   Address of the handler function for this interrupt.
+ */
+void set_idt_user_gate(int n, uint32_t handler) {
+    set_idt_gate(n, handler);
+    idt[n].flags = 0xee; // 11101110b => interrupt present, user privileges, interrupt gate set, 32 bit gate
+}
+
 /* Load the IDT in memory.
  */
 void load_idt() {
@@ -42,6 +42,12 @@ idt_register_t idt_reg;
  */
 void set_idt_gate(int n, uint32_t handler);
 
+/* Set an interrupt handler that can also be triggered from user mode (e.g. system calls).
+ * @param n         Index inside the IDT (i.e. interrupt number).
+ * @param handler   Address of the handler function for this interrupt.
+ */
+void set_idt_user_gate(int n, uint32_t handler);
+
 /* Load the IDT in memory.
  */
 void load_idt();
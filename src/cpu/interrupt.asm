@@ -46,8 +46,8 @@ isr_common_stub:
     mov ax, 0x10 ; Kernel data segment descriptor, defined in GDT (entry #2, excluding the very first null entry)
     mov ds, ax
     mov es, ax
-    mov fs, ax
-    mov gs, ax
+    mov fs, ax ; %gs is left alone: it always holds the data of the processor (see smp.c)
+    cld ; The C code expects the direction flag clear (memmove sets it while copying backwards)
     push esp ; Pass by reference
     ; 2) Call generic C handler function
     call isr_handler
@@ -57,7 +57,6 @@ isr_common_stub:
     mov ds, ax
     mov es, ax
     mov fs, ax
-    mov gs, ax
     popa
     add esp, 8 ; Clean up the pushed error code and ISR number
     iret ; Pops cs, eip, eflags, ss, esp, then returns from interrupt
@@ -70,8 +69,8 @@ irq_common_stub:
     mov ax, 0x10 ; Kernel data segment descriptor, defined in GDT (entry #2, excluding the very first null entry)
     mov ds, ax
     mov es, ax
-    mov fs, ax
-    mov gs, ax
+    mov fs, ax ; %gs is left alone: it always holds the data of the processor (see smp.c)
+    cld ; The C code expects the direction flag clear (memmove sets it while copying backwards)
     push esp ; Pass by reference
     ; 2) Call generic C handler function
     call irq_handler
@@ -81,7 +80,6 @@ irq_common_stub:
     mov ds, bx
     mov es, bx
     mov fs, bx
-    mov gs, bx
     popa
     add esp, 8 ; Clean up the pushed error code and ISR number
     iret ; Pops cs, eip, eflags, ss, esp, then returns from interrupt
@@ -120,6 +118,18 @@ ISR_NOERR 29 ; Reserved Exception
 ISR_NOERR 30 ; Reserved Exception
 ISR_NOERR 31 ; Reserved Exception
 
+; System calls (the number does not fit in a signed byte, so it cannot use ISR_NOERR)
+global isr128
+isr128:
+    push byte 0
+    push dword 128
+    jmp isr_common_stub
+
+; Spurious interrupts of the local APIC: they must not be acknowledged, so they skip the C handlers
+global isr_spurious
+isr_spurious:
+    iret
+
 ; IRQs
 IRQ 0, 32
 IRQ 1, 33
@@ -136,4 +146,6 @@ IRQ 11, 43
 IRQ 12, 44
 IRQ 13, 45
 IRQ 14, 46
-IRQ 15, 47
\ No newline at end of file
+IRQ 15, 47
+IRQ 16, 48 ; Local APIC timer (not an ISA line)
+IRQ 17, 49 ; Inter-processor interrupt (not an ISA line)
\ No newline at end of file
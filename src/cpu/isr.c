@@ -3,8 +3,11 @@
 // @date     31/12/2019
 
 #include "isr.h"
+#include "smp.h"
 
 isr_t interrupt_handlers[IDT_ENTRIES];
+uint32_t irq_count[IRQ_LINES]; // Interrupts handled, per line
+uint32_t irq_max_cycles[IRQ_LINES]; // Longest handler run, per line (among those that did not switch process)
 
 /* Remap the PICs to the desired offsets.
  * @param offset_master         New offset for the master PIC.
@@ -84,6 +87,12 @@ void isr_install() {
     set_idt_gate(45, (uint32_t)irq13);
     set_idt_gate(46, (uint32_t)irq14);
     set_idt_gate(47, (uint32_t)irq15);
+    set_idt_gate(48, (uint32_t)irq16);
+    set_idt_gate(49, (uint32_t)irq17);
+    // Register the system call handler (reachable from user mode)
+    set_idt_user_gate(SYSCALL_INT, (uint32_t)isr128);
+    // Spurious interrupts of the local APIC (used instead of the PICs when present)
+    set_idt_gate(APIC_SPURIOUS_VECTOR, (uint32_t)isr_spurious);
     // Load IDT in memory
     load_idt();
 }
@@ -135,13 +144,7 @@ void isr_handler(registers_t *r) {
         isr_t handler = interrupt_handlers[r->int_no];
         handler(r);
     } else { // If there is no registered handler
-        kprint("Unhandled exception: ");
-        kprint(exception_messages[r->int_no]);
-        kprint(", code ");
-        char s[3];
-        itoa(r->int_no, s, 10);
-        kprint(s);
-        kprint("\n");
+        klog(KLOG_ERR, "Unhandled exception: %s, code %u\n", exception_messages[r->int_no], r->int_no);
     }
 }
 
@@ -157,18 +160,58 @@ void register_interrupt_handler(uint8_t n, isr_t handler) {
  * @param r                     Registers.
  */
 void irq_handler(registers_t *r) {
-    if (r->int_no >= 40) outb(PIC_SLAVE_COMMAND, 0x20); // Send EOI (End Of Interrupt) in order to receive future interrupts
-    outb(PIC_MASTER_COMMAND, 0x20);
+    uint64_t start = read_tsc();
+    uint32_t switches = this_cpu()->switches;
+    if (apic_enabled()) apic_eoi(); // A single store to the local APIC
+    else { // Send EOI (End Of Interrupt) in order to receive future interrupts
+        if (r->int_no >= 40) outb(PIC_SLAVE_COMMAND, 0x20);
+        outb(PIC_MASTER_COMMAND, 0x20);
+    }
     if (interrupt_handlers[r->int_no] != 0) {
         isr_t handler = interrupt_handlers[r->int_no];
         handler(r);
     }
+    uint32_t line = r->int_no - IRQ0, cycles = (uint32_t)(read_tsc() - start);
+    ++irq_count[line];
+    // A handler that switched process returns only once the process runs again, with interrupts enabled meanwhile
+    if (this_cpu()->switches == switches && cycles > irq_max_cycles[line]) irq_max_cycles[line] = cycles;
+    do_softirq(); // Bottom halves, with interrupts enabled (not counted in the cycles of the line)
 }
 
 /* Setup all the implemented IRQs.
  */
 void irq_init() {
     asm volatile("sti"); // Enable interrupts (disabled when switching to 32-bit protected mode)
-    init_timer(50); // IRQ0
+    init_timer(TIMER_HZ); // IRQ0
     init_keyboard(); // IRQ1
-}
\ No newline at end of file
+}
+/* Enable or disable an IRQ line (on the PICs or on the I/O APIC, whichever is in use).
+ * @param irq                   IRQ line (0-15).
+ * @param masked                Nonzero to disable it.
+ */
+void irq_set_mask(uint8_t irq, uint8_t masked) {
+    if (irq >= 16) return; // Not an ISA line
+    if (apic_enabled()) {
+        ioapic_set_mask(irq, masked);
+        return;
+    }
+    uint16_t port = (irq < 8)? PIC_MASTER_DATA : PIC_SLAVE_DATA;
+    uint8_t bit = 0x1 << (irq % 8), mask = inb(port);
+    outb(port, masked? (mask | bit) : (mask & ~bit));
+}
+
+/* Print how many interrupts each IRQ line raised and the longest time its handler ran with interrupts disabled (leaving
+ * out the runs that switched process, e.g. at the end of a time slice).
+ * @param reset                 Nonzero to start counting again afterwards.
+ */
+void irqstat(uint8_t reset) {
+    uint32_t i;
+    kprint("IRQ      count  max cycles\n");
+    for (i = 0; i < IRQ_LINES; ++i) {
+        if (irq_count[i] > 0) kprintf("%3u %10u  %10u\n", i, irq_count[i], irq_max_cycles[i]);
+    }
+    if (reset) {
+        memset(irq_count, 0, sizeof(irq_count));
+        memset(irq_max_cycles, 0, sizeof(irq_max_cycles));
+    }
+}
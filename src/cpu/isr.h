@@ -8,10 +8,15 @@
 #include <stdint.h>
 #include "../drivers/keyboard.h"
 #include "../drivers/vga.h"
+#include "../kernel/klog.h"
+#include "../kernel/softirq.h"
+#include "../libc/printf.h"
 #include "../libc/string.h"
+#include "apic.h"
 #include "idt.h"
 #include "ports.h"
 #include "timer.h"
+#include "tsc.h"
 
 // PIC ports
 #define PIC_MASTER          0x20
@@ -71,6 +76,13 @@ extern void irq12();
 extern void irq13();
 extern void irq14();
 extern void irq15();
+extern void irq16();
+extern void irq17();
+// System calls
+extern void isr128();
+
+// Spurious interrupts of the local APIC
+extern void isr_spurious();
 
 #define IRQ0 32
 #define IRQ1 33
@@ -88,6 +100,11 @@ extern void irq15();
 #define IRQ13 45
 #define IRQ14 46
 #define IRQ15 47
+#define IRQ16 48 // Local APIC timer (not an ISA line)
+#define IRQ17 49 // Inter-processor interrupt (not an ISA line)
+#define IRQ_LINES 18
+
+#define SYSCALL_INT 128 // Interrupt used for system calls (int 0x80)
 
 // Registers structure
 typedef struct {
@@ -118,4 +135,16 @@ typedef void (*isr_t)(registers_t *); // 'isr_t' is a void function with a regis
  */
 void register_interrupt_handler(uint8_t n, isr_t handler);
 
+/* Enable or disable an IRQ line (on the PICs or on the I/O APIC, whichever is in use).
+ * @param irq                   IRQ line (0-15).
+ * @param masked                Nonzero to disable it.
+ */
+void irq_set_mask(uint8_t irq, uint8_t masked);
+
+/* Print how many interrupts each IRQ line raised and the longest time its handler ran with interrupts disabled (leaving
+ * out the runs that switched process, e.g. at the end of a time slice).
+ * @param reset                 Nonzero to start counting again afterwards.
+ */
+void irqstat(uint8_t reset);
+
 #endif
\ No newline at end of file
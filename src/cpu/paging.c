@@ -6,10 +6,22 @@
 
 uint32_t *frames; // Bitmap of frames
 uint32_t nframes;
+uint16_t *kpage_runs; // Length of each run of kernel pages, stored at its first page
+uint32_t kpage_hint = KPAGE_PHYS_START / 0x1000; // Where to start looking for free kernel pages
+uint32_t frames_used = 0, frames_peak = 0; // Frames in use (and their high-water mark)
+uint32_t kpages_used = 0, kpages_peak = 0; // Kernel pages in use (and their high-water mark)
 
 physaddr_t boot_directory; // Backup of the boot directory
 page_directory_t *kernel_directory, *current_directory;
 
+cache_t *page_directory_cache; // Page directories (page-aligned)
+cache_t *page_table_cache; // Page tables (page-aligned)
+
+uint32_t kmap_io_next = KMAP_IO_VIRT_START; // Next free page of the device memory window
+spinlock_t frames_lock = SPINLOCK_INIT; // Frames bitmap, kernel page runs and their counters
+spinlock_t temp_map_lock = SPINLOCK_INIT; // The temporary mapping (held from temp_map() to temp_demap())
+uint32_t temp_map_flags; // EFLAGS before temp_map()
+
 #define INDEX(x)        (x / 32)
 #define OFFSET(x)       (x % 32)
 
@@ -18,8 +30,8 @@ page_directory_t *kernel_directory, *current_directory;
 static void set_frame(physaddr_t frame_address);
 static void clear_frame(physaddr_t frame_address);
 // static uint32_t test_frame(physaddr_t frame_address);
-static uint32_t first_free_frame();
-void free_frame(page_t *page);
+static uint32_t first_free_frame(uint32_t from);
+static uint32_t find_free_run(uint32_t from, uint32_t to, uint32_t n);
 
 // Public functions
 
@@ -39,6 +51,7 @@ void setup_paging(void *kvs, void *kve, physaddr_t kps, physaddr_t kpe) {
     uint32_t mem_size = TOTAL_RAM_SIZE * 0x100000; // RAM size (in MB) * 1MB (argument passed at compile time)
     nframes = mem_size / 0x1000;
     frames = (uint32_t *)dumb_kcalloc(INDEX(nframes) * sizeof(uint32_t), 0, 0); // Allocate bitmap
+    kpage_runs = (uint16_t *)dumb_kcalloc(((KPAGE_PHYS_END - KPAGE_PHYS_START) / 0x1000) * sizeof(uint16_t), 0, 0);
     // Frames until 0x40000 are reserved for kernel use
     physaddr_t frame = 0x0;
     while (frame < 0x40000) {
@@ -47,9 +60,7 @@ void setup_paging(void *kvs, void *kve, physaddr_t kps, physaddr_t kpe) {
     }
     // Allocate page directory and tables before video memory
     kbrk(kve);
-    physaddr_t phys;
-    kernel_directory = (page_directory_t *)dumb_kcalloc(sizeof(page_directory_t), 1, &phys); // Allocate space for page directory;
-    kernel_directory->physical_addr = phys;
+    kernel_directory = (page_directory_t *)dumb_kcalloc(sizeof(page_directory_t), 1, NULL); // Allocate space for page directory;
     // Map boot + GDT + kernel + kernel dumb heap + video memory
     physaddr_t physaddr = 0x0;
     void *virtaddr = (void *)(physaddr + 0xc0000000);
@@ -68,6 +79,7 @@ void setup_paging(void *kvs, void *kve, physaddr_t kps, physaddr_t kpe) {
         physaddr += 0x1000; virtaddr += 0x1000; // Increment pointers
     }
     // Map some space for future kernel heap (63.25MB) -> Kernel heap limit is 64MB (0x4000000) [edit: removed last page frame, which is now used for temp mapping for fork()]
+    // Frames after the maximum extent of the kernel heap stay free, and are handed out by kpage_alloc()
     while (physaddr < 0x3fff000) {
         uint32_t pti = (uint32_t)virtaddr >> 22; // Page table index
         uint32_t pi = ((uint32_t)virtaddr >> 12) & 0x3ff; // Page index
@@ -79,11 +91,13 @@ void setup_paging(void *kvs, void *kve, physaddr_t kps, physaddr_t kpe) {
         kernel_directory->tables[pti]->pages[pi].rw = 1; // Page is writable
         kernel_directory->tables[pti]->pages[pi].user = 0; // Page is kernel mode
         kernel_directory->tables[pti]->pages[pi].frame_addr = (physaddr / 0x1000);
-        set_frame(physaddr);
+        if (physaddr < KPAGE_PHYS_START) set_frame(physaddr);
         physaddr += 0x1000; virtaddr += 0x1000; // Increment pointers
     }
     // "Book" frame for performing a page directory clone
     set_frame(0x3fff000);
+    // Page table of the device memory window (created now, so that every page directory links it)
+    create_page_table(kernel_directory, KMAP_IO_VIRT_START >> 22, 1, 1);
     // Reset brk for kheap
     kbrk((void *)0xc0100000);
     // Load new page directory
@@ -91,12 +105,37 @@ void setup_paging(void *kvs, void *kve, physaddr_t kps, physaddr_t kpe) {
     (void)kvs; (void)kps; // Unused parameters
 }
 
+/* Create the caches for page directories and page tables (kernel heap must be already initialized).
+ */
+void paging_caches_init() {
+    page_directory_cache = cache_create("page_directory", sizeof(page_directory_t), 0x1000, NULL);
+    page_table_cache = cache_create("page_table", sizeof(page_table_t), 0x1000, NULL);
+}
+
+/* Allocate a new (empty) page table.
+ * @param phys              Where the physical address of the table will be stored.
+ * @return                  Pointer to the page table.
+ */
+page_table_t *alloc_page_table(physaddr_t *phys) {
+    page_table_t *table = (page_table_t *)cache_alloc(page_table_cache);
+    memset(table, 0, sizeof(page_table_t));
+    *phys = (physaddr_t)table - KERNEL_VIRT_BASE; // Slabs are made of (linearly mapped) kernel pages
+    return table;
+}
+
+/* Free a page table allocated with alloc_page_table().
+ * @param table             Page table.
+ */
+void free_page_table(page_table_t *table) {
+    cache_free(page_table_cache, table);
+}
+
 /* Load a new page directory into the CR3 register.
  * @param page_directory        Address of the new page directory to load.
  */
 void switch_page_directory(page_directory_t *page_directory) {
     current_directory = page_directory;
-    asm volatile("mov %0, %%cr3" : : "r"(page_directory->physical_addr)); // Switch page directory
+    asm volatile("mov %0, %%cr3" : : "r"(DIRECTORY_PHYS(page_directory))); // Switch page directory
 }
 
 /* Page faults handler function.
@@ -110,16 +149,8 @@ void page_fault_handler(registers_t *r) {
     int us = r->err_code & 0x4;
     int reserved = r->err_code & 0x8;
     int id = r->err_code & 0x10; (void)(id); // Unused parameter
-    kprint("Page fault! ( ");
-    if (present) kprint("present ");
-    if (rw) kprint("read-only ");
-    if (us) kprint("user-mode ");
-    if (reserved) kprint("reserved ");
-    kprint(") at 0x");
-    char addr[9];
-    itoa(faulting_address, addr, 16);
-    kprint(addr);
-    kprint("\n");
+    klog(KLOG_EMERG, "Page fault! ( %s%s%s%s) at 0x%08x\n", (present)? "present " : "", (rw)? "read-only " : "", (us)? "user-mode " : "",
+            (reserved)? "reserved " : "", faulting_address);
     panic("page fault");
     // TODO: must swap pages and load necessary ones!
     // NEEDED: disk driver!
@@ -130,9 +161,9 @@ void page_fault_handler(registers_t *r) {
  * @return              Pointer to the new page directory.
  */
 page_directory_t *clone_page_directory(page_directory_t *src) {
+    page_directory_t *dir = (page_directory_t *)cache_alloc(page_directory_cache);
+    memset(dir, 0, sizeof(page_directory_t)); // Slabs are made of (linearly mapped) kernel pages, see DIRECTORY_PHYS()
     physaddr_t phys;
-    page_directory_t *dir = (page_directory_t *)kcalloc_ap(sizeof(page_directory_t), &phys);
-    dir->physical_addr = phys;
     uint32_t i;
     for (i = 0; i < 1024; ++i) { // For each page table
         if (!src->tables[i]) continue; // If it is empty, skip it
@@ -141,7 +172,7 @@ page_directory_t *clone_page_directory(page_directory_t *src) {
             dir->tables_physical[i] = src->tables_physical[i];
         } else { // Else, page table should be copied
             // Allocate page table
-            page_table_t *tbl = (page_table_t *)kcalloc_ap(sizeof(page_table_t), &phys);
+            page_table_t *tbl = alloc_page_table(&phys);
             // Save reference
             dir->tables[i] = tbl;
             dir->tables_physical[i] = phys | 0x7; // User-mode, r/w, present
@@ -159,7 +190,7 @@ page_directory_t *clone_page_directory(page_directory_t *src) {
                 temp_map(src->tables[i]->pages[j].frame_addr);
                 // Copy physical frame
                 uint32_t addr = (i << 22) | (j << 12);
-                memcpy((void *)addr, (void *)0xc3fff000, 0x1000);
+                memcpy((void *)0xc3fff000, (void *)addr, 0x1000);
                 // Remove temporary mapping and invalidate TLB
                 temp_demap();
             }
@@ -169,9 +200,11 @@ page_directory_t *clone_page_directory(page_directory_t *src) {
 }
 
 /* Temporarily map frame (in kernel virtual space, virtual addr 0xc3fff000) in order to being able to write on it.
+ * There is a single such mapping: other processors wait, and interrupts stay disabled, until temp_demap().
  * @param addr              Physical address of the frame to map.
  */
 void temp_map(physaddr_t addr) {
+    temp_map_flags = spin_lock_irqsave(&temp_map_lock);
     current_directory->tables[0x30f]->pages[0x3ff].frame_addr = addr;
     current_directory->tables[0x30f]->pages[0x3ff].present = 1;
     current_directory->tables[0x30f]->pages[0x3ff].rw = 1;
@@ -190,7 +223,8 @@ void temp_demap() {
     current_directory->tables[0x30f]->pages[0x3ff].user = 0;
     current_directory->tables[0x30f]->pages[0x3ff].accessed = 0;
     current_directory->tables[0x30f]->pages[0x3ff].dirty = 0;
-    asm volatile("invlpg (%0)" : : "r"(0xc3fff000) : "memory");
+    asm volatile("invlpg (%0)" : : "r"(0xc3fff000) : "memory"); // Other processors invalidate it in their temp_map()
+    spin_unlock_irqrestore(&temp_map_lock, temp_map_flags);
 }
 
 /* Create a new page table in a spacific page directory.
@@ -217,7 +251,9 @@ static void set_frame(physaddr_t frame_address) {
     uint32_t frame = frame_address / 0x1000; // Page table number (i.e. page directory entry)
     uint32_t index = INDEX(frame);
     uint32_t offset = OFFSET(frame);
+    if (frames[index] & (0x1 << offset)) return;
     frames[index] |= (0x1 << offset);
+    if (++frames_used > frames_peak) frames_peak = frames_used;
 }
 
 /* Clear a bit in the frames bitset.
@@ -227,7 +263,9 @@ static void clear_frame(physaddr_t frame_address) {
     uint32_t frame = frame_address / 0x1000;
     uint32_t index = INDEX(frame);
     uint32_t offset = OFFSET(frame);
+    if (!(frames[index] & (0x1 << offset))) return;
     frames[index] &= ~(0x1 << offset);
+    --frames_used;
 }
 
 /* Test a bit in the frames bitset.
@@ -242,21 +280,137 @@ static void clear_frame(physaddr_t frame_address) {
 // }
 
 /* Find the first free frame in memory. Very efficient implementation.
+ * @param from                  Index of the first frame to consider.
  * @return                      Index of the first free frame.
  */
-static uint32_t first_free_frame() {
+static uint32_t first_free_frame(uint32_t from) {
     uint32_t i, j;
-    for (i = 0; i < INDEX(nframes); ++i) {
+    for (i = INDEX(from); i < INDEX(nframes); ++i) {
         if (frames[i] != 0xffffffff) {
             for (j = 0; j < 32; ++j) {
                 uint32_t test = 0x1 << j;
-                if (!(frames[i] & test)) return (uint32_t)(i*32+j);
+                if (!(frames[i] & test) && i*32+j >= from) return (uint32_t)(i*32+j);
             }
         }
     }
     return (uint32_t)-1;
 }
 
+/* Find a run of contiguous free frames.
+ * @param from                  Index of the first frame to consider.
+ * @param to                    Index of the first frame not to consider.
+ * @param n                     Length of the run.
+ * @return                      Index of the first frame of the run, -1 if not found.
+ */
+static uint32_t find_free_run(uint32_t from, uint32_t to, uint32_t n) {
+    uint32_t i = from, run = 0;
+    while (i < to) {
+        if (OFFSET(i) == 0 && frames[INDEX(i)] == 0xffffffff) { // Skip full words
+            run = 0;
+            i += 32;
+            continue;
+        }
+        if (frames[INDEX(i)] & (0x1 << OFFSET(i))) run = 0;
+        else if (++run == n) return i + 1 - n;
+        ++i;
+    }
+    return (uint32_t)-1;
+}
+
+/* Allocate contiguous whole frames for kernel use (already mapped, page-aligned).
+ * @param npages            Number of pages.
+ * @param phys              Where the physical address will be stored (may be NULL).
+ * @return                  Pointer to the first page.
+ */
+void *kpage_alloc(uint32_t npages, physaddr_t *phys) {
+    assert(npages > 0 && npages <= 0xffff);
+    uint32_t first = KPAGE_PHYS_START / 0x1000, last = KPAGE_PHYS_END / 0x1000;
+    uint32_t flags = spin_lock_irqsave(&frames_lock);
+    uint32_t index = find_free_run(kpage_hint, last, npages); // Next fit
+    if (index == (uint32_t)-1) index = find_free_run(first, last, npages);
+    if (index == (uint32_t)-1) panic("no free kernel pages");
+    uint32_t i;
+    for (i = 0; i < npages; ++i) set_frame((index + i) * 0x1000);
+    kpage_runs[index - first] = npages;
+    kpage_hint = index + npages;
+    kpages_used += npages;
+    if (kpages_used > kpages_peak) kpages_peak = kpages_used;
+    spin_unlock_irqrestore(&frames_lock, flags);
+    if (phys) *phys = (physaddr_t)(index * 0x1000);
+    return (void *)(KERNEL_VIRT_BASE + index * 0x1000);
+}
+
+/* Free pages allocated with kpage_alloc().
+ * @param p                 Pointer to the first page.
+ */
+void kpage_free(void *p) {
+    assert(is_kpage(p) && ((uint32_t)p & 0xfff) == 0);
+    uint32_t index = ((uint32_t)p - KERNEL_VIRT_BASE) / 0x1000;
+    uint32_t flags = spin_lock_irqsave(&frames_lock);
+    uint32_t npages = kpage_runs[index - KPAGE_PHYS_START / 0x1000];
+    assert(npages > 0); // Double free
+    kpage_runs[index - KPAGE_PHYS_START / 0x1000] = 0;
+    uint32_t i;
+    for (i = 0; i < npages; ++i) clear_frame((index + i) * 0x1000);
+    kpages_used -= npages;
+    spin_unlock_irqrestore(&frames_lock, flags);
+}
+
+/* Check whether an address belongs to the kernel pages window.
+ * @param p                 Address.
+ * @return                  Nonzero if #p was (or may be) returned by kpage_alloc().
+ */
+int is_kpage(void *p) {
+    return ((uint32_t)p >= KPAGE_VIRT_START && (uint32_t)p < KPAGE_VIRT_END);
+}
+
+/* Get the size of a block allocated with kpage_alloc().
+ * @param p                 Pointer to the first page.
+ * @return                  Size of the block (in bytes).
+ */
+uint32_t kpage_size(void *p) {
+    assert(is_kpage(p) && ((uint32_t)p & 0xfff) == 0);
+    uint32_t npages = kpage_runs[((uint32_t)p - KPAGE_VIRT_START) / 0x1000];
+    assert(npages > 0);
+    return npages * 0x1000;
+}
+
+/* Map physical memory that is not RAM (device registers, firmware tables) into kernel space, uncached. Mappings are
+ * permanent.
+ * @param phys              Physical address (need not be page-aligned).
+ * @param size              Size of the region (in bytes).
+ * @return                  Virtual address of #phys.
+ */
+void *kmap_io(physaddr_t phys, uint32_t size) {
+    physaddr_t first = phys & ~0xfff;
+    uint32_t npages = (phys + size - first + 0xfff) / 0x1000, i;
+    assert(kmap_io_next + npages * 0x1000 <= KMAP_IO_VIRT_END);
+    page_table_t *table = kernel_directory->tables[KMAP_IO_VIRT_START >> 22];
+    uint32_t virt = kmap_io_next;
+    for (i = 0; i < npages; ++i) {
+        page_t *page = &table->pages[((virt >> 12) & 0x3ff) + i];
+        page->frame_addr = (first / 0x1000) + i;
+        page->reserved_1 = 0x3; // Write-through, cache disabled (these are the PWT and PCD bits)
+        page->rw = 1;
+        page->present = 1;
+        asm volatile("invlpg (%0)" : : "r"(virt + i * 0x1000) : "memory");
+    }
+    kmap_io_next += npages * 0x1000;
+    return (void *)(virt + (phys - first));
+}
+
+/* Get statistics about the frame allocator.
+ * @param stats             Where the statistics will be stored.
+ */
+void get_frame_stats(frame_stats_t *stats) {
+    stats->frames_total = nframes;
+    stats->frames_used = frames_used;
+    stats->frames_peak = frames_peak;
+    stats->kpages_total = (KPAGE_PHYS_END - KPAGE_PHYS_START) / 0x1000;
+    stats->kpages_used = kpages_used;
+    stats->kpages_peak = kpages_peak;
+}
+
 /* Allocate a new frame.
  * @param page              Page to allocate in that frame.
  * @param is_kernel         Page is kernel-mode?
@@ -265,7 +419,8 @@ static uint32_t first_free_frame() {
  */
 physaddr_t alloc_frame(page_t *page, int is_kernel, int is_writable) {
     if (page->frame_addr != 0) return (physaddr_t)-1; // Already allocated frame
-    uint32_t index = first_free_frame();
+    uint32_t flags = spin_lock_irqsave(&frames_lock);
+    uint32_t index = first_free_frame(KERNEL_SPACE_END / 0x1000); // Frames below are either kernel or kernel pages
     if (index == (uint32_t)-1) { // If there are no free frames
         panic("no free frames");
         // TODO: must implement frame replacement algorithm!
@@ -273,6 +428,7 @@ physaddr_t alloc_frame(page_t *page, int is_kernel, int is_writable) {
         return (physaddr_t)-1;
     }
     set_frame((physaddr_t)(index * 0x1000)); // Allocate frame
+    spin_unlock_irqrestore(&frames_lock, flags);
     page->present = 1;
     page->rw = ((is_writable)? 1 : 0);
     page->user = ((is_kernel)? 0 : 1);
@@ -286,6 +442,8 @@ physaddr_t alloc_frame(page_t *page, int is_kernel, int is_writable) {
 void free_frame(page_t *page) {
     uint32_t frame = page->frame_addr;
     if (!frame) return; // The frame is already free
+    uint32_t flags = spin_lock_irqsave(&frames_lock);
     clear_frame((physaddr_t)(frame * 0x1000));
+    spin_unlock_irqrestore(&frames_lock, flags);
     page->frame_addr = 0;
 }
\ No newline at end of file
@@ -8,10 +8,21 @@
 #include <stdint.h>
 #include "../drivers/vga.h"
 #include "../kernel/heap.h"
+#include "../kernel/slab.h"
 #include "../libc/mem.h"
+#include "../libc/printf.h"
 #include "isr.h"
 #include "panic.h"
 
+#define KERNEL_VIRT_BASE    0xc0000000 // Physical memory up to 64MB is mapped at 3GB + physical address
+#define KERNEL_SPACE_END    0x4000000 // Physical memory above this is for user frames
+#define KPAGE_PHYS_START    0x3600000 // Kernel pages come after the maximum extent of the kernel heap...
+#define KPAGE_PHYS_END      0x3fff000 // ... up to the frame used for temporary mappings
+#define KPAGE_VIRT_START    (KERNEL_VIRT_BASE + KPAGE_PHYS_START)
+#define KPAGE_VIRT_END      (KERNEL_VIRT_BASE + KPAGE_PHYS_END)
+#define KMAP_IO_VIRT_START  0xc4000000 // Window for device memory and firmware tables (see kmap_io())...
+#define KMAP_IO_VIRT_END    0xc4400000 // ... one page table wide
+
 // Page table entry (4 bytes)
 typedef struct {
         uint32_t present : 1; // Page is present in memory if set
@@ -30,13 +41,24 @@ typedef struct {
     page_t pages[1024];
 } page_table_t;
 
-// Page directory (array of 1024 page tables [pointers!])
+// Page directory (array of 1024 page tables [pointers!]), exactly two pages so that slabs of them need no padding
 typedef struct {
     uint32_t tables_physical[1024];
     page_table_t *tables[1024];
-    physaddr_t physical_addr;
 } page_directory_t;
 
+#define DIRECTORY_PHYS(dir) ((physaddr_t)(dir) - KERNEL_VIRT_BASE) // Page directories are linearly mapped kernel memory
+
+// Frame allocator statistics
+typedef struct {
+    uint32_t frames_total; // Number of physical frames
+    uint32_t frames_used; // Number of frames in use
+    uint32_t frames_peak; // High-water mark of frames in use
+    uint32_t kpages_total; // Number of frames in the kernel pages window
+    uint32_t kpages_used; // Number of kernel pages in use
+    uint32_t kpages_peak; // High-water mark of kernel pages in use
+} frame_stats_t;
+
 /* Setup paging environment.
  * (New page directory, different from the boot one, with no identity mapping).
  * @param kvs       Pointer to virtual kernel start.
@@ -46,6 +68,21 @@ typedef struct {
  */
 void setup_paging(void *kvs, void *kve, physaddr_t kps, physaddr_t kpe);
 
+/* Create the caches for page directories and page tables (kernel heap must be already initialized).
+ */
+void paging_caches_init();
+
+/* Allocate a new (empty) page table.
+ * @param phys              Where the physical address of the table will be stored.
+ * @return                  Pointer to the page table.
+ */
+page_table_t *alloc_page_table(physaddr_t *phys);
+
+/* Free a page table allocated with alloc_page_table().
+ * @param table             Page table.
+ */
+void free_page_table(page_table_t *table);
+
 /* Load a new page directory into the CR3 register.
  * @param page_directory        Address of the new page directory to load.
  */
@@ -63,6 +100,7 @@ void page_fault_handler(registers_t *r);
 page_directory_t *clone_page_directory(page_directory_t *src);
 
 /* Temporarily map frame (in kernel virtual space, virtual addr 0xc3fff000) in order to being able to write on it.
+ * There is a single such mapping: other processors wait, and interrupts stay disabled, until temp_demap().
  * @param addr              Physical address of the frame to map.
  */
 void temp_map(physaddr_t addr);
@@ -79,6 +117,43 @@ void temp_demap();
  */
 void create_page_table(page_directory_t *page_directory, uint32_t index, uint8_t is_kernel, uint8_t is_writable);
 
+/* Allocate contiguous whole frames for kernel use (already mapped, page-aligned).
+ * @param npages            Number of pages.
+ * @param phys              Where the physical address will be stored (may be NULL).
+ * @return                  Pointer to the first page.
+ */
+void *kpage_alloc(uint32_t npages, physaddr_t *phys);
+
+/* Free pages allocated with kpage_alloc().
+ * @param p                 Pointer to the first page.
+ */
+void kpage_free(void *p);
+
+/* Check whether an address belongs to the kernel pages window.
+ * @param p                 Address.
+ * @return                  Nonzero if #p was (or may be) returned by kpage_alloc().
+ */
+int is_kpage(void *p);
+
+/* Get the size of a block allocated with kpage_alloc().
+ * @param p                 Pointer to the first page.
+ * @return                  Size of the block (in bytes).
+ */
+uint32_t kpage_size(void *p);
+
+/* Map physical memory that is not RAM (device registers, firmware tables) into kernel space, uncached. Mappings are
+ * permanent.
+ * @param phys              Physical address (need not be page-aligned).
+ * @param size              Size of the region (in bytes).
+ * @return                  Virtual address of #phys.
+ */
+void *kmap_io(physaddr_t phys, uint32_t size);
+
+/* Get statistics about the frame allocator.
+ * @param stats             Where the statistics will be stored.
+ */
+void get_frame_stats(frame_stats_t *stats);
+
 /* Allocate a new frame.
  * @param page              Page to allocate in that frame.
  * @param is_kernel         Page is kernel-mode?
@@ -87,4 +162,9 @@ void create_page_table(page_directory_t *page_directory, uint32_t index, uint8_t
  */
 physaddr_t alloc_frame(page_t *page, int is_kernel, int is_writable);
 
+/* Free an existing frame.
+ * @param page              Page allocated in that frame.
+ */
+void free_frame(page_t *page);
+
 #endif
\ No newline at end of file
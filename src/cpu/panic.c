@@ -9,8 +9,7 @@
  */
 void panic(char *msg) {
     asm volatile("cli"); // Disable interrupts
-    kprint("*** System panic: ");
-    kprint(msg);
-    kprint(" ***\nHalting the CPU...");
+    klog_emergency(KLOG_EMERG, "*** System panic: %s ***\n", msg); // In the ring too, for a debugger to find
+    kprint("Halting the CPU...");
     asm volatile("hlt"); // Halt the CPU
 }
\ No newline at end of file
@@ -7,6 +7,7 @@
 
 #include <stdint.h>
 #include "../drivers/vga.h"
+#include "../kernel/klog.h"
 
 /* Panic and halt the CPU with an error message.
  * @param msg       Error message to be printed.
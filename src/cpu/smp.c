@@ -0,0 +1,202 @@
+// @desc     Multiprocessor support
+// @author   Davide Della Giustina
+// @date     19/10/2026
+
+#include "smp.h"
+#include "../kernel/klog.h"
+#include "ports.h"
+
+#define STARTUP_TIMEOUT_TICKS 5 // Ticks to wait for an application processor to come online (100ms)
+
+extern uint8_t trampoline_start[], trampoline_end[]; // From trampoline.asm
+extern uint8_t trampoline_cr3[], trampoline_stack[], trampoline_entry[];
+extern uint8_t kernel_stack_top[]; // From kernel_entry.asm
+extern page_directory_t *kernel_directory; // From paging.c
+extern void context_switch(); // From processes.c
+extern uint8_t processes_waiting(); // From processes.c
+extern uint8_t cpu_idle(cpu_t *cpu); // From processes.c
+extern void do_softirq(); // From softirq.c
+extern uint8_t softirq_pending(); // From softirq.c
+extern uint8_t work_pending(); // From softirq.c
+extern void work_run(); // From softirq.c
+
+// Every processor reaches its own cpu_t through %gs (the base of its GDT_PERCPU segment), so per-processor data needs
+// no lookup of the local APIC ID. The boot processor is cpus[0].
+
+cpu_t cpus[APIC_MAX_CPUS];
+uint32_t cpus_online = 1;
+volatile uint32_t cpu_starting; // Index of the application processor being started
+
+// Private functions
+
+static void ap_main();
+static void lapic_timer_callback(registers_t *r);
+static void ipi_callback(registers_t *r);
+static void io_delay(uint32_t us);
+
+// Public functions
+
+/* Get the data of the processor running the caller. Unless interrupts are disabled, the caller may be moved to another
+ * processor right after, so only the fields that follow the running process (e.g. current_process) stay valid.
+ * @return              Data of this processor.
+ */
+cpu_t *this_cpu() {
+    cpu_t *cpu;
+    asm volatile("mov %%gs:0, %0" : "=r" (cpu));
+    return cpu;
+}
+
+/* Give the boot processor its own GDT, TSS and per-processor data (before anything uses this_cpu()).
+ */
+void smp_bsp_init() {
+    cpu_t *cpu = &cpus[0];
+    cpu->self = cpu;
+    cpu->index = 0;
+    cpu->online = 1;
+    gdt_load(cpu->gdt, &cpu->tss, cpu, sizeof(cpu_t), (uint32_t)kernel_stack_top);
+}
+
+/* Start the application processors listed in the MADT (the local APIC must be enabled, the kernel heap and caches
+ * initialized, and interrupts enabled, for the PIT to time the startup sequence).
+ * @return              Number of processors online.
+ */
+uint32_t smp_init() {
+    if (!apic_enabled() || apic_cpu_count() <= 1) return cpus_online;
+    cpus[0].apic_id = lapic_read(LAPIC_ID) >> 24;
+    register_interrupt_handler(LAPIC_TIMER_VECTOR, lapic_timer_callback);
+    register_interrupt_handler(SMP_IPI_VECTOR, ipi_callback);
+    lapic_timer_calibrate(); // While the boot processor still has a periodic tick
+    // Copy the startup code below 1MB, and fill in its parameters
+    uint8_t *trampoline = (uint8_t *)(KERNEL_VIRT_BASE + SMP_TRAMPOLINE_ADDR);
+    memcpy(trampoline, trampoline_start, trampoline_end - trampoline_start);
+    *(uint32_t *)(trampoline + (trampoline_cr3 - trampoline_start)) = DIRECTORY_PHYS(kernel_directory);
+    *(uint32_t *)(trampoline + (trampoline_entry - trampoline_start)) = (uint32_t)ap_main;
+    // The processors enable paging while running it, so it must be identity mapped too until they are all up
+    physaddr_t phys;
+    page_table_t *low = alloc_page_table(&phys);
+    low->pages[SMP_TRAMPOLINE_ADDR >> 12].frame_addr = SMP_TRAMPOLINE_ADDR >> 12;
+    low->pages[SMP_TRAMPOLINE_ADDR >> 12].rw = 1;
+    low->pages[SMP_TRAMPOLINE_ADDR >> 12].present = 1;
+    kernel_directory->tables[0] = low;
+    kernel_directory->tables_physical[0] = phys | 0x3; // Kernel-mode, r/w, present
+    uint32_t i;
+    for (i = 0; i < apic_cpu_count() && cpus_online < APIC_MAX_CPUS; ++i) {
+        uint8_t apic_id = apic_cpu_id(i);
+        if (apic_id == cpus[0].apic_id) continue;
+        cpu_t *cpu = &cpus[cpus_online];
+        cpu->self = cpu;
+        cpu->index = cpus_online;
+        cpu->apic_id = apic_id;
+        if (cpu->stack == NULL) cpu->stack = kpage_alloc(SMP_STACK_PAGES, NULL); // Kept if the processor did not answer
+        *(uint32_t *)(trampoline + (trampoline_stack - trampoline_start)) = (uint32_t)cpu->stack + SMP_STACK_PAGES * 0x1000;
+        cpu_starting = cpu->index;
+        // INIT, then two startup IPIs (as in the Intel MultiProcessor Specification)
+        apic_send_ipi(apic_id, ICR_INIT | ICR_ASSERT);
+        timer_wait_ticks(1); // At least 10ms
+        uint8_t j;
+        for (j = 0; j < 2 && !cpu->online; ++j) {
+            apic_send_ipi(apic_id, ICR_STARTUP | (SMP_TRAMPOLINE_ADDR >> 12));
+            io_delay(200);
+        }
+        uint32_t start = timer_get_ticks();
+        while (!cpu->online && timer_get_ticks() - start < STARTUP_TIMEOUT_TICKS) asm volatile("pause");
+        if (cpu->online) ++cpus_online;
+        else { // Park it in the wait-for-SIPI state: answering late, it would run on the slot and stack of the next one
+            apic_send_ipi(apic_id, ICR_INIT | ICR_ASSERT);
+            cpu->online = 0; // In case it came up between the timeout and the INIT
+            klog(KLOG_WARN, "SMP: processor %u (APIC ID %u) did not start\n", i, apic_id);
+        }
+    }
+    kernel_directory->tables[0] = NULL;
+    kernel_directory->tables_physical[0] = 0;
+    switch_page_directory(kernel_directory); // Flush the identity mapping (the other processors no longer use it)
+    free_page_table(low);
+    klog(KLOG_INFO, "SMP: %u processors online\n", cpus_online);
+    return cpus_online;
+}
+
+/* Get the number of processors online.
+ * @return              Number of processors.
+ */
+uint32_t smp_cpu_count() {
+    return cpus_online;
+}
+
+/* Get the data of a processor.
+ * @param index         Index of the processor (less than smp_cpu_count()).
+ * @return              Data of the processor.
+ */
+cpu_t *smp_cpu(uint32_t index) {
+    assert(index < cpus_online);
+    return &cpus[index];
+}
+
+/* Interrupt another processor, to wake it up if it is halted (the boot processor reprograms its timer, an idle
+ * application processor takes a process from the ready queue).
+ * @param cpu           Processor.
+ */
+void smp_kick(cpu_t *cpu) {
+    uint32_t flags;
+    asm volatile("pushf; pop %0; cli" : "=r" (flags) : : "memory"); // The two halves of the command must go together
+    if (cpu != this_cpu()) apic_send_ipi(cpu->apic_id, SMP_IPI_VECTOR); // Fixed delivery
+    asm volatile("push %0; popf" : : "r" (flags) : "memory", "cc");
+}
+
+// Private functions
+
+/* Entry point of the application processors (from the trampoline, with paging enabled and on their own stack).
+ */
+static void ap_main() {
+    cpu_t *cpu = &cpus[cpu_starting];
+    gdt_load(cpu->gdt, &cpu->tss, cpu, sizeof(cpu_t), (uint32_t)cpu->stack + SMP_STACK_PAGES * 0x1000);
+    load_idt();
+    fpu_ap_init();
+    lapic_enable();
+    lapic_write(LAPIC_TIMER_DIVIDE, LAPIC_TIMER_DIV16);
+    if (TICKLESS) { // One-shot: armed only while processes wait for a processor
+        lapic_write(LAPIC_LVT_TIMER, LAPIC_TIMER_VECTOR);
+        if (processes_waiting()) lapic_write(LAPIC_TIMER_INITIAL, lapic_timer_calibrate());
+    } else {
+        lapic_write(LAPIC_LVT_TIMER, LAPIC_TIMER_VECTOR | LAPIC_TIMER_PERIODIC);
+        lapic_write(LAPIC_TIMER_INITIAL, lapic_timer_calibrate());
+    }
+    cpu->online = 1;
+    while (1) { // Idle: the timer, or a kick from a waker, schedules processes here
+        asm volatile("cli");
+        if (softirq_pending() || work_pending()) {
+            asm volatile("sti");
+            do_softirq(); // Left over by interrupt handlers that raised too many
+            work_run(); // Be the kernel worker while no process runs here
+        } else asm volatile("sti; hlt"); // STI takes effect after HLT, so no interrupt is missed in between
+    }
+}
+
+/* Handler for the local APIC timer interrupts of the application processors (timer.c drives the boot processor).
+ * @param r             CPU state (registers).
+ */
+static void lapic_timer_callback(registers_t *r) {
+    ++this_cpu()->ticks;
+    if (TICKLESS && processes_waiting()) lapic_write(LAPIC_TIMER_INITIAL, lapic_timer_calibrate()); // Next time slice
+    context_switch(); // Schedule a new process
+    (void)(r); // Unused parameter
+}
+
+/* Handler for the inter-processor interrupts (sent by smp_kick()).
+ * @param r             CPU state (registers).
+ */
+static void ipi_callback(registers_t *r) {
+    cpu_t *cpu = this_cpu();
+    if (cpu->index == 0) timer_reprogram(); // A timer nearer than the programmed event was added elsewhere
+    else if (processes_waiting()) { // A process was queued (or woken up) while this processor was idle
+        if (TICKLESS && lapic_read(LAPIC_TIMER_CURRENT) == 0) lapic_write(LAPIC_TIMER_INITIAL, lapic_timer_calibrate());
+        if (cpu_idle(cpu)) context_switch();
+    }
+    (void)(r); // Unused parameter
+}
+
+/* Busy-wait for about some microseconds (each write to the POST diagnostic port takes about 1us).
+ * @param us            Number of microseconds.
+ */
+static void io_delay(uint32_t us) {
+    while (us-- > 0) outb(0x80, 0);
+}
@@ -0,0 +1,75 @@
+// @desc     Multiprocessor support header
+// @author   Davide Della Giustina
+// @date     19/10/2026
+
+#ifndef SMP_H
+#define SMP_H
+
+#include <stdint.h>
+#include "../libc/mem.h"
+#include "apic.h"
+#include "fpu.h"
+#include "gdt.h"
+#include "isr.h"
+#include "paging.h"
+#include "timer.h"
+
+#define SMP_TRAMPOLINE_ADDR 0x6000 // Physical address of the startup code of the application processors (below 1MB)
+#define SMP_STACK_PAGES     2 // Kernel stack of each application processor
+#define LAPIC_TIMER_VECTOR  IRQ16 // Scheduler tick of the application processors
+#define SMP_IPI_VECTOR      IRQ17 // Wake up a processor (see smp_kick())
+
+// Data of a processor (reached through %gs, see this_cpu())
+typedef struct __cpu_t {
+    struct __cpu_t *self; // Read through %gs:0, so it must stay first
+    uint32_t index; // Position in the array of processors (0 is the boot processor)
+    uint8_t apic_id; // Local APIC ID
+    volatile uint8_t online; // Set by the processor once it can run processes
+    struct __pcb_t *current_process; // Process running on the processor
+    fpu_state_t *fpu_owner; // FPU state held in the registers of the processor
+    fpu_state_t **fpu_current; // State slot of the running process
+    uint32_t kernel_fpu_flags; // EFLAGS before kernel_fpu_begin()
+    volatile uint32_t ticks; // Local APIC timer interrupts
+    uint32_t switches; // Context switches (see irq_handler())
+    volatile uint32_t softirq_pending; // Raised softirqs (one bit per vector)
+    uint8_t in_softirq; // Set while do_softirq() runs (with interrupts enabled)
+    struct __tasklet_t *tasklets[2]; // Scheduled tasklets (high and normal priority)
+    void *stack; // Kernel stack (kpage_alloc(), NULL for the boot processor)
+    gdt_entry_t gdt[GDT_ENTRIES];
+    tss_t tss;
+} cpu_t;
+
+/* Get the data of the processor running the caller. Unless interrupts are disabled, the caller may be moved to another
+ * processor right after, so only the fields that follow the running process (e.g. current_process) stay valid.
+ * @return              Data of this processor.
+ */
+cpu_t *this_cpu();
+
+/* Give the boot processor its own GDT, TSS and per-processor data (before anything uses this_cpu()).
+ */
+void smp_bsp_init();
+
+/* Start the application processors listed in the MADT (the local APIC must be enabled, the kernel heap and caches
+ * initialized, and interrupts enabled, for the PIT to time the startup sequence).
+ * @return              Number of processors online.
+ */
+uint32_t smp_init();
+
+/* Get the number of processors online.
+ * @return              Number of processors.
+ */
+uint32_t smp_cpu_count();
+
+/* Get the data of a processor.
+ * @param index         Index of the processor (less than smp_cpu_count()).
+ * @return              Data of the processor.
+ */
+cpu_t *smp_cpu(uint32_t index);
+
+/* Interrupt another processor, to wake it up if it is halted (the boot processor reprograms its timer, an idle
+ * application processor takes a process from the ready queue).
+ * @param cpu           Processor.
+ */
+void smp_kick(cpu_t *cpu);
+
+#endif
@@ -0,0 +1,41 @@
+// @desc     Spinlocks
+// @author   Davide Della Giustina
+// @date     19/10/2026
+
+#include "spinlock.h"
+
+/* Take a lock, spinning until it is free.
+ * @param lock      Lock.
+ */
+void spin_lock(spinlock_t *lock) {
+    uint32_t ticket = __sync_fetch_and_add(&lock->next, 1);
+    while (lock->owner != ticket) asm volatile("pause" : : : "memory"); // Only reads while waiting: the line stays shared
+}
+
+/* Release a lock.
+ * @param lock      Lock (held).
+ */
+void spin_unlock(spinlock_t *lock) {
+    asm volatile("" : : : "memory"); // Stores of the critical section come first (x86 does not reorder stores)
+    lock->owner = lock->owner + 1; // Only the holder writes the owner
+}
+
+/* Disable interrupts on this processor, then take a lock (for data that interrupt handlers use too).
+ * @param lock      Lock.
+ * @return          Previous EFLAGS (for spin_unlock_irqrestore()).
+ */
+uint32_t spin_lock_irqsave(spinlock_t *lock) {
+    uint32_t flags;
+    asm volatile("pushf; pop %0; cli" : "=r" (flags) : : "memory");
+    spin_lock(lock);
+    return flags;
+}
+
+/* Release a lock, then restore the interrupt flag.
+ * @param lock      Lock (held).
+ * @param flags     Value returned by spin_lock_irqsave().
+ */
+void spin_unlock_irqrestore(spinlock_t *lock, uint32_t flags) {
+    spin_unlock(lock);
+    asm volatile("push %0; popf" : : "r" (flags) : "memory", "cc");
+}
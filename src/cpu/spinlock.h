@@ -0,0 +1,40 @@
+// @desc     Spinlocks header
+// @author   Davide Della Giustina
+// @date     19/10/2026
+
+#ifndef SPINLOCK_H
+#define SPINLOCK_H
+
+#include <stdint.h>
+
+// Ticket lock: processors get the lock in the order they asked for it, so none can starve
+typedef struct {
+    volatile uint32_t next; // Next ticket to hand out
+    volatile uint32_t owner; // Ticket that holds the lock
+} spinlock_t;
+
+#define SPINLOCK_INIT       { 0, 0 }
+
+/* Take a lock, spinning until it is free.
+ * @param lock      Lock.
+ */
+void spin_lock(spinlock_t *lock);
+
+/* Release a lock.
+ * @param lock      Lock (held).
+ */
+void spin_unlock(spinlock_t *lock);
+
+/* Disable interrupts on this processor, then take a lock (for data that interrupt handlers use too).
+ * @param lock      Lock.
+ * @return          Previous EFLAGS (for spin_unlock_irqrestore()).
+ */
+uint32_t spin_lock_irqsave(spinlock_t *lock);
+
+/* Release a lock, then restore the interrupt flag.
+ * @param lock      Lock (held).
+ * @param flags     Value returned by spin_lock_irqsave().
+ */
+void spin_unlock_irqrestore(spinlock_t *lock, uint32_t flags);
+
+#endif
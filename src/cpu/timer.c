@@ -3,29 +3,241 @@
 // @date     04/01/2020
 
 #include "timer.h"
+#include "smp.h"
+#include "../libc/math.h"
 
-uint32_t tick = 0;
+#define CALIBRATION_TICKS   5 // Ticks to count local APIC timer cycles over
 
-extern void context_switch();
+// Tickless mode: the one-shot device interrupts at the end of the time slice if processes wait for a processor, else
+// on the tick of the nearest kernel timer (see timers.h), and otherwise not at all: ticks are read from the TSC clock
+// (see tsc.h). Without it (TSC not calibrated), the device interrupts at least every longest interval it can time (2
+// ticks for the PIT, a minute or more for the local APIC timer) to keep the tick count, counted from the programmed
+// intervals so no time is lost between interrupts. Events always fall on tick boundaries.
+
+uint32_t tick = 0; // Ticks since boot (when tickless, up to the last timer interrupt only: see timer_get_ticks())
+uint8_t timer_tickless = 0; // Set once the timer is programmed one event at a time
+uint8_t timer_on_lapic = 0; // One-shot device: the local APIC timer of the boot processor (the PIT otherwise)
+uint32_t timer_counts_per_tick; // Counts of the one-shot device in a tick
+uint32_t timer_max_counts; // Longest interval of the one-shot device
+uint32_t timer_armed = 0; // Counts of the interval being timed (0 if stopped)
+uint32_t timer_next_event; // Tick by which the device interrupts, if armed
+uint32_t timer_carry = 0; // Counts elapsed since the last whole tick
+uint64_t timer_clock_base; // Clock time of tick 0 (when ticks are read from the clock)
+uint32_t lapic_timer_per_tick = 0; // Local APIC timer counts in a tick (0 until calibrated)
+
+extern void context_switch(); // From processes.c
+extern uint8_t processes_waiting(); // From processes.c
+extern uint8_t timers_pending(); // From timers.c
+extern uint8_t timers_next(uint32_t *expires); // From timers.c
+
+// Private functions
+
+static void timer_callback(registers_t *r);
+static void timer_program_next();
+static void timer_program(uint32_t counts);
+static void timer_stop();
+static uint32_t timer_clock_ticks(uint32_t *into);
+static uint32_t timer_elapsed();
+static void timer_account(uint32_t counts);
+
+// Public functions
+
+/* Initialize the CPU timer.
+ * @param freq              Frequency.
+ */
+void init_timer(uint32_t freq) {
+    register_interrupt_handler(IRQ0, timer_callback);
+    uint32_t divisor = PIT_HZ / freq;
+    uint8_t low = (uint8_t)(divisor & 0xff);
+    uint8_t high = (uint8_t)((divisor >> 8) & 0xff);
+    outb(PIT_COMMAND, 0x36);
+    outb(PIT_CHANNEL0, low);
+    outb(PIT_CHANNEL0, high);
+}
+
+/* Stop the periodic tick, and program the timer (the local APIC timer if the APIC is in use, the PIT otherwise) one
+ * event at a time from now on: the end of the time slice while processes wait for a processor, else the nearest kernel
+ * timer.
+ * Does nothing if the kernel was built with TICKLESS=0.
+ */
+void timer_tickless_start() {
+    if (!TICKLESS || timer_tickless) return;
+    if (apic_enabled()) {
+        timer_counts_per_tick = lapic_timer_calibrate(); // Needs the periodic tick
+        timer_max_counts = 0xffffffff;
+    } else {
+        timer_counts_per_tick = PIT_HZ / TIMER_HZ;
+        timer_max_counts = PIT_MAX_COUNT;
+    }
+    uint32_t flags;
+    asm volatile("pushf; pop %0; cli" : "=r" (flags) : : "memory");
+    if (apic_enabled()) {
+        irq_set_mask(IRQ0 - IRQ0, 1); // The PIT is no longer needed
+        lapic_write(LAPIC_TIMER_DIVIDE, LAPIC_TIMER_DIV16);
+        lapic_write(LAPIC_LVT_TIMER, IRQ0); // One-shot, on the vector of the PIT (so timer_callback() handles it)
+        timer_on_lapic = 1;
+    } else outb(PIT_COMMAND, 0x30); // Channel 0, low then high byte, mode 0 (interrupt on terminal count)
+    timer_carry = 0;
+    timer_clock_base = ktime_get_ns() - (uint64_t)tick * TIMER_NS_PER_TICK; // Carry on from the periodic count
+    timer_tickless = 1;
+    timer_program_next();
+    asm volatile("push %0; popf" : : "r" (flags) : "memory", "cc");
+}
+
+/* Get the number of ticks since boot (up to date even if the last timer interrupt was long ago).
+ * @return                  Number of ticks.
+ */
+uint32_t timer_get_ticks() {
+    if (!timer_tickless) return *(volatile uint32_t *)&tick;
+    if (tsc_khz() != 0) return timer_clock_ticks(NULL);
+    uint32_t flags, ticks;
+    asm volatile("pushf; pop %0; cli" : "=r" (flags) : : "memory");
+    if (timer_on_lapic && this_cpu()->index != 0) ticks = tick; // The device is the local APIC of the boot processor
+    else {
+        uint32_t elapsed = timer_elapsed();
+        ticks = tick + elapsed / timer_counts_per_tick + (elapsed % timer_counts_per_tick + timer_carry) / timer_counts_per_tick;
+    }
+    asm volatile("push %0; popf" : : "r" (flags) : "memory", "cc");
+    return ticks;
+}
+
+/* Make sure the timer interrupts by some tick (after adding a kernel timer that expires then).
+ * @param expires           Tick.
+ */
+void timer_update(uint32_t expires) {
+    if (!timer_tickless) return; // The periodic tick handles any timer
+    uint32_t flags;
+    asm volatile("pushf; pop %0; cli" : "=r" (flags) : : "memory");
+    if (timer_armed == 0 || (int32_t)(expires - timer_next_event) < 0) {
+        if (timer_on_lapic && this_cpu()->index != 0) smp_kick(smp_cpu(0)); // Its device is on the boot processor
+        else timer_reprogram();
+    }
+    asm volatile("push %0; popf" : : "r" (flags) : "memory", "cc");
+}
+
+/* Program the timer for the next event again (on the processor that owns it, with interrupts disabled).
+ */
+void timer_reprogram() {
+    if (!timer_tickless) return;
+    if (tsc_khz() == 0) timer_account(timer_elapsed()); // Programming the device restarts the interval
+    timer_program_next();
+}
+
+/* Wait for some ticks (interrupts must be enabled).
+ * @param n                 Number of ticks.
+ */
+void timer_wait_ticks(uint32_t n) {
+    uint32_t start = timer_get_ticks();
+    while (timer_get_ticks() - start < n) {
+        if (timer_tickless) asm volatile("pause"); // The next interrupt may be far
+        else asm volatile("hlt");
+    }
+}
+
+/* Count the local APIC timer cycles in a tick, against the PIT (measured on the first call only, while the periodic
+ * tick is still running).
+ * @return                  Local APIC timer count of a tick (divide by 16).
+ */
+uint32_t lapic_timer_calibrate() {
+    if (lapic_timer_per_tick != 0) return lapic_timer_per_tick;
+    lapic_write(LAPIC_TIMER_DIVIDE, LAPIC_TIMER_DIV16);
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED);
+    timer_wait_ticks(1); // Start right after a tick
+    lapic_write(LAPIC_TIMER_INITIAL, 0xffffffff);
+    timer_wait_ticks(CALIBRATION_TICKS);
+    uint32_t elapsed = 0xffffffff - lapic_read(LAPIC_TIMER_CURRENT);
+    lapic_write(LAPIC_TIMER_INITIAL, 0); // Stop it
+    lapic_timer_per_tick = elapsed / CALIBRATION_TICKS;
+    return lapic_timer_per_tick;
+}
+
+// Private functions
 
 /* Handler for the timer interrupts.
  * @param r             CPU state (registers).
  */
 static void timer_callback(registers_t *r) {
-    ++tick;
+    if (timer_tickless) {
+        if (tsc_khz() != 0) tick = timer_clock_ticks(NULL);
+        else timer_account(timer_armed); // The whole interval elapsed
+        timer_program_next(); // Before switching: a process that never ran before does not return here
+    } else ++tick;
+    if (timers_pending()) raise_softirq(SOFTIRQ_TIMER); // Expired timers run once the handler returns
     context_switch(); // Schedule a new process
     (void)(r); // Unused parameter
 }
 
-/* Initialize the CPU timer.
- * @param freq              Frequency.
+/* Program the one-shot device for the next event (with interrupts disabled).
  */
-void init_timer(uint32_t freq) {
-    register_interrupt_handler(IRQ0, timer_callback);
-    uint32_t divisor = 1193180 / freq;
-    uint8_t low = (uint8_t)(divisor & 0xff);
-    uint8_t high = (uint8_t)((divisor >> 8) & 0xff);
-    outb(0x43, 0x36);
-    outb(0x40, low);
-    outb(0x40, high);
-}
\ No newline at end of file
+static void timer_program_next() {
+    uint32_t now = tick, into = timer_carry, ticks = 0, expires; // Without the clock, the tick count is up to date here
+    if (tsc_khz() != 0) now = timer_clock_ticks(&into);
+    if (processes_waiting()) ticks = 1; // End of the time slice
+    else if (timers_next(&expires)) ticks = ((int32_t)(expires - now) > 0)? expires - now : 1; // Nearest timer
+    if (ticks == 0 && tsc_khz() != 0) { // No event
+        timer_stop();
+        return;
+    }
+    uint32_t longest = timer_max_counts / timer_counts_per_tick; // Whole ticks the device can time
+    if (ticks == 0 || ticks > longest) ticks = longest; // Keep the tick count, or come back later
+    timer_next_event = now + ticks;
+    timer_program(ticks * timer_counts_per_tick - into); // Up to the tick boundary
+}
+
+/* Start timing an interval.
+ * @param counts        Length of the interval (in counts of the device, at least 1).
+ */
+static void timer_program(uint32_t counts) {
+    if (!timer_on_lapic && counts > PIT_MAX_COUNT) counts = PIT_MAX_COUNT;
+    timer_armed = counts;
+    if (timer_on_lapic) lapic_write(LAPIC_TIMER_INITIAL, counts); // Writing the initial count restarts the timer
+    else {
+        outb(PIT_CHANNEL0, counts & 0xff); // Writing the count restarts the counter (mode 0)
+        outb(PIT_CHANNEL0, (counts >> 8) & 0xff);
+    }
+}
+
+/* Stop timing (no interrupt until the next timer_program()).
+ */
+static void timer_stop() {
+    timer_armed = 0;
+    if (timer_on_lapic) lapic_write(LAPIC_TIMER_INITIAL, 0);
+    else outb(PIT_COMMAND, 0x30); // Setting the mode again stops the counter until a count is written
+}
+
+/* Get how much of the current interval has elapsed (with interrupts disabled).
+ * @return              Counts of the device.
+ */
+static uint32_t timer_elapsed() {
+    if (timer_on_lapic) return timer_armed - lapic_read(LAPIC_TIMER_CURRENT); // The current count stops at 0
+    outb(PIT_COMMAND, 0x00); // Latch the count of channel 0
+    uint32_t count = inb(PIT_CHANNEL0);
+    count |= inb(PIT_CHANNEL0) << 8;
+    return (count <= timer_armed)? timer_armed - count : timer_armed; // Past 0 the counter wraps (the interrupt is pending)
+}
+
+/* Add elapsed time to the tick count.
+ * @param counts        Counts of the device.
+ */
+static void timer_account(uint32_t counts) {
+    tick += counts / timer_counts_per_tick;
+    timer_carry += counts % timer_counts_per_tick;
+    if (timer_carry >= timer_counts_per_tick) {
+        timer_carry -= timer_counts_per_tick;
+        ++tick;
+    }
+}
+
+/* Get the number of ticks since boot from the TSC clock.
+ * @param into          Set to the counts of the device elapsed since the last tick (NULL if not needed).
+ * @return              Number of ticks.
+ */
+static uint32_t timer_clock_ticks(uint32_t *into) {
+    uint64_t ns = ktime_get_ns() - timer_clock_base;
+    uint64_t counts = (uint64_t)div_u64(&ns, TIMER_NS_PER_TICK) * timer_counts_per_tick;
+    if (into != NULL) {
+        div_u64(&counts, TIMER_NS_PER_TICK);
+        *into = (uint32_t)counts;
+    }
+    return (uint32_t)ns;
+}
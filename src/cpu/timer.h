@@ -8,11 +8,58 @@
 #include <stdint.h>
 #include "../drivers/vga.h"
 #include "../libc/string.h"
+#include "apic.h"
 #include "isr.h"
+#include "tsc.h"
+
+#ifndef TICKLESS
+#define TICKLESS            1 // Program the timer for the next event only, instead of a periodic tick (see the makefile)
+#endif
+
+#define TIMER_HZ            50 // Scheduler ticks per second (a time slice is one tick)
+#define TIMER_NS_PER_TICK   (1000000000 / TIMER_HZ)
+#define PIT_HZ              1193182 // Input clock of the PIT
+#define PIT_MAX_COUNT       0xffff
+#define PIT_CHANNEL0        0x40
+#define PIT_CHANNEL2        0x42
+#define PIT_COMMAND         0x43
+#define PIT_GATE            0x61 // Gate (bit 0) and output (bit 5) of channel 2, in the keyboard controller port B
 
 /* Initialize the CPU timer.
  * @param freq              Frequency.
  */
 void init_timer(uint32_t freq);
 
-#endif
\ No newline at end of file
+/* Stop the periodic tick, and program the timer (the local APIC timer if the APIC is in use, the PIT otherwise) one
+ * event at a time from now on: the end of the time slice while processes wait for a processor, else the nearest kernel
+ * timer.
+ * Does nothing if the kernel was built with TICKLESS=0.
+ */
+void timer_tickless_start();
+
+/* Get the number of ticks since boot (up to date even if the last timer interrupt was long ago).
+ * @return                  Number of ticks.
+ */
+uint32_t timer_get_ticks();
+
+/* Make sure the timer interrupts by some tick (after adding a kernel timer that expires then).
+ * @param expires           Tick.
+ */
+void timer_update(uint32_t expires);
+
+/* Program the timer for the next event again (on the processor that owns it, with interrupts disabled).
+ */
+void timer_reprogram();
+
+/* Wait for some ticks (interrupts must be enabled).
+ * @param n                 Number of ticks.
+ */
+void timer_wait_ticks(uint32_t n);
+
+/* Count the local APIC timer cycles in a tick, against the PIT (measured on the first call only, while the periodic
+ * tick is still running).
+ * @return                  Local APIC timer count of a tick (divide by 16).
+ */
+uint32_t lapic_timer_calibrate();
+
+#endif
@@ -0,0 +1,63 @@
+; @desc     Startup code of the application processors (copied below 1MB, where they start in real mode)
+; @author   Davide Della Giustina
+; @date     19/10/2026
+
+TRAMPOLINE_ADDR equ 0x6000 ; Physical address the code is copied to (must match SMP_TRAMPOLINE_ADDR in smp.h)
+
+; Physical address of a label of the copy (only label differences are used, so the code runs wherever it is copied).
+; @param 1          Label.
+%define PHYS(label) (TRAMPOLINE_ADDR + (label - trampoline_start))
+
+global trampoline_start
+global trampoline_end
+global trampoline_cr3
+global trampoline_stack
+global trampoline_entry
+
+section .text
+
+; The processor starts here in real mode, at TRAMPOLINE_ADDR, after the startup IPI
+[bits 16]
+trampoline_start:
+    cli
+    cld
+    xor ax, ax
+    mov ds, ax
+    lgdt [PHYS(trampoline_gdt_descriptor)] ; Flat code and data segments
+    mov eax, cr0
+    or eax, 0x1 ; Protected mode
+    mov cr0, eax
+    jmp dword 0x08:PHYS(trampoline_32) ; Far jump: load the code segment
+
+[bits 32]
+trampoline_32:
+    mov ax, 0x10
+    mov ds, ax
+    mov es, ax
+    mov fs, ax
+    mov gs, ax
+    mov ss, ax
+    mov eax, [PHYS(trampoline_cr3)] ; Kernel page directory (it maps this page at its physical address too, for now)
+    mov cr3, eax
+    mov eax, cr0
+    or eax, 0x80000000 ; Paging
+    mov cr0, eax
+    mov esp, [PHYS(trampoline_stack)]
+    xor ebp, ebp
+    mov eax, [PHYS(trampoline_entry)]
+    jmp eax ; Into the higher half, never to return
+
+align 8
+trampoline_gdt:
+    dq 0x0 ; Null descriptor
+    dq 0x00cf9a000000ffff ; Code: base 0, limit 4GB, ring 0, readable (same as the boot GDT)
+    dq 0x00cf92000000ffff ; Data: base 0, limit 4GB, ring 0, writable
+trampoline_gdt_descriptor:
+    dw trampoline_gdt_descriptor - trampoline_gdt - 1
+    dd PHYS(trampoline_gdt)
+
+; Filled in by the boot processor, in the copy
+trampoline_cr3: dd 0 ; Physical address of the page directory
+trampoline_stack: dd 0 ; Top of the stack of the processor
+trampoline_entry: dd 0 ; C entry point
+trampoline_end:
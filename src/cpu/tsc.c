@@ -0,0 +1,98 @@
+// @desc     Time stamp counter
+// @author   Davide Della Giustina
+// @date     19/10/2026
+
+#include "tsc.h"
+#include "../kernel/klog.h"
+#include "../libc/math.h"
+#include "ports.h"
+#include "timer.h"
+
+// The clock is the TSC scaled by a fixed-point factor: ns = (cycles * tsc_mult) >> TSC_SHIFT. Reading it takes no lock
+// and no device access, only these constants, so user space could do the same once they are mapped into it. The TSCs
+// of all the processors are assumed to tick at the same rate and in sync (as on CPUs with an invariant TSC).
+
+uint32_t tsc_frequency = 0; // kHz (0 until calibrated)
+uint32_t tsc_mult = 0; // Nanoseconds per cycle, times 2^TSC_SHIFT
+
+// Private functions
+
+static uint64_t tsc_measure(uint32_t counts);
+
+// Public functions
+
+/* Read the time stamp counter.
+ * @return          Number of CPU cycles since reset.
+ */
+uint64_t read_tsc() {
+    uint64_t result;
+    asm volatile("rdtsc" : "=A" (result));
+    return result;
+}
+
+/* Measure the frequency of the time stamp counter against channel 2 of the PIT (it needs no interrupts, so it can run
+ * first thing at boot).
+ * @return          Frequency (kHz), 0 if the PIT did not answer (the TSC clock then stays unusable).
+ */
+uint32_t tsc_init() {
+    uint32_t counts = PIT_HZ / 1000 * TSC_CALIBRATION_MS, i;
+    uint64_t cycles = 0xffffffffffffffffULL;
+    for (i = 0; i < TSC_CALIBRATION_RUNS; ++i) { // Delays only ever make a measure longer
+        uint64_t run = tsc_measure(counts);
+        if (run == 0) break; // Timed out
+        if (run < cycles) cycles = run;
+    }
+    uint64_t khz = cycles * PIT_HZ; // cycles / (counts / PIT_HZ) seconds, in kHz
+    div_u64(&khz, counts * 1000);
+    if (i < TSC_CALIBRATION_RUNS || khz == 0 || khz > 0xffffffff) {
+        klog(KLOG_WARN, "TSC: calibration failed, no nanosecond clock\n");
+        return 0;
+    }
+    uint64_t mult = 1000000ULL << TSC_SHIFT; // Nanoseconds in a millisecond over cycles in a millisecond
+    div_u64(&mult, (uint32_t)khz);
+    tsc_mult = (uint32_t)mult;
+    tsc_frequency = (uint32_t)khz;
+    klog(KLOG_INFO, "TSC: %u.%03u MHz\n", tsc_frequency / 1000, tsc_frequency % 1000);
+    return tsc_frequency;
+}
+
+/* Get the frequency of the time stamp counter.
+ * @return          Frequency (kHz), 0 until tsc_init() is done.
+ */
+uint32_t tsc_khz() {
+    return tsc_frequency;
+}
+
+/* Convert TSC cycles to nanoseconds.
+ * @param cycles    Number of cycles.
+ * @return          Number of nanoseconds (0 until tsc_init() is done).
+ */
+uint64_t cycles_to_ns(uint64_t cycles) {
+    return mul_u64_u32_shr(cycles, tsc_mult, TSC_SHIFT);
+}
+
+/* Get the monotonic clock, with nanosecond resolution.
+ * @return          Nanoseconds since reset (0 until tsc_init() is done).
+ */
+uint64_t ktime_get_ns() {
+    return cycles_to_ns(read_tsc());
+}
+
+// Private functions
+
+/* Count the TSC cycles while channel 2 of the PIT counts down (its gate is the only thing it needs, not interrupts).
+ * @param counts    PIT counts to wait for (at most PIT_MAX_COUNT).
+ * @return          Number of cycles, 0 if the output never went high (no PIT, or its channel 2 is not wired).
+ */
+static uint64_t tsc_measure(uint32_t counts) {
+    outb(PIT_GATE, (inb(PIT_GATE) & ~0x02) | 0x01); // Gate channel 2 on, speaker off
+    outb(PIT_COMMAND, 0xb0); // Channel 2, low then high byte, mode 0 (output set on terminal count)
+    outb(PIT_CHANNEL2, counts & 0xff);
+    outb(PIT_CHANNEL2, (counts >> 8) & 0xff); // Counting starts now
+    uint64_t start = read_tsc();
+    uint32_t polls = TSC_CALIBRATION_POLLS;
+    while (!(inb(PIT_GATE) & 0x20) && --polls > 0); // Output of channel 2
+    uint64_t end = read_tsc();
+    outb(PIT_GATE, inb(PIT_GATE) & ~0x01); // Gate it off
+    return polls > 0 ? end - start : 0;
+}
@@ -0,0 +1,42 @@
+// @desc     Time stamp counter header
+// @author   Davide Della Giustina
+// @date     19/10/2026
+
+#ifndef TSC_H
+#define TSC_H
+
+#include <stdint.h>
+
+#define TSC_CALIBRATION_RUNS 5 // PIT intervals to time the TSC over (the shortest measure is kept)
+#define TSC_CALIBRATION_MS  10 // Length of each interval
+#define TSC_CALIBRATION_POLLS 1000000 // Reads of the PIT output before giving up on an interval (each takes about 1us)
+#define TSC_SHIFT           22 // Fixed-point shift of the nanoseconds per cycle (exact enough down to 1MHz)
+
+/* Read the time stamp counter.
+ * @return          Number of CPU cycles since reset.
+ */
+uint64_t read_tsc();
+
+/* Measure the frequency of the time stamp counter against channel 2 of the PIT (it needs no interrupts, so it can run
+ * first thing at boot).
+ * @return          Frequency (kHz), 0 if the PIT did not answer (the TSC clock then stays unusable).
+ */
+uint32_t tsc_init();
+
+/* Get the frequency of the time stamp counter.
+ * @return          Frequency (kHz), 0 until tsc_init() is done.
+ */
+uint32_t tsc_khz();
+
+/* Convert TSC cycles to nanoseconds.
+ * @param cycles    Number of cycles.
+ * @return          Number of nanoseconds (0 until tsc_init() is done).
+ */
+uint64_t cycles_to_ns(uint64_t cycles);
+
+/* Get the monotonic clock, with nanosecond resolution.
+ * @return          Nanoseconds since reset (0 until tsc_init() is done).
+ */
+uint64_t ktime_get_ns();
+
+#endif
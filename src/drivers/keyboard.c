@@ -13,8 +13,23 @@
 #define RSHIFT              0x36
 #define LCTRL               0x1d
 #define LALT                0x38
+#define PGUP                0x49
+#define PGDN                0x51
+#define SCROLL_STEP         12 // Lines moved by Shift+PgUp/PgDn (half a screen)
 
 static char buff[1024];
+static strbuf_t line = { buff, 0, sizeof(buff) }; // Line being typed (its length is tracked, not recomputed)
+
+// The interrupt handler only queues scancodes in a ring (it is the only writer of the head, keyboard_bottom_half() the
+// only writer of the tail), so decoding, echoing and running commands happen in the kernel worker.
+static uint8_t scancodes[KEYBOARD_BUFFER_SIZE];
+volatile uint32_t scancodes_head = 0; // Next scancode to write (free running)
+volatile uint32_t scancodes_tail = 0; // Next scancode to read (free running)
+uint32_t scancodes_dropped = 0; // Scancodes lost because the ring was full
+
+static void keyboard_bottom_half(void *data);
+work_t keyboard_work = WORK_INIT(keyboard_bottom_half, NULL);
+
 int shift_pressed = 0;
 int ctrl_pressed = 0;
 int alt_pressed = 0;
@@ -27,11 +42,24 @@ const char keys_shift[] = { '?' /* Error */, '?' /* Esc */, '!', '"', (char)156
     'U', 'I', 'O', 'P', '?' /* ? */, '^', '?' /* Enter */, '?' /* LCtrl */, 'A', 'S', 'D', 'F', 'G', 'H', 'J', 'K', 'L', (char)130 /* é */, (char)167 /* ° */, (char)135 /* ç */, '?' /* LShift */, '|',
     'Z', 'X', 'C', 'V', 'B', 'N', 'M', ';', ':', (char)245 /* § */, '?' /* RShift */, '?' /* Keypad * */, '?' /* LAlt */, ' ' /* Space */ };
 
-/* Handler for the keyboard interrupts.
+/* Handler for the keyboard interrupts: only queue the scancode (keyboard_bottom_half() handles it later).
  * @param r             CPU state (registers).
  */
 static void keyboard_callback(registers_t *r) {
     uint8_t scancode = inb(SCANCODE_PORT);
+    uint32_t head = scancodes_head;
+    if (head - scancodes_tail < KEYBOARD_BUFFER_SIZE) {
+        scancodes[head % KEYBOARD_BUFFER_SIZE] = scancode;
+        scancodes_head = head + 1; // Publish the scancode
+    } else ++scancodes_dropped;
+    work_queue(&keyboard_work);
+    (void)(r); // Unused parameter
+}
+
+/* Decode a scancode and act on it.
+ * @param scancode      Scancode.
+ */
+static void handle_scancode(uint8_t scancode) {
     // Special keys (shift, ctrl, alt)
     if (scancode == LSHIFT || scancode == RSHIFT) shift_pressed = 1;
     else if (scancode == LSHIFT + KEYUP_EVENT_OFFSET || scancode == RSHIFT + KEYUP_EVENT_OFFSET) shift_pressed = 0;
@@ -39,34 +67,51 @@ static void keyboard_callback(registers_t *r) {
     else if (scancode == LCTRL + KEYUP_EVENT_OFFSET) ctrl_pressed = 0;
     else if (scancode == LALT) alt_pressed = 1;
     else if (scancode == LALT + KEYUP_EVENT_OFFSET) alt_pressed = 0;
+    // Scrollback (Shift+PgUp/PgDn)
+    else if (scancode == PGUP && shift_pressed) vga_scroll_view(SCROLL_STEP);
+    else if (scancode == PGDN && shift_pressed) vga_scroll_view(-SCROLL_STEP);
     // Unhandled scancodes
     else if (scancode > SC_MAX) return;
-    // Backspace
-    else if (scancode == BACKSPACE) {
-        if (strlen(buff) > 0) {
-            str_truncate(buff, 1);
-            clear_last_char();
-        }
-    // Enter
-    } else if (scancode == ENTER) {
-        kprint("\n");
-        parse_input(buff);
-        buff[0] = '\0';
-    // Other characters
-    } else {
-        char c;
-        if (shift_pressed) c = keys_shift[(int)scancode];
-        else c = keys[(int)scancode];
-        char str[2] = { c, '\0' };
-        strncat(buff, &c, 1);
-        kprint(str);
-    }
+    // Characters
+    else if (scancode == BACKSPACE) console_input('\b');
+    else if (scancode == ENTER) console_input('\n');
+    else console_input(shift_pressed? keys_shift[(int)scancode] : keys[(int)scancode]);
     (void)(layout); // Unused parameter
-    (void)(r); // Unused parameter
 }
 
 /* Initialize keryboard listener.
  */
 void init_keyboard() {
     register_interrupt_handler(IRQ1, keyboard_callback);
+}
+
+/* Handle the queued scancodes (in the kernel worker: this may run a whole shell command).
+ * @param data          Unused.
+ */
+static void keyboard_bottom_half(void *data) {
+    while (scancodes_tail != scancodes_head) {
+        uint8_t scancode = scancodes[scancodes_tail % KEYBOARD_BUFFER_SIZE];
+        ++scancodes_tail; // Free the slot
+        handle_scancode(scancode);
+    }
+    (void)(data); // Unused parameter
+}
+
+/* Feed a character to the shell line (from the keyboard or the serial port).
+ * @param c             Character ('\b' deletes the last one, '\n' runs the line).
+ */
+void console_input(char c) {
+    if (c == '\b') {
+        if (line.len > 0) {
+            strbuf_truncate(&line, 1);
+            clear_last_char();
+        }
+    } else if (c == '\n') {
+        kprint("\n");
+        parse_input(line.buf, line.len);
+        strbuf_clear(&line);
+    } else {
+        char str[2] = { c, '\0' };
+        if (strbuf_putc(&line, c)) kprint(str); // Keys beyond the end of the buffer are ignored
+    }
 }
\ No newline at end of file
@@ -9,11 +9,20 @@
 #include "../cpu/isr.h"
 #include "../cpu/ports.h"
 #include "../kernel/shell.h"
+#include "../kernel/softirq.h"
+#include "../libc/strbuf.h"
 #include "../libc/string.h"
 #include "vga.h"
 
+#define KEYBOARD_BUFFER_SIZE 64 // Scancodes queued between the interrupt and the kernel worker (power of two)
+
 /* Initialize keryboard listener.
  */
 void init_keyboard();
 
+/* Feed a character to the shell line (from the keyboard or the serial port).
+ * @param c             Character ('\b' deletes the last one, '\n' runs the line).
+ */
+void console_input(char c);
+
 #endif
\ No newline at end of file
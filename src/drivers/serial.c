@@ -0,0 +1,165 @@
+// @desc     Serial port (16550 UART) driver
+// @author   Davide Della Giustina
+// @date     19/10/2026
+
+#include "serial.h"
+#include "../cpu/isr.h"
+#include "keyboard.h"
+
+#define REG_DATA            0 // Receive / transmit holding register (divisor low byte with DLAB)
+#define REG_IER             1 // Interrupt enable (divisor high byte with DLAB)
+#define REG_IIR             2 // Interrupt identification (FIFO control when written)
+#define REG_LCR             3 // Line control
+#define REG_MCR             4 // Modem control
+#define REG_LSR             5 // Line status
+#define REG_MSR             6 // Modem status
+
+#define IER_RX              0x1 // Received data available
+#define IER_TX              0x2 // Transmitter holding register empty
+#define LSR_DATA_READY      0x1
+#define LSR_TX_EMPTY        0x20
+#define IIR_NONE            0x1 // No interrupt pending
+
+// The interrupt handler drains the receiver and refills the transmitter FIFO, 16 bytes at a time, from the rings:
+// writers only copy into memory, so printing never waits for the line.
+
+static uint8_t tx_data[SERIAL_TX_SIZE];
+static uint8_t rx_data[SERIAL_RX_SIZE];
+serial_ring_t serial_tx = { tx_data, SERIAL_TX_SIZE - 1, 0, 0, 0 };
+serial_ring_t serial_rx = { rx_data, SERIAL_RX_SIZE - 1, 0, 0, 0 };
+uint8_t serial_found = 0;
+volatile uint8_t tx_busy = 0; // Set while the transmitter has bytes to send (the next interrupt refills it)
+spinlock_t tx_lock = SPINLOCK_INIT; // Transmit ring and transmitter (writers may run on any processor)
+
+// Private functions
+
+static void serial_callback(registers_t *r);
+static void serial_bottom_half(void *data);
+static void tx_fill();
+static uint8_t ring_put(serial_ring_t *ring, uint8_t c);
+
+work_t serial_work = WORK_INIT(serial_bottom_half, NULL); // Hands the received characters to the shell
+
+// Public functions
+
+/* Initialize COM1 (115200 baud, 8N1, FIFOs enabled) and its interrupt.
+ * @return          Zero if there is no UART.
+ */
+uint8_t serial_init() {
+    outb(COM1 + REG_IER, 0x00); // No interrupts while configuring
+    outb(COM1 + REG_LCR, 0x80); // Set DLAB, to write the divisor
+    outb(COM1 + REG_DATA, 0x01); // 115200 baud
+    outb(COM1 + REG_IER, 0x00);
+    outb(COM1 + REG_LCR, 0x03); // 8 bits, no parity, 1 stop bit
+    outb(COM1 + REG_IIR, 0xc7); // Enable and clear the FIFOs, receive interrupt at 14 bytes
+    outb(COM1 + REG_MCR, 0x1e); // Loopback mode, to check that the UART is there
+    outb(COM1 + REG_DATA, 0xae);
+    if (inb(COM1 + REG_DATA) != 0xae) return 0;
+    outb(COM1 + REG_MCR, 0x0b); // DTR, RTS and OUT2 (which routes the interrupt to the PIC)
+    register_interrupt_handler(IRQ4, serial_callback);
+    irq_set_mask(IRQ4 - IRQ0, 0);
+    outb(COM1 + REG_IER, IER_RX | IER_TX);
+    serial_found = 1;
+    return 1;
+}
+
+/* Queue bytes for transmission (never waits: bytes that do not fit are dropped).
+ * @param buf       Bytes ('\n' is sent as "\r\n").
+ * @param len       Number of bytes.
+ */
+void serial_write(const char *buf, int len) {
+    if (!serial_found) return;
+    uint32_t flags = spin_lock_irqsave(&tx_lock); // Writers may interrupt each other
+    int i;
+    for (i = 0; i < len; ++i) {
+        if (buf[i] == '\n') ring_put(&serial_tx, '\r');
+        ring_put(&serial_tx, buf[i]);
+    }
+    if (!tx_busy) tx_fill(); // Idle transmitter: no interrupt is coming, so start it
+    spin_unlock_irqrestore(&tx_lock, flags);
+}
+
+/* Take received bytes.
+ * @param buf       Buffer.
+ * @param len       Size of the buffer.
+ * @return          Number of bytes read (0 if none was waiting).
+ */
+int serial_read(char *buf, int len) {
+    int n = 0;
+    uint32_t tail = serial_rx.tail;
+    while (n < len && tail != serial_rx.head) buf[n++] = serial_rx.data[tail++ & serial_rx.mask];
+    serial_rx.tail = tail;
+    return n;
+}
+
+/* Check whether a UART was found.
+ * @return          Nonzero if COM1 works.
+ */
+uint8_t serial_present() {
+    return serial_found;
+}
+
+// Private functions
+
+/* Handler for the serial port interrupts.
+ * @param r         CPU state (registers).
+ */
+static void serial_callback(registers_t *r) {
+    (void)(r); // Unused parameter
+    uint8_t iir;
+    while (!((iir = inb(COM1 + REG_IIR)) & IIR_NONE)) {
+        switch ((iir >> 1) & 0x7) {
+            case 0x0: inb(COM1 + REG_MSR); break; // Modem status changed
+            case 0x3: inb(COM1 + REG_LSR); break; // Line error
+            case 0x1: // Transmitter FIFO empty
+                spin_lock(&tx_lock);
+                tx_fill();
+                spin_unlock(&tx_lock);
+                break;
+            default: // Received data (or receive timeout)
+                while (inb(COM1 + REG_LSR) & LSR_DATA_READY) ring_put(&serial_rx, inb(COM1 + REG_DATA));
+                work_queue(&serial_work);
+        }
+    }
+}
+
+/* Hand the received characters to the shell (in the kernel worker: this may run a whole shell command).
+ * @param data      Unused.
+ */
+static void serial_bottom_half(void *data) {
+    char buf[16];
+    int i, n;
+    while ((n = serial_read(buf, sizeof(buf))) > 0) {
+        for (i = 0; i < n; ++i) {
+            if (buf[i] == '\r') console_input('\n');
+            else if (buf[i] == 0x7f || buf[i] == 0x08) console_input('\b');
+            else if (buf[i] >= ' ') console_input(buf[i]); // Other control characters (and escape sequences) are ignored
+        }
+    }
+    (void)(data); // Unused parameter
+}
+
+/* Move up to a FIFO worth of bytes from the transmit ring to the UART (with interrupts disabled and tx_lock held).
+ */
+static void tx_fill() {
+    uint32_t tail = serial_tx.tail, n = 0;
+    while (n++ < SERIAL_FIFO_SIZE && tail != serial_tx.head) outb(COM1 + REG_DATA, serial_tx.data[tail++ & serial_tx.mask]);
+    serial_tx.tail = tail;
+    tx_busy = (n > 1); // Something was sent: an interrupt will come when the FIFO is empty
+}
+
+/* Add a byte to a ring.
+ * @param ring      Ring.
+ * @param c         Byte.
+ * @return          Zero if the ring was full (the byte is dropped).
+ */
+static uint8_t ring_put(serial_ring_t *ring, uint8_t c) {
+    uint32_t head = ring->head;
+    if (head - ring->tail > ring->mask) {
+        ++ring->dropped;
+        return 0;
+    }
+    ring->data[head & ring->mask] = c;
+    ring->head = head + 1;
+    return 1;
+}
@@ -0,0 +1,50 @@
+// @desc     Serial port (16550 UART) driver header
+// @author   Davide Della Giustina
+// @date     19/10/2026
+
+#ifndef SERIAL_H
+#define SERIAL_H
+
+#include <stdint.h>
+#include "../cpu/ports.h"
+#include "../cpu/spinlock.h"
+#include "../kernel/softirq.h"
+
+#define COM1                0x3f8
+#define SERIAL_FIFO_SIZE    16 // Bytes the transmitter FIFO takes at once
+#define SERIAL_TX_SIZE      4096 // Size of the transmit ring (power of two)
+#define SERIAL_RX_SIZE      256 // Size of the receive ring (power of two)
+
+// Ring buffer with one producer and one consumer: each side only writes its own index, so no lock is needed
+typedef struct {
+    uint8_t *data;
+    uint32_t mask; // Size - 1
+    volatile uint32_t head; // Next byte to write (free running, written by the producer only)
+    volatile uint32_t tail; // Next byte to read (free running, written by the consumer only)
+    uint32_t dropped; // Bytes dropped because the ring was full
+} serial_ring_t;
+
+/* Initialize COM1 (115200 baud, 8N1, FIFOs enabled) and its interrupt.
+ * @return          Zero if there is no UART.
+ */
+uint8_t serial_init();
+
+/* Queue bytes for transmission (never waits: bytes that do not fit are dropped).
+ * @param buf       Bytes ('\n' is sent as "\r\n").
+ * @param len       Number of bytes.
+ */
+void serial_write(const char *buf, int len);
+
+/* Take received bytes.
+ * @param buf       Buffer.
+ * @param len       Size of the buffer.
+ * @return          Number of bytes read (0 if none was waiting).
+ */
+int serial_read(char *buf, int len);
+
+/* Check whether a UART was found.
+ * @return          Nonzero if COM1 works.
+ */
+uint8_t serial_present();
+
+#endif
@@ -4,6 +4,23 @@
 
 #include "vga.h"
 
+// The cursor position is kept in software: reading the hardware one takes four port I/Os, and writing it four more, so
+// the hardware cursor is only written once per call.
+int cursor_offset = -1; // Current cursor position (memory offset), -1 until read from the hardware
+
+// The screen is a window over video memory that the CRTC start address moves down one line at a time, so scrolling
+// copies nothing; only when the window reaches the end of video memory is it moved back to the top. Lines that leave
+// the screen are kept in a ring buffer, so that they can be shown again.
+int screen_top = 0; // First row of video memory on the screen
+uint16_t *scrollback = NULL; // History (ring of lines)
+int scrollback_size = 0; // Capacity of the history (in lines)
+int scrollback_head = 0; // Next line of the history to write
+int scrollback_count = 0; // Lines in the history
+int view_back = 0; // Lines the view is scrolled back by (0 => live screen)
+
+// Everything printed can also go to the serial port, which only queues it (see serial.c)
+uint8_t console_outputs = (SERIAL_CONSOLE == 0)? CONSOLE_VGA : (SERIAL_CONSOLE == 1)? CONSOLE_VGA | CONSOLE_SERIAL : CONSOLE_SERIAL;
+
 // Private functions
 uint8_t get_attribute(vga_color fg, vga_color bg);
 int get_cursor_offset();
@@ -13,6 +30,10 @@ int get_offset_row(int offset);
 int get_offset_col(int offset);
 int handle_scrolling(int offset);
 int print_char(char character, int row, int col, vga_color fg, vga_color bg);
+int write_chars(const char *buf, int len, int offset, uint8_t attribute);
+uint16_t *get_screen();
+void set_screen_start(int row);
+void show_live_screen();
 
 /* Print a string at the specified cursor position.
  * @param msg       String to print.
@@ -20,17 +41,11 @@ int print_char(char character, int row, int col, vga_color fg, vga_color bg);
  * @param col       Cursor column index.
  */
 void kprint_at(char *msg, int row, int col) {
-    if (row < 0 || col < 0) {
-        int offset = get_cursor_offset();
-        row = get_offset_row(offset);
-        col = get_offset_col(offset);
-    }
-    int i = 0;
-    while (msg[i] != 0) {
-        int offset = print_char(msg[i++], row, col, FG_DEFAULT, BG_DEFAULT);
-        row = get_offset_row(offset);
-        col = get_offset_col(offset);
-    }
+    int len = strlen(msg);
+    if (console_outputs & CONSOLE_SERIAL) serial_write(msg, len); // The position is meaningless there
+    if (!(console_outputs & CONSOLE_VGA)) return;
+    int offset = ((row >= 0 && col >= 0)? get_offset(row, col) : get_cursor_offset());
+    set_cursor_offset(write_chars(msg, len, offset, get_attribute(FG_DEFAULT, BG_DEFAULT)));
 }
 
 /* Print a string at the current cursor position.
@@ -40,28 +55,96 @@ void kprint(char *msg) {
     kprint_at(msg, -1, -1);
 }
 
+/* Print #len characters at the current cursor position, moving the cursor just once.
+ * @param buf       Characters to print.
+ * @param len       Number of characters.
+ */
+void kwrite(char *buf, int len) {
+    if (console_outputs & CONSOLE_SERIAL) serial_write(buf, len);
+    if (!(console_outputs & CONSOLE_VGA)) return;
+    set_cursor_offset(write_chars(buf, len, get_cursor_offset(), get_attribute(FG_DEFAULT, BG_DEFAULT)));
+}
+
 /* Clear the entire screen.
  */
 void clear_screen() {
+    if (console_outputs & CONSOLE_SERIAL) serial_write("\033[2J\033[H", 7); // ANSI: erase the terminal, cursor home
     int screen_size = MAX_COLS * MAX_ROWS;
-    unsigned char *screen = (unsigned char *)VIDEO_ADDRESS;
+    uint16_t *screen = (uint16_t *)VIDEO_ADDRESS;
+    uint16_t blank = (get_attribute(FG_DEFAULT, BG_DEFAULT) << 8) | ' ';
     int i;
-    for (i = 0; i < screen_size; ++i) {
-        screen[2*i] = ' ';
-        screen[2*i+1] = get_attribute(FG_DEFAULT, BG_DEFAULT);
-    }
+    for (i = 0; i < screen_size; ++i) screen[i] = blank;
+    view_back = 0;
+    screen_top = 0;
+    set_screen_start(0);
     set_cursor_offset(get_offset(0, 0));
 }
 
 /* Print a backspace (i.e. delete last char on the screen).
  */
 void clear_last_char() {
+    if (console_outputs & CONSOLE_SERIAL) serial_write("\b \b", 3);
+    if (!(console_outputs & CONSOLE_VGA)) return;
     int offset = get_cursor_offset() - 2;
     int row = get_offset_row(offset);
     int col = get_offset_col(offset);
     print_char(0x08, row, col, FG_DEFAULT, BG_DEFAULT);
 }
 
+/* Choose where the console output goes.
+ * @param outputs   CONSOLE_VGA, CONSOLE_SERIAL or both.
+ */
+void console_set_outputs(uint8_t outputs) {
+    console_outputs = outputs;
+}
+
+/* Tell where the console output goes.
+ * @return          CONSOLE_VGA, CONSOLE_SERIAL or both.
+ */
+uint8_t console_get_outputs() {
+    return console_outputs;
+}
+
+/* Start keeping the lines that scroll off the screen.
+ * @param buf       Buffer for the history.
+ * @param size      Size of the buffer (in bytes).
+ */
+void vga_scrollback_init(void *buf, uint32_t size) {
+    scrollback = (uint16_t *)buf;
+    scrollback_size = size / (2 * MAX_COLS);
+    scrollback_head = 0;
+    scrollback_count = 0;
+}
+
+/* Move the view through the history (any output goes back to the live screen).
+ * @param lines     Number of lines to go back (negative to go forward).
+ */
+void vga_scroll_view(int lines) {
+    int back = view_back + lines, row;
+    if (back > scrollback_count) back = scrollback_count;
+    if (back <= 0) {
+        show_live_screen();
+        return;
+    }
+    view_back = back;
+    // Compose the view in video memory that is not on the live screen, then point the CRTC at it
+    int rows = VGA_MEMORY_SIZE / (2 * MAX_COLS);
+    int view_top = (screen_top + 2 * MAX_ROWS <= rows)? screen_top + MAX_ROWS : 0;
+    uint16_t *view = (uint16_t *)VIDEO_ADDRESS + view_top * MAX_COLS;
+    for (row = 0; row < MAX_ROWS; ++row) {
+        uint16_t *line;
+        if (row < back) line = scrollback + ((scrollback_head - back + row + scrollback_size) % scrollback_size) * MAX_COLS;
+        else line = get_screen() + (row - back) * MAX_COLS;
+        memcpy(view + row * MAX_COLS, line, 2 * MAX_COLS);
+    }
+    set_screen_start(view_top);
+    int hidden = (view_top + MAX_ROWS) * MAX_COLS; // Hide the cursor below the view
+    outb(REG_SCREEN_CTRL, 14);
+    outb(REG_SCREEN_DATA, (uint8_t)(hidden >> 8));
+    outb(REG_SCREEN_CTRL, 15);
+    outb(REG_SCREEN_DATA, (uint8_t)(hidden & 0xff));
+}
+
 /* Build attribute basing con foreground and background color.
  * @param fg        Foreground color.
  * @param bg        Background color.
@@ -75,18 +158,22 @@ uint8_t get_attribute(vga_color fg, vga_color bg) {
  * @return          Current cursor position (memory offset).
  */
 int get_cursor_offset() {
-    outb(REG_SCREEN_CTRL, 14); // Request higher byte
-    int offset = inb(REG_SCREEN_DATA) << 8;
-    outb(REG_SCREEN_CTRL, 15); // Request lower byte
-    offset += inb(REG_SCREEN_DATA);
-    return (2 * offset);
+    if (cursor_offset < 0) { // Left by the bootloader
+        outb(REG_SCREEN_CTRL, 14); // Request higher byte
+        int offset = inb(REG_SCREEN_DATA) << 8;
+        outb(REG_SCREEN_CTRL, 15); // Request lower byte
+        offset += inb(REG_SCREEN_DATA);
+        cursor_offset = 2 * offset;
+    }
+    return cursor_offset;
 }
 
-/* Set the cursor position.
+/* Set the cursor position (both the software and the hardware one).
  * @param offset    Cursor position (memory offset).
  */
 void set_cursor_offset(int offset) {
-    offset /= 2;
+    cursor_offset = offset;
+    offset = offset / 2 + screen_top * MAX_COLS; // The hardware cursor is relative to the start of video memory
     outb(REG_SCREEN_CTRL, 14);
     outb(REG_SCREEN_DATA, (uint8_t)(offset >> 8));
     outb(REG_SCREEN_CTRL, 15);
@@ -124,18 +211,52 @@ int get_offset_col(int offset) {
  */
 int handle_scrolling(int offset) {
     if (offset >= 2 * MAX_ROWS * MAX_COLS) {
+        uint16_t *screen = get_screen();
+        uint16_t blank = (get_attribute(FG_DEFAULT, BG_DEFAULT) << 8) | ' ';
         int i;
-        for (i = 1; i < MAX_ROWS; ++i) memcpy((unsigned char *)(VIDEO_ADDRESS + get_offset(i, 0)), (unsigned char *)(VIDEO_ADDRESS + get_offset(i-1, 0)), 2*MAX_COLS);
-        unsigned char *last_line = (unsigned char *)VIDEO_ADDRESS + get_offset(MAX_ROWS-1, 0);
-        for (i = 0; i < MAX_COLS; i += 2) {
-            last_line[i] = 0;
-            last_line[i+1] = get_attribute(FG_DEFAULT, BG_DEFAULT);
+        if (scrollback != NULL) { // Keep the first line
+            memcpy(scrollback + scrollback_head * MAX_COLS, screen, 2 * MAX_COLS);
+            scrollback_head = (scrollback_head + 1) % scrollback_size;
+            if (scrollback_count < scrollback_size) ++scrollback_count;
         }
+        if ((screen_top + MAX_ROWS + 1) * 2 * MAX_COLS > VGA_MEMORY_SIZE) { // End of video memory: move the screen back to the top
+            memmove((uint16_t *)VIDEO_ADDRESS, screen + MAX_COLS, 2 * MAX_COLS * (MAX_ROWS - 1));
+            screen_top = 0;
+        } else ++screen_top;
+        uint16_t *last_line = get_screen() + (MAX_ROWS - 1) * MAX_COLS;
+        for (i = 0; i < MAX_COLS; ++i) last_line[i] = blank;
+        set_screen_start(screen_top);
         offset -= 2 * MAX_COLS;
     }
     return offset;
 }
 
+/* Get the first cell of the live screen in video memory.
+ * @return          Pointer to the cell.
+ */
+uint16_t *get_screen() {
+    return (uint16_t *)VIDEO_ADDRESS + screen_top * MAX_COLS;
+}
+
+/* Make the CRTC display video memory from a certain row.
+ * @param row       Row of video memory.
+ */
+void set_screen_start(int row) {
+    int start = row * MAX_COLS;
+    outb(REG_SCREEN_CTRL, 12);
+    outb(REG_SCREEN_DATA, (uint8_t)(start >> 8));
+    outb(REG_SCREEN_CTRL, 13);
+    outb(REG_SCREEN_DATA, (uint8_t)(start & 0xff));
+}
+
+/* Go back from the history to the live screen.
+ */
+void show_live_screen() {
+    view_back = 0;
+    set_screen_start(screen_top);
+    set_cursor_offset(get_cursor_offset());
+}
+
 /* Print a single char to the screen.
  * @param character Character to print.
  * @param row       Row index.
@@ -145,23 +266,41 @@ int handle_scrolling(int offset) {
  * @return          Position (offset) of the cursor (incremented by 1).
  */
 int print_char(char character, int row, int col, vga_color fg, vga_color bg) {
-    unsigned char *vidmem = (unsigned char *)VIDEO_ADDRESS;
     uint8_t attribute = get_attribute(fg, bg);
     attribute = ((attribute == 0)? get_attribute(FG_DEFAULT, BG_DEFAULT) : attribute);
     int offset = ((row >= 0 && col >= 0)? get_offset(row, col) : get_cursor_offset());
-    if (character == '\n') {
-        offset = get_offset(get_offset_row(offset), MAX_COLS-1);
-        offset += 2;
-    } else if (character == 0x08) { // Backspace
-        vidmem[offset] = ' ';
-        vidmem[offset+1] = attribute;
-        // Do not increment cursor position
-    } else {
-        vidmem[offset] = character;
-        vidmem[offset+1] = attribute;
-        offset += 2;
-    }
-    offset = handle_scrolling(offset);
+    offset = write_chars(&character, 1, offset, attribute);
     set_cursor_offset(offset);
     return offset;
-}
\ No newline at end of file
+}
+
+/* Store characters in video memory, without moving the hardware cursor.
+ * @param buf       Characters.
+ * @param len       Number of characters.
+ * @param offset    Position of the first character (memory offset).
+ * @param attribute Attribute.
+ * @return          Position (offset) after the last character.
+ */
+int write_chars(const char *buf, int len, int offset, uint8_t attribute) {
+    uint16_t attr = (uint16_t)attribute << 8;
+    int i;
+    if (view_back) show_live_screen();
+    uint16_t *vidmem = get_screen();
+    for (i = 0; i < len; ++i) {
+        char c = buf[i];
+        if (c == '\n') {
+            offset = get_offset(get_offset_row(offset) + 1, 0);
+        } else if (c == 0x08) { // Backspace
+            vidmem[offset / 2] = attr | ' ';
+            // Do not increment cursor position
+        } else {
+            vidmem[offset / 2] = attr | (uint8_t)c;
+            offset += 2;
+        }
+        if (offset >= 2 * MAX_ROWS * MAX_COLS) {
+            offset = handle_scrolling(offset);
+            vidmem = get_screen();
+        }
+    }
+    return offset;
+}
@@ -8,8 +8,10 @@
 #include <stdint.h>
 #include "../cpu/ports.h"
 #include "../libc/mem.h"
+#include "../libc/string.h"
+#include "serial.h"
 
-static const int VIDEO_ADDRESS = 0xc00b8000; // Virtual address for higher-half kernel (mapped to 0xb8000)
+static const uint32_t VIDEO_ADDRESS = 0xc00b8000; // Virtual address for higher-half kernel (mapped to 0xb8000)
 
 static const int MAX_ROWS = 25;
 static const int MAX_COLS = 80;
@@ -17,6 +19,16 @@ static const int MAX_COLS = 80;
 static const int REG_SCREEN_CTRL = 0x3d4;
 static const int REG_SCREEN_DATA = 0x3d5;
 
+#define VGA_MEMORY_SIZE     0x8000 // Text mode video memory (the screen is a window over it)
+#define VGA_SCROLLBACK_PAGES 10 // Pages of history (256 lines)
+
+// Console outputs (see console_set_outputs())
+#define CONSOLE_VGA         0x1
+#define CONSOLE_SERIAL      0x2
+#ifndef SERIAL_CONSOLE
+#define SERIAL_CONSOLE      1 // At boot: 0 => VGA only, 1 => VGA mirrored on COM1, 2 => COM1 only
+#endif
+
 typedef enum vga_color {
     BLACK = 0x0,
     BLUE = 0x1,
@@ -52,6 +64,12 @@ void kprint_at(char *msg, int row, int col);
  */
 void kprint(char *msg);
 
+/* Print #len characters at the current cursor position, moving the cursor just once.
+ * @param buf       Characters to print.
+ * @param len       Number of characters.
+ */
+void kwrite(char *buf, int len);
+
 /* Clear the entire screen.
  */
 void clear_screen();
@@ -60,4 +78,25 @@ void clear_screen();
  */
 void clear_last_char();
 
+/* Choose where the console output goes.
+ * @param outputs   CONSOLE_VGA, CONSOLE_SERIAL or both.
+ */
+void console_set_outputs(uint8_t outputs);
+
+/* Tell where the console output goes.
+ * @return          CONSOLE_VGA, CONSOLE_SERIAL or both.
+ */
+uint8_t console_get_outputs();
+
+/* Start keeping the lines that scroll off the screen.
+ * @param buf       Buffer for the history.
+ * @param size      Size of the buffer (in bytes).
+ */
+void vga_scrollback_init(void *buf, uint32_t size);
+
+/* Move the view through the history (any output goes back to the live screen).
+ * @param lines     Number of lines to go back (negative to go forward).
+ */
+void vga_scroll_view(int lines);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,84 @@
+// @desc     Console throughput benchmark
+// @author   Davide Della Giustina
+// @date     19/10/2026
+
+#include "vga_bench.h"
+
+#define METHODS             4
+
+// Implemented in vga.c (not part of the public API)
+int print_char(char character, int row, int col, vga_color fg, vga_color bg);
+
+static const char *method_names[METHODS] = {
+    "char, hw cursor read+write", // What every character used to cost
+    "char, sw cursor (print_char)",
+    "line (kprint_at)",
+    "screen (kwrite)"
+};
+
+static char screen_text[25 * 80]; // MAX_ROWS * MAX_COLS
+
+// Private functions
+
+static void print_char_hw_cursor(char c);
+
+// Public functions
+
+/* Print full screens of text with different methods, then report the average number of cycles per screen.
+ */
+void vga_bench() {
+    int size = MAX_ROWS * MAX_COLS - 1, i, round; // The last cell stays empty, so that the screen does not scroll
+    uint32_t cycles[METHODS] = { 0 }, method;
+    uint8_t outputs = console_get_outputs();
+    console_set_outputs(CONSOLE_VGA); // Measure the screen alone (the serial port would drop most of it anyway)
+    for (i = 0; i < size; ++i) screen_text[i] = 'a' + i % 26;
+    for (method = 0; method < METHODS; ++method) {
+        for (round = 0; round < VGA_BENCH_ROUNDS; ++round) {
+            clear_screen();
+            uint64_t start = read_tsc();
+            switch (method) {
+                case 0:
+                    for (i = 0; i < size; ++i) print_char_hw_cursor(screen_text[i]);
+                    break;
+                case 1:
+                    for (i = 0; i < size; ++i) print_char(screen_text[i], -1, -1, FG_DEFAULT, BG_DEFAULT);
+                    break;
+                case 2: {
+                    char line[81];
+                    for (i = 0; i < MAX_ROWS; ++i) {
+                        int len = (i < MAX_ROWS - 1)? MAX_COLS : MAX_COLS - 1;
+                        memcpy(line, screen_text + i * MAX_COLS, len);
+                        line[len] = '\0';
+                        kprint_at(line, i, 0);
+                    }
+                    break;
+                }
+                case 3:
+                    kwrite(screen_text, size);
+                    break;
+            }
+            cycles[method] += (uint32_t)(read_tsc() - start);
+        }
+    }
+    console_set_outputs(outputs);
+    clear_screen();
+    kprintf("Cycles to print a full screen (%d characters, average of %d):\n", size, VGA_BENCH_ROUNDS);
+    for (method = 0; method < METHODS; ++method) {
+        uint32_t per_screen = cycles[method] / VGA_BENCH_ROUNDS;
+        kprintf("  %-30s %10u (%u per char)\n", method_names[method], per_screen, per_screen / size);
+    }
+}
+
+// Private functions
+
+/* Print a character the way the console did before the cursor was kept in software: read the hardware cursor, store
+ * the character, write the hardware cursor back.
+ * @param c             Character.
+ */
+static void print_char_hw_cursor(char c) {
+    outb(REG_SCREEN_CTRL, 14);
+    int offset = inb(REG_SCREEN_DATA) << 8;
+    outb(REG_SCREEN_CTRL, 15);
+    offset += inb(REG_SCREEN_DATA);
+    print_char(c, offset / MAX_COLS, offset % MAX_COLS, FG_DEFAULT, BG_DEFAULT); // Writes the hardware cursor once
+}
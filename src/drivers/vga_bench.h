@@ -0,0 +1,20 @@
+// @desc     Console throughput benchmark header
+// @author   Davide Della Giustina
+// @date     19/10/2026
+
+#ifndef VGA_BENCH_H
+#define VGA_BENCH_H
+
+#include <stdint.h>
+#include "../cpu/ports.h"
+#include "../cpu/tsc.h"
+#include "../libc/printf.h"
+#include "vga.h"
+
+#define VGA_BENCH_ROUNDS    10 // Full screens printed by every method
+
+/* Print full screens of text with different methods, then report the average number of cycles per screen.
+ */
+void vga_bench();
+
+#endif
@@ -0,0 +1,150 @@
+// @desc     Kernel allocation tracing
+// @author   Davide Della Giustina
+// @date     19/10/2026
+
+#include "alloctrace.h"
+
+// Call site statistics
+typedef struct {
+    void *caller;
+    uint32_t allocs; // Number of allocations
+    uint32_t frees; // Number of frees
+    uint32_t bytes; // Bytes requested
+    uint32_t outstanding; // Allocations not freed (within the recorded events)
+} alloctrace_site_t;
+
+volatile uint8_t alloctrace_enabled = 0;
+alloctrace_event_t alloctrace_events[ALLOCTRACE_EVENTS]; // Ring buffer
+volatile uint32_t alloctrace_head = 0; // Number of events ever recorded
+
+// Private functions
+
+static uint32_t find_site(alloctrace_site_t *sites, uint32_t *nsites, void *caller);
+static uint8_t is_outstanding(uint32_t last, uint32_t i);
+static void print_column(uint32_t n, int base, int width);
+
+// Public functions
+
+/* Append an event to the ring buffer, overwriting the oldest one when full.
+ * @param type          Type of event.
+ * @param caller        Call site.
+ * @param ptr           Allocated or freed area.
+ * @param size          Requested size.
+ */
+void alloctrace_record(uint32_t type, void *caller, void *ptr, uint32_t size) {
+    uint32_t i = __sync_fetch_and_add(&alloctrace_head, 1) & (ALLOCTRACE_EVENTS - 1); // Claim a slot, also against interrupt handlers
+    alloctrace_event_t *event = &alloctrace_events[i];
+    event->tsc = read_tsc();
+    event->caller = caller;
+    event->ptr = ptr;
+    event->size = size;
+    event->type = type;
+}
+
+/* Start or stop tracing.
+ * @param enabled       Nonzero to start tracing.
+ * @return              Zero if tracing is not compiled in.
+ */
+int alloctrace_enable(uint8_t enabled) {
+#ifdef HEAP_TRACE
+    alloctrace_enabled = enabled;
+    return 1;
+#else
+    (void)enabled;
+    return 0;
+#endif
+}
+
+/* Discard all the recorded events.
+ */
+void alloctrace_clear() {
+    alloctrace_head = 0;
+}
+
+/* Print the recorded events aggregated by call site.
+ */
+void alloctrace_report() {
+    static alloctrace_site_t sites[ALLOCTRACE_SITES + 1]; // Last entry collects the sites that do not fit
+    uint8_t enabled = alloctrace_enabled;
+    alloctrace_enabled = 0; // Keep the buffer still while reading it
+    uint32_t last = alloctrace_head;
+    uint32_t first = (last > ALLOCTRACE_EVENTS)? last - ALLOCTRACE_EVENTS : 0;
+    uint32_t nsites = 0, i;
+    memset(sites, 0, sizeof(sites));
+    for (i = first; i < last; ++i) {
+        alloctrace_event_t *event = &alloctrace_events[i & (ALLOCTRACE_EVENTS - 1)];
+        alloctrace_site_t *site = &sites[find_site(sites, &nsites, event->caller)];
+        if (event->type == ALLOCTRACE_ALLOC) {
+            ++site->allocs;
+            site->bytes += event->size;
+            if (is_outstanding(last, i)) ++site->outstanding;
+        } else ++site->frees;
+    }
+    print_column(last - first, 10, 0);
+    kprint(" events (");
+    print_column(first, 10, 0);
+    kprint(" dropped)\n");
+    kprint("caller      allocs   frees      bytes  outstanding\n");
+    for (i = 0; i <= ALLOCTRACE_SITES; ++i) {
+        if (i == nsites && i < ALLOCTRACE_SITES) break;
+        if (i == ALLOCTRACE_SITES) {
+            if (!sites[i].allocs && !sites[i].frees) break;
+            kprint("(others)  ");
+        } else {
+            kprint("0x");
+            print_column((uint32_t)sites[i].caller, 16, 8);
+        }
+        print_column(sites[i].allocs, 10, 8);
+        print_column(sites[i].frees, 10, 8);
+        print_column(sites[i].bytes, 10, 11);
+        print_column(sites[i].outstanding, 10, 13);
+        kprint("\n");
+    }
+    alloctrace_enabled = enabled;
+}
+
+// Private functions
+
+/* Find the statistics of a call site, adding it if missing.
+ * @param sites         Call sites.
+ * @param nsites        Number of call sites.
+ * @param caller        Call site to look for.
+ * @return              Index of the call site.
+ */
+static uint32_t find_site(alloctrace_site_t *sites, uint32_t *nsites, void *caller) {
+    uint32_t i;
+    for (i = 0; i < *nsites; ++i) {
+        if (sites[i].caller == caller) return i;
+    }
+    if (*nsites == ALLOCTRACE_SITES) return ALLOCTRACE_SITES;
+    sites[*nsites].caller = caller;
+    return (*nsites)++;
+}
+
+/* Check whether an allocation is still live at the end of the recorded events.
+ * @param last          Index past the newest event.
+ * @param i             Index of the allocation event.
+ * @return              Nonzero if no later event frees the area.
+ */
+static uint8_t is_outstanding(uint32_t last, uint32_t i) {
+    void *ptr = alloctrace_events[i & (ALLOCTRACE_EVENTS - 1)].ptr;
+    uint32_t j;
+    for (j = i + 1; j < last; ++j) {
+        alloctrace_event_t *event = &alloctrace_events[j & (ALLOCTRACE_EVENTS - 1)];
+        if (event->ptr == ptr) return (event->type != ALLOCTRACE_FREE);
+    }
+    return 1;
+}
+
+/* Print a number, right-aligned.
+ * @param n             Number.
+ * @param base          Base.
+ * @param width         Width of the column.
+ */
+static void print_column(uint32_t n, int base, int width) {
+    char buf[12];
+    itoa(n, buf, base);
+    int i;
+    for (i = strlen(buf); i < width; ++i) kprint((base == 16)? "0" : " ");
+    kprint(buf);
+}
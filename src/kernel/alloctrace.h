@@ -0,0 +1,59 @@
+// @desc     Kernel allocation tracing header
+// @author   Davide Della Giustina
+// @date     19/10/2026
+
+#ifndef ALLOCTRACE_H
+#define ALLOCTRACE_H
+
+#include <stdint.h>
+#include "../cpu/tsc.h"
+#include "../drivers/vga.h"
+#include "../libc/string.h"
+
+#define ALLOCTRACE_EVENTS   1024 // Size of the ring buffer (power of two)
+#define ALLOCTRACE_SITES    64 // Maximum number of call sites shown by the report
+
+#define ALLOCTRACE_ALLOC    0
+#define ALLOCTRACE_FREE     1
+
+// Allocation event
+typedef struct {
+    uint64_t tsc; // Timestamp
+    void *caller; // Return address into the caller of the allocator
+    void *ptr; // Allocated or freed area
+    uint32_t size; // Requested size (0 for frees)
+    uint32_t type; // ALLOCTRACE_ALLOC or ALLOCTRACE_FREE
+} alloctrace_event_t;
+
+#ifdef HEAP_TRACE
+extern volatile uint8_t alloctrace_enabled;
+
+// Record an event on behalf of the caller of the current function (compiled out unless HEAP_TRACE is defined)
+#define ALLOCTRACE(type, ptr, size) do { if (alloctrace_enabled) alloctrace_record((type), __builtin_return_address(0), (ptr), (size)); } while (0)
+#else
+#define ALLOCTRACE(type, ptr, size) do { } while (0)
+#endif
+
+/* Append an event to the ring buffer, overwriting the oldest one when full.
+ * @param type          Type of event.
+ * @param caller        Call site.
+ * @param ptr           Allocated or freed area.
+ * @param size          Requested size.
+ */
+void alloctrace_record(uint32_t type, void *caller, void *ptr, uint32_t size);
+
+/* Start or stop tracing.
+ * @param enabled       Nonzero to start tracing.
+ * @return              Zero if tracing is not compiled in.
+ */
+int alloctrace_enable(uint8_t enabled);
+
+/* Discard all the recorded events.
+ */
+void alloctrace_clear();
+
+/* Print the recorded events aggregated by call site.
+ */
+void alloctrace_report();
+
+#endif
@@ -0,0 +1,89 @@
+// @desc     Arena (region) allocator
+// @author   Davide Della Giustina
+// @date     19/10/2026
+
+#include "arena.h"
+
+/* Create a new (empty) arena in the kernel heap.
+ * @param chunk_size    Usable size of the chunks the arena grows by (0 for the default).
+ * @return              Pointer to the arena.
+ */
+arena_t *arena_create(uint32_t chunk_size) {
+    arena_t *arena = (arena_t *)kmalloc(sizeof(arena_t));
+    arena->first = NULL;
+    arena->current = NULL;
+    arena->offset = 0;
+    arena->chunk_size = ((chunk_size)? chunk_size : ARENA_DEFAULT_CHUNK);
+    return arena;
+}
+
+/* Link a new chunk right after the current one.
+ * @param arena         Arena.
+ * @param size          Minimum usable size of the chunk.
+ * @return              The new chunk.
+ */
+static arena_chunk_t *arena_grow(arena_t *arena, uint32_t size) {
+    if (size < arena->chunk_size) size = arena->chunk_size;
+    arena_chunk_t *chunk = (arena_chunk_t *)kmalloc(sizeof(arena_chunk_t) + ARENA_ALIGN + size);
+    chunk->size = size;
+    if (arena->current) {
+        chunk->next = arena->current->next;
+        arena->current->next = chunk;
+    } else {
+        chunk->next = arena->first;
+        arena->first = chunk;
+    }
+    return chunk;
+}
+
+/* Allocate space in an arena.
+ * @param arena         Arena.
+ * @param size          Size of requested space.
+ * @return              Pointer to newly allocated area (ARENA_ALIGN-aligned).
+ */
+void *arena_alloc(arena_t *arena, uint32_t size) {
+    size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+    if (arena->current == NULL || arena->offset + size > arena->current->size) {
+        // Move on to the next chunk (left over by a reset) if it is big enough, otherwise add a new one
+        arena_chunk_t *next = ((arena->current)? arena->current->next : arena->first);
+        if (next == NULL || next->size < size) next = arena_grow(arena, size);
+        arena->current = next;
+        arena->offset = 0;
+    }
+    uint32_t data = ((uint32_t)arena->current + sizeof(arena_chunk_t) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+    void *ptr = (void *)(data + arena->offset);
+    arena->offset += size;
+    return ptr;
+}
+
+/* Allocate space in an arena, then initialize it to 0.
+ * @param arena         Arena.
+ * @param size          Size of requested space.
+ * @return              Pointer to newly allocated area (ARENA_ALIGN-aligned).
+ */
+void *arena_calloc(arena_t *arena, uint32_t size) {
+    void *ptr = arena_alloc(arena, size);
+    memset(ptr, 0, size);
+    return ptr;
+}
+
+/* Free everything that was allocated in an arena, keeping its chunks for reuse.
+ * @param arena         Arena.
+ */
+void arena_reset(arena_t *arena) {
+    arena->current = NULL; // Next allocation starts again from the first chunk
+    arena->offset = 0;
+}
+
+/* Give an arena and all of its chunks back to the kernel heap.
+ * @param arena         Arena.
+ */
+void arena_destroy(arena_t *arena) {
+    arena_chunk_t *chunk = arena->first;
+    while (chunk) {
+        arena_chunk_t *next = chunk->next;
+        kfree(chunk);
+        chunk = next;
+    }
+    kfree(arena);
+}
@@ -0,0 +1,59 @@
+// @desc     Arena (region) allocator header
+// @author   Davide Della Giustina
+// @date     19/10/2026
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdint.h>
+#include "../libc/assert.h"
+#include "heap.h"
+
+#define ARENA_DEFAULT_CHUNK 0x1000 // Default size of an arena chunk
+#define ARENA_ALIGN         8 // Alignment of every arena allocation
+
+// Arena chunk (a block of the kernel heap the arena bumps through)
+typedef struct __arena_chunk_t {
+    struct __arena_chunk_t *next; // Next chunk
+    uint32_t size; // Usable size of the chunk (after this header)
+} arena_chunk_t;
+
+// Arena
+typedef struct {
+    arena_chunk_t *first; // First chunk
+    arena_chunk_t *current; // Chunk allocations are taken from
+    uint32_t offset; // First free byte in the current chunk
+    uint32_t chunk_size; // Usable size of new chunks
+} arena_t;
+
+/* Create a new (empty) arena in the kernel heap.
+ * @param chunk_size    Usable size of the chunks the arena grows by (0 for the default).
+ * @return              Pointer to the arena.
+ */
+arena_t *arena_create(uint32_t chunk_size);
+
+/* Allocate space in an arena.
+ * @param arena         Arena.
+ * @param size          Size of requested space.
+ * @return              Pointer to newly allocated area (ARENA_ALIGN-aligned).
+ */
+void *arena_alloc(arena_t *arena, uint32_t size);
+
+/* Allocate space in an arena, then initialize it to 0.
+ * @param arena         Arena.
+ * @param size          Size of requested space.
+ * @return              Pointer to newly allocated area (ARENA_ALIGN-aligned).
+ */
+void *arena_calloc(arena_t *arena, uint32_t size);
+
+/* Free everything that was allocated in an arena, keeping its chunks for reuse.
+ * @param arena         Arena.
+ */
+void arena_reset(arena_t *arena);
+
+/* Give an arena and all of its chunks back to the kernel heap.
+ * @param arena         Arena.
+ */
+void arena_destroy(arena_t *arena);
+
+#endif
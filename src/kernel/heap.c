@@ -3,9 +3,19 @@
 // @date     25/02/2020
 
 #include "heap.h"
+#include "../cpu/paging.h"
+
+#define BLOCK_SIZE(header)  ((header)->size & ~HEAP_FLAGS) // Size of a block, without flags
+#define KPAGES(size)        ((size)? ((size) + 0xfff) / 0x1000 : 1) // Number of kernel pages for an allocation (at least one)
+#ifdef HEAP_DEBUG
+#define CHECK_MAGIC(x)      assert((x)->magic == HEAP_MAGIC)
+#else
+#define CHECK_MAGIC(x)
+#endif
 
 void *kernel_brk = (void *)0xc00f0000; // Virtual, aligned, after end of VGA/ROM memory (0xa0000 - 0xfffff)
 heap_t *kernel_heap; // Kernel heap
+spinlock_t kernel_heap_lock = SPINLOCK_INIT; // Kernel heap (kernel pages have their own lock, never taken under this one)
 
 /* Set the kernel data segment limit to a certain address.
  * @param brk       New kernel data segment limit.
@@ -53,42 +63,203 @@ void *dumb_kcalloc(size_t size, int align, physaddr_t *physical) {
     return ptr;
 }
 
-/* Find the smallest hole in a heap, basing on the index.
+/* Index of the most significant set bit.
+ * @param word          Word (must be nonzero).
+ * @return              Bit index.
+ */
+static inline uint32_t fls_bit(uint32_t word) {
+    return 31 - __builtin_clz(word);
+}
+
+/* Index of the least significant set bit.
+ * @param word          Word (must be nonzero).
+ * @return              Bit index.
+ */
+static inline uint32_t ffs_bit(uint32_t word) {
+    return __builtin_ctz(word);
+}
+
+/* Compute the size class (free list) a block of a certain size belongs to.
+ * @param size          Block size.
+ * @param fl            Where the first-level index will be stored.
+ * @param sl            Where the second-level index will be stored.
+ */
+static void mapping_insert(uint32_t size, uint32_t *fl, uint32_t *sl) {
+    if (size < HEAP_SMALL_BLOCK) {
+        *fl = 0;
+        *sl = size / (HEAP_SMALL_BLOCK / HEAP_SL_COUNT);
+    } else {
+        uint32_t f = fls_bit(size);
+        *sl = (size >> (f - HEAP_SL_COUNT_LOG2)) ^ HEAP_SL_COUNT;
+        *fl = f - (HEAP_FL_SHIFT - 1);
+    }
+}
+
+/* Round a size up to the next class boundary, so that every hole in its class is big enough.
+ * @param size          Requested block size.
+ * @return              Rounded size.
+ */
+static uint32_t round_size(uint32_t size) {
+    if (size < HEAP_SMALL_BLOCK) return size + (HEAP_SMALL_BLOCK / HEAP_SL_COUNT) - 1;
+    return size + (1 << (fls_bit(size) - HEAP_SL_COUNT_LOG2)) - 1;
+}
+
+/* Compute the first size class whose holes are all at least as big as a certain size.
+ * @param size          Requested block size.
+ * @param fl            Where the first-level index will be stored.
+ * @param sl            Where the second-level index will be stored.
+ */
+static void mapping_search(uint32_t size, uint32_t *fl, uint32_t *sl) {
+    mapping_insert(round_size(size), fl, sl);
+}
+
+/* Insert a hole in the index.
+ * @param heap          Heap.
+ * @param hole          Hole (header must be already filled in).
+ */
+static void insert_hole(heap_t *heap, heap_hole_t *hole) {
+    uint32_t fl, sl;
+    mapping_insert(BLOCK_SIZE(&hole->header), &fl, &sl);
+    hole->prev = NULL;
+    hole->next = heap->holes[fl][sl];
+    if (hole->next) hole->next->prev = hole;
+    heap->holes[fl][sl] = hole;
+    heap->fl_bitmap |= (0x1 << fl);
+    heap->sl_bitmap[fl] |= (0x1 << sl);
+    ++heap->stats.hole_count;
+    heap->stats.hole_bytes += BLOCK_SIZE(&hole->header);
+}
+
+/* Remove a hole from the index.
+ * @param heap          Heap.
+ * @param hole          Hole.
+ */
+static void remove_hole(heap_t *heap, heap_hole_t *hole) {
+    uint32_t fl, sl;
+    mapping_insert(BLOCK_SIZE(&hole->header), &fl, &sl);
+    --heap->stats.hole_count;
+    heap->stats.hole_bytes -= BLOCK_SIZE(&hole->header);
+    if (hole->next) hole->next->prev = hole->prev;
+    if (hole->prev) hole->prev->next = hole->next;
+    else {
+        heap->holes[fl][sl] = hole->next;
+        if (!hole->next) { // List is now empty
+            heap->sl_bitmap[fl] &= ~(0x1 << sl);
+            if (!heap->sl_bitmap[fl]) heap->fl_bitmap &= ~(0x1 << fl);
+        }
+    }
+}
+
+/* Find a hole which is big enough for a certain size, basing on the index.
  * @param heap          Heap.
  * @param size          Size we are looking for.
- * @param page_align    The hole should be page aligned?
- * @return              Index of the found hole, -1 if not found.
- */
-static int32_t find_smallest_hole(heap_t *heap, uint32_t size, uint8_t page_align) {
-    uint32_t iterator = 0;
-    while (iterator < heap->index.size) {
-        heap_header_t *header = (heap_header_t *)get_ordered_array(&heap->index, iterator);
-        if (page_align > 0) {
-            uint32_t location = (uint32_t)header;
-            int32_t offset = 0;
-            if (((location + sizeof(heap_header_t)) & 0xfff) != 0) {
-                offset = 0x1000 - (location + sizeof(heap_header_t)) % 0x1000;
-            }
-            int32_t hole_size = (int32_t)header->size - offset;
-            if (hole_size >= (int32_t)size) break;
-        } else if (header->size >= size) break;
-        ++iterator;
+ * @return              Found hole, NULL if not found.
+ */
+static heap_hole_t *find_hole(heap_t *heap, uint32_t size) {
+    uint32_t fl, sl;
+    mapping_search(size, &fl, &sl);
+    if (fl >= HEAP_FL_COUNT) return NULL;
+    uint32_t sl_map = heap->sl_bitmap[fl] & (~0u << sl); // Same first-level class, larger second-level ones
+    if (!sl_map) {
+        uint32_t fl_map = heap->fl_bitmap & (~0u << (fl + 1)); // Larger first-level classes
+        if (!fl_map) return NULL;
+        fl = ffs_bit(fl_map);
+        sl_map = heap->sl_bitmap[fl];
+    }
+    sl = ffs_bit(sl_map);
+    return heap->holes[fl][sl];
+}
+
+/* Compute the size of the largest hole of a heap.
+ * @param heap          Heap.
+ * @return              Size of the largest hole (0 if there are none).
+ */
+uint32_t largest_hole(heap_t *heap) {
+    if (!heap->fl_bitmap) return 0;
+    uint32_t fl = fls_bit(heap->fl_bitmap);
+    uint32_t sl = fls_bit(heap->sl_bitmap[fl]);
+    uint32_t max = 0;
+    heap_hole_t *hole;
+    for (hole = heap->holes[fl][sl]; hole != NULL; hole = hole->next) { // Only the last class has to be scanned
+        if (BLOCK_SIZE(&hole->header) > max) max = BLOCK_SIZE(&hole->header);
     }
-    if (iterator == heap->index.size) return -1;
-    else return iterator;
+    return max;
 }
 
-/* Comparing function for ordering heap blocks (increasing size).
- * @param a             First block to compare.
- * @param b             Second block to compare.
- * @return              1 if a < b, 0 otherwise.
+/* Update the high-water mark of the bytes in allocated blocks.
+ * @param heap          Heap.
  */
-static int8_t heap_header_t_less_than(void *a, void *b) {
-    return ((((heap_header_t *)a)->size < ((heap_header_t *)b)->size)? 1 : 0);
+static void update_peak(heap_t *heap) {
+    uint32_t in_use = heap->end_addr - heap->start_addr - heap->stats.hole_bytes;
+    if (in_use > heap->stats.peak_in_use) heap->stats.peak_in_use = in_use;
 }
 
-/* Create a new heap structure.
- * @param start         Address where to place the ordered array (must be page aligned).
+/* Write the boundary tags of a block, and let the following block know whether this one is a hole.
+ * @param heap          Heap.
+ * @param addr          Address of the block.
+ * @param size          Size of the block (multiple of 4).
+ * @param flags         Block flags (HEAP_HOLE, HEAP_PREV_HOLE).
+ * @return              Header of the block.
+ */
+static heap_header_t *make_block(heap_t *heap, uint32_t addr, uint32_t size, uint32_t flags) {
+    heap_header_t *header = (heap_header_t *)addr;
+#ifdef HEAP_DEBUG
+    header->magic = HEAP_MAGIC;
+#endif
+    header->size = size | flags;
+    if (flags & HEAP_HOLE) { // Only holes have a footer
+        heap_footer_t *footer = (heap_footer_t *)(addr + size - sizeof(heap_footer_t));
+#ifdef HEAP_DEBUG
+        footer->magic = HEAP_MAGIC;
+#endif
+        footer->header = header;
+    }
+    if (addr + size < heap->end_addr) {
+        heap_header_t *next = (heap_header_t *)(addr + size);
+        CHECK_MAGIC(next);
+        if (flags & HEAP_HOLE) next->size |= HEAP_PREV_HOLE;
+        else next->size &= ~HEAP_PREV_HOLE;
+    } else heap->last_is_hole = ((flags & HEAP_HOLE)? 1 : 0);
+    return header;
+}
+
+/* Get the hole preceding a block, if any.
+ * @param heap          Heap.
+ * @param addr          Address of the block (may be the end of the heap).
+ * @return              Preceding hole, NULL if the preceding block is allocated.
+ */
+static heap_hole_t *prev_hole(heap_t *heap, uint32_t addr) {
+    uint8_t is_hole = ((addr == heap->end_addr)? heap->last_is_hole : (((heap_header_t *)addr)->size & HEAP_PREV_HOLE) != 0);
+    if (!is_hole) return NULL;
+    heap_footer_t *footer = (heap_footer_t *)(addr - sizeof(heap_footer_t));
+    CHECK_MAGIC(footer);
+    CHECK_MAGIC(footer->header);
+    return (heap_hole_t *)footer->header;
+}
+
+/* Get the hole following a block, if any.
+ * @param heap          Heap.
+ * @param addr          Address of the end of the block.
+ * @return              Following hole, NULL if the following block is allocated or there is none.
+ */
+static heap_hole_t *next_hole(heap_t *heap, uint32_t addr) {
+    if (addr >= heap->end_addr) return NULL;
+    heap_header_t *header = (heap_header_t *)addr;
+    CHECK_MAGIC(header);
+    return ((header->size & HEAP_HOLE)? (heap_hole_t *)header : NULL);
+}
+
+/* Compute the size of the block needed for a certain payload.
+ * @param size          Payload size.
+ * @return              Block size.
+ */
+static uint32_t block_size_for(uint32_t size) {
+    uint32_t block_size = ((size + 3) & ~0x3) + sizeof(heap_header_t); // Allocated blocks have no footer
+    return ((block_size < HEAP_MIN_BLOCK_SIZE)? HEAP_MIN_BLOCK_SIZE : block_size);
+}
+
+/* Create a new heap structure (placed at the beginning of the heap memory, so that many heaps can coexist).
+ * @param start         Start address of the heap (must be page aligned).
  * @param end           End of the allocated memory for the heap.
  * @param max           Maximum address the heap can reach.
  * @param supervisor    The requested pages will be in kernel (supervisor) mode?
@@ -96,34 +267,22 @@ static int8_t heap_header_t_less_than(void *a, void *b) {
  * @return              Pointer to the heap structure.
  */
 heap_t *create_heap(void *start, void *end, void *max, uint8_t supervisor, uint8_t readonly) {
-    void *bkp = ksbrk(0);
-    kbrk((void *)0xc0070000);
-    heap_t *heap = (heap_t *)dumb_kmalloc(sizeof(heap_t), 0, 0); // Heap struct at address 0xc0070000
-    kbrk(bkp);
     assert((uint32_t)start % 0x1000 == 0); // Must be page-aligned
     assert((uint32_t)end % 0x1000 == 0);
-    heap->index = place_ordered_array(start, KHEAP_INDEX_SIZE, &heap_header_t_less_than); // Initialize index of holes
-    uint32_t s = (uint32_t)start + sizeof(void *) * KHEAP_INDEX_SIZE; // Skip index
-    uint32_t e = (uint32_t)end;
-    if ((s & 0xfff) != 0) { // Check alignment
-        s &= 0xfffff000;
-        s += 0x1000;
-    }
+    assert((uint32_t)max - (uint32_t)start < (0x1u << HEAP_FL_MAX)); // Every block must fit in the index
+    heap_t *heap = (heap_t *)start; // Heap struct at the beginning of its own memory
+    memset(heap, 0, sizeof(heap_t)); // Empty index
     // Populate heap structure
-    heap->start_addr = s;
-    heap->end_addr = e;
+    heap->start_addr = ((uint32_t)start + sizeof(heap_t) + 3) & ~0x3;
+    heap->end_addr = (uint32_t)end;
+    heap->min_addr = (uint32_t)end;
     heap->max_addr = (uint32_t)max;
     heap->supervisor = supervisor;
     heap->readonly = readonly;
+    heap->stats.peak_size = heap->end_addr - heap->start_addr;
+    assert(heap->end_addr - heap->start_addr >= HEAP_MIN_BLOCK_SIZE);
     // Start with one large hole (in the index)
-    heap_header_t *hole = (heap_header_t *)s;
-    hole->size = e - s;
-    hole->magic = HEAP_MAGIC;
-    hole->is_hole = 1;
-    heap_footer_t *hole_footer = (heap_footer_t *)((uint32_t)hole + hole->size - sizeof(heap_footer_t));
-    hole_footer->magic = HEAP_MAGIC;
-    hole_footer->header = hole;
-    insert_ordered_array(&heap->index, (void *)hole);
+    insert_hole(heap, (heap_hole_t *)make_block(heap, heap->start_addr, heap->end_addr - heap->start_addr, HEAP_HOLE));
     return heap; // Return heap structure
 }
 
@@ -133,28 +292,50 @@ heap_t *create_heap(void *start, void *end, void *max, uint8_t supervisor, uint8
  */
 static void expand(heap_t *heap, uint32_t new_size) {
     assert(new_size > heap->end_addr - heap->start_addr);
-    if ((new_size & 0xfff) != 0) { // Align new size
-        new_size &= 0xfffff000;
-        new_size += 0x1000;
+    uint32_t new_end = heap->start_addr + new_size;
+    if ((new_end & 0xfff) != 0) { // Align new end
+        new_end &= 0xfffff000;
+        new_end += 0x1000;
     }
-    assert(heap->start_addr + new_size <= heap->max_addr);
-    heap->end_addr = heap->start_addr + new_size;
+    assert(new_end <= heap->max_addr);
+    heap->end_addr = new_end;
+    ++heap->stats.expansions;
+    if (new_end - heap->start_addr > heap->stats.peak_size) heap->stats.peak_size = new_end - heap->start_addr;
 }
 
 /* Contract the heap to a new size.
  * @param heap          Heap.
  * @param new_size      New size of the heap.
- * @return              New size of the heap (page-aligned);
+ * @return              New size of the heap (ending on a page boundary);
  */
 static uint32_t contract(heap_t *heap, uint32_t new_size) {
     assert(new_size < heap->end_addr - heap->start_addr);
-    if (new_size & 0xfff) {
-        new_size &= 0xfffff000;
-        new_size += 0x1000;
+    uint32_t new_end = heap->start_addr + new_size;
+    if (new_end & 0xfff) {
+        new_end &= 0xfffff000;
+        new_end += 0x1000;
+    }
+    if (new_end < heap->min_addr) new_end = heap->min_addr;
+    heap->end_addr = new_end;
+    ++heap->stats.contractions;
+    return new_end - heap->start_addr;
+}
+
+/* Expand the heap so that a new hole of (at least) a certain size is available.
+ * @param heap          Heap.
+ * @param size          Needed hole size.
+ */
+static void grow(heap_t *heap, uint32_t size) {
+    uint32_t hole_pos = heap->end_addr;
+    heap_hole_t *last = prev_hole(heap, heap->end_addr); // Unify with the last block, if it is a hole
+    if (last) {
+        remove_hole(heap, last);
+        hole_pos = (uint32_t)last;
     }
-    if (new_size < KHEAP_MIN_SIZE) new_size = KHEAP_MIN_SIZE;
-    heap->end_addr = heap->start_addr + new_size;
-    return new_size;
+    uint32_t new_length = hole_pos + size - heap->start_addr;
+    if (new_length <= heap->end_addr - heap->start_addr) new_length = heap->end_addr - heap->start_addr + 1; // Grow by at least one page
+    expand(heap, new_length);
+    insert_hole(heap, (heap_hole_t *)make_block(heap, hole_pos, heap->end_addr - hole_pos, HEAP_HOLE));
 }
 
 /* Allocate a new block in the heap.
@@ -163,120 +344,131 @@ static uint32_t contract(heap_t *heap, uint32_t new_size) {
  * @param page_align    Should the block be page-aligned?
  * @return              Pointer to the newly allocated block.
  */
-void *alloc(heap_t *heap, uint32_t size, uint8_t page_align) {
-    uint32_t new_size = size + sizeof(heap_header_t) + sizeof(heap_footer_t); // Size of needed block is size + header + footer
-    int32_t iterator = find_smallest_hole(heap, new_size, page_align);
-    if (iterator == -1) { // If no hole has been found
-        uint32_t old_length = heap->end_addr - heap->start_addr;
-        uint32_t old_end_addr = heap->end_addr;
-        expand(heap, old_length + new_size);
-        uint32_t new_length = heap->end_addr - heap->start_addr;
-        heap_header_t *header = (heap_header_t *)old_end_addr;
-        header->magic = HEAP_MAGIC;
-        header->size = new_length - old_length;
-        header->is_hole = 1;
-        heap_footer_t *footer = (heap_footer_t *)(old_end_addr + header->size -sizeof(heap_footer_t));
-        footer->magic = HEAP_MAGIC;
-        footer->header = header;
-        insert_ordered_array(&heap->index, (void *)header);
-        return alloc(heap, size, page_align);
+void *heap_alloc(heap_t *heap, uint32_t size, uint8_t page_align) {
+    ++heap->stats.allocs;
+    ++heap->stats.buckets[(size < 16)? 0 : ((fls_bit(size) - 3 < HEAP_STAT_BUCKETS)? fls_bit(size) - 3 : HEAP_STAT_BUCKETS - 1)];
+    uint32_t new_size = block_size_for(size);
+    uint32_t search_size = new_size;
+    if (page_align) search_size += 0x1000 + HEAP_MIN_BLOCK_SIZE; // Room for aligning and for a leading hole
+    heap_hole_t *hole = find_hole(heap, search_size);
+    if (hole == NULL) { // If no hole has been found
+        grow(heap, round_size(search_size));
+        hole = find_hole(heap, search_size);
+        assert(hole != NULL);
     }
-    heap_header_t *orig_hole_header = (heap_header_t *)get_ordered_array(&heap->index, iterator);
-    uint32_t orig_hole_pos = (uint32_t)orig_hole_header;
-    uint32_t orig_hole_size = orig_hole_header->size;
+    uint32_t orig_hole_pos = (uint32_t)hole;
+    uint32_t orig_hole_size = BLOCK_SIZE(&hole->header);
+    uint32_t block_pos = orig_hole_pos;
     // Remove the original hole in order to allocate it
-    remove_ordered_array(&heap->index, iterator);
+    remove_hole(heap, hole);
     // Check page alignment
     if (page_align && ((orig_hole_pos + sizeof(heap_header_t)) & 0xfff)) {
-        uint32_t new_location = orig_hole_pos + 0x1000 - (orig_hole_pos & 0xfff) - sizeof(heap_header_t);
-        if (new_location - orig_hole_pos > sizeof(heap_header_t) + sizeof(heap_footer_t)) {
-            heap_header_t *hole_header = (heap_header_t *)orig_hole_pos;
-            hole_header->size = 0x1000 - (orig_hole_pos & 0xfff) - sizeof(heap_header_t);
-            hole_header->magic = HEAP_MAGIC;
-            hole_header->is_hole = 1;
-            heap_footer_t *hole_footer = (heap_footer_t *)(new_location - sizeof(heap_footer_t));
-            hole_footer->magic = HEAP_MAGIC;
-            hole_footer->header = hole_header;
-            insert_ordered_array(&heap->index, (void *)hole_header);
-        } else ((heap_header_t *)orig_hole_pos)->magic = HEAP_MAGIC - 1; // Invalidate entry
-        orig_hole_size -= (new_location - orig_hole_pos);
-        orig_hole_pos = new_location;
+        block_pos = ((orig_hole_pos + sizeof(heap_header_t) + 0xfff) & 0xfffff000) - sizeof(heap_header_t);
+        if (block_pos - orig_hole_pos < HEAP_MIN_BLOCK_SIZE) block_pos += 0x1000; // Leading space must be a valid hole
     }
+    uint32_t block_space = orig_hole_size - (block_pos - orig_hole_pos);
     // Should we split hole into two parts?
-    if (orig_hole_size - new_size <= sizeof(heap_header_t) + sizeof(heap_footer_t)) { // If not, increase size we are going to allocate
-        size += orig_hole_size - new_size;
-        new_size = orig_hole_size;
+    if (block_space - new_size < HEAP_MIN_BLOCK_SIZE) new_size = block_space; // If not, increase size we are going to allocate
+    else insert_hole(heap, (heap_hole_t *)make_block(heap, block_pos + new_size, block_space - new_size, HEAP_HOLE)); // New hole after allocated block
+    // Tags are written right to left, so that every block updates an already valid neighbour
+    heap_header_t *block_header = make_block(heap, block_pos, new_size, 0);
+    if (block_pos != orig_hole_pos) insert_hole(heap, (heap_hole_t *)make_block(heap, orig_hole_pos, block_pos - orig_hole_pos, HEAP_HOLE)); // Leading hole
+    update_peak(heap);
+    return (void *)((uint32_t)block_header + sizeof(heap_header_t));
+}
+
+/* Turn an allocated block into a hole, unifying it with its neighbours.
+ * @param heap          Heap.
+ * @param header        Header of the block.
+ */
+static void release(heap_t *heap, heap_header_t *header) {
+    uint32_t pos = (uint32_t)header;
+    uint32_t size = BLOCK_SIZE(header);
+    // Unify right
+    heap_hole_t *next = next_hole(heap, pos + size);
+    if (next) {
+        remove_hole(heap, next);
+        size += BLOCK_SIZE(&next->header);
     }
-    // Overwrite original header
-    heap_header_t *block_header = (heap_header_t *)orig_hole_pos;
-    block_header->magic = HEAP_MAGIC;
-    block_header->is_hole = 0;
-    block_header->size = new_size;
-    // And footer
-    heap_footer_t *block_footer = (heap_footer_t *)(orig_hole_pos + sizeof(heap_header_t) + size);
-    block_footer->magic = HEAP_MAGIC;
-    block_footer->header = block_header;
-    // Maybe new hole after allocated block
-    if (orig_hole_size - new_size > 0) {
-        assert(orig_hole_size - new_size > sizeof(heap_header_t) + sizeof(heap_footer_t));
-        heap_header_t *hole_header = (heap_header_t *)(orig_hole_pos + sizeof(heap_header_t) + size + sizeof(heap_footer_t));
-        hole_header->magic = HEAP_MAGIC;
-        hole_header->is_hole = 1;
-        hole_header->size = orig_hole_size - new_size;
-        heap_footer_t *hole_footer = (heap_footer_t *)((uint32_t)hole_header + orig_hole_size - new_size - sizeof(heap_footer_t));
-        hole_footer->magic = HEAP_MAGIC;
-        hole_footer->header = hole_header;
-        insert_ordered_array(&heap->index, (void *)hole_header);
+    // Unify left
+    heap_hole_t *prev = prev_hole(heap, pos);
+    if (prev) {
+        remove_hole(heap, prev);
+        size += pos - (uint32_t)prev;
+        pos = (uint32_t)prev;
     }
-    return (void *)((uint32_t)block_header + sizeof(heap_header_t));
+    // If freed area is at the end of the heap, contract it
+    if (pos + size == heap->end_addr) {
+        uint32_t old_length = heap->end_addr - heap->start_addr;
+        uint32_t new_length = pos - heap->start_addr + HEAP_MIN_BLOCK_SIZE; // Keep a valid hole at the end
+        if (new_length < old_length) {
+            new_length = contract(heap, new_length);
+            size -= old_length - new_length;
+        }
+    }
+    insert_hole(heap, (heap_hole_t *)make_block(heap, pos, size, HEAP_HOLE));
 }
 
 /* Free some allocated space.
  * @param heap          Heap.
  * @param p             Pointer to allocated area.
  */
-void free(heap_t *heap, void *p) {
+void heap_free(heap_t *heap, void *p) {
     if (p == 0) return; // Null pointers
     heap_header_t *header = (heap_header_t *)((uint32_t)p - sizeof(heap_header_t));
-    heap_footer_t *footer = (heap_footer_t *)((uint32_t)header + header->size - sizeof(heap_footer_t));
-    assert(header->magic == HEAP_MAGIC);
-    assert(footer->magic == HEAP_MAGIC);
-    header->is_hole = 1;
-    // Unify left
-    heap_footer_t *test_footer = (heap_footer_t *)((uint32_t)header - sizeof(heap_footer_t));
-    if (test_footer->magic == HEAP_MAGIC && test_footer->header->magic == HEAP_MAGIC && test_footer->header->is_hole == 1) {
-        uint32_t cache_size = header->size;
-        header = test_footer->header;
-        footer->header = header;
-        header->size += cache_size;
-        uint32_t iterator = 0;
-        while ((iterator < heap->index.size) && (get_ordered_array(&heap->index, iterator) != (void *)header)) ++iterator;
-        remove_ordered_array(&heap->index, iterator);
+    CHECK_MAGIC(header);
+    assert(!(header->size & HEAP_HOLE)); // Double free
+    ++heap->stats.frees;
+    release(heap, header);
+}
+
+/* Resize an allocated block, in place whenever possible.
+ * @param heap          Heap.
+ * @param p             Pointer to allocated area (NULL to allocate a new one).
+ * @param size          New size.
+ * @return              Pointer to the resized area (may differ from #p).
+ */
+void *heap_realloc(heap_t *heap, void *p, uint32_t size) {
+    if (p == NULL) return heap_alloc(heap, size, 0);
+    ++heap->stats.reallocs;
+    heap_header_t *header = (heap_header_t *)((uint32_t)p - sizeof(heap_header_t));
+    CHECK_MAGIC(header);
+    assert(!(header->size & HEAP_HOLE));
+    uint32_t new_size = block_size_for(size);
+    uint32_t pos = (uint32_t)header;
+    uint32_t old_size = BLOCK_SIZE(header);
+    uint32_t flags = header->size & HEAP_PREV_HOLE;
+    // Shrink: split off the tail and free it (it will be unified with a following hole)
+    if (new_size <= old_size) {
+        if (old_size - new_size >= HEAP_MIN_BLOCK_SIZE) {
+            heap_header_t *tail = make_block(heap, pos + new_size, old_size - new_size, 0);
+            make_block(heap, pos, new_size, flags);
+            release(heap, tail);
+        }
+        return p;
     }
-    // Unify right
-    heap_header_t *test_header = (heap_header_t *)((uint32_t)footer + sizeof(heap_footer_t));
-    if ((uint32_t)test_header < heap->end_addr && test_header->magic == HEAP_MAGIC && test_header->is_hole) {
-        header->size += test_header->size;
-        test_footer = (heap_footer_t *)((uint32_t)test_header + test_header->size - sizeof(heap_footer_t));
-        footer = test_footer;
-        footer->header = header;
-        uint32_t iterator = 0;
-        while ((iterator < heap->index.size) && (get_ordered_array(&heap->index, iterator) != (void *)test_header)) ++iterator;
-        remove_ordered_array(&heap->index, iterator);
+    // Grow: use the following hole and, if this is the last block, new space at the end of the heap
+    uint32_t avail = old_size;
+    heap_hole_t *next = next_hole(heap, pos + old_size);
+    if (next) avail += BLOCK_SIZE(&next->header);
+    uint8_t at_end = (pos + avail == heap->end_addr);
+    if (avail >= new_size || (at_end && pos + new_size <= heap->max_addr)) {
+        if (next) remove_hole(heap, next);
+        if (avail < new_size) {
+            expand(heap, pos + new_size - heap->start_addr);
+            avail = heap->end_addr - pos;
+        }
+        if (avail - new_size < HEAP_MIN_BLOCK_SIZE) new_size = avail;
+        else insert_hole(heap, (heap_hole_t *)make_block(heap, pos + new_size, avail - new_size, HEAP_HOLE));
+        make_block(heap, pos, new_size, flags);
+        update_peak(heap);
+        return p;
     }
-    // If freed area is at the end of the heap, contract it
-    uint8_t do_add = 1;
-    if ((uint32_t)footer + sizeof(heap_footer_t) == heap->end_addr) {
-        uint32_t old_length = heap->end_addr - heap->start_addr;
-        uint32_t new_length = contract(heap, (uint32_t)header - heap->start_addr);
-        if (header->size - (old_length - new_length) > 0) {
-            header->size -= old_length - new_length;
-            footer = (heap_footer_t *)((uint32_t)header + header->size - sizeof(heap_footer_t));
-            footer->magic = HEAP_MAGIC;
-            footer->header = header;
-        } else do_add = 0;
-    }
-    if (do_add) insert_ordered_array(&heap->index, (void *)header);
+    // Otherwise move the data to a new block
+    void *allocated = heap_alloc(heap, size, 0);
+    memcpy(allocated, p, old_size - sizeof(heap_header_t));
+    heap_free(heap, p);
+    return allocated;
 }
 
 /* Initialize kernel heap.
@@ -284,6 +476,7 @@ void free(heap_t *heap, void *p) {
 void kheap_init() {
     void *start = ksbrk(0);
     kernel_heap = create_heap(start, start + KHEAP_INITIAL_SIZE, start + KHEAP_MAX_SIZE, 1, 0);
+    kernel_heap->min_addr = (uint32_t)start + KHEAP_MIN_SIZE; // Allow contracting below the initial size
 }
 
 /* Allocate space in the kernel heap.
@@ -291,17 +484,21 @@ void kheap_init() {
  * @return                  Pointer to newly allocated area.
  */
 void *kmalloc(uint32_t size) {
-    return alloc(kernel_heap, size, 0);
+    uint32_t flags = spin_lock_irqsave(&kernel_heap_lock);
+    void *allocated = heap_alloc(kernel_heap, size, 0);
+    ALLOCTRACE(ALLOCTRACE_ALLOC, allocated, size);
+    spin_unlock_irqrestore(&kernel_heap_lock, flags);
+    return allocated;
 }
 
-/* Allocate space in the kernel heap.
+/* Allocate whole kernel pages (never from the kernel heap, so alignment does not fragment it).
  * @param size              Size of requested space.
  * @param phys              Where physical address will be stored.
- * @return                  Pointer to newly allocated area.
+ * @return                  Pointer to newly allocated area (page-aligned).
  */
 void *kmalloc_ap(uint32_t size, physaddr_t *phys) {
-    void *allocated = alloc(kernel_heap, size, 1);
-    *phys = (physaddr_t)allocated - 0xc0000000;
+    void *allocated = kpage_alloc(KPAGES(size), phys);
+    ALLOCTRACE(ALLOCTRACE_ALLOC, allocated, size); // The trace needs no lock
     return allocated;
 }
 
@@ -310,40 +507,60 @@ void *kmalloc_ap(uint32_t size, physaddr_t *phys) {
  * @return                  Pointer to newly allocated area.
  */
 void *kcalloc(uint32_t size) {
-    void *allocated = alloc(kernel_heap, size, 0);
+    uint32_t flags = spin_lock_irqsave(&kernel_heap_lock);
+    void *allocated = heap_alloc(kernel_heap, size, 0);
+    ALLOCTRACE(ALLOCTRACE_ALLOC, allocated, size);
+    spin_unlock_irqrestore(&kernel_heap_lock, flags);
     memset(allocated, 0, size);
     return allocated;
 }
 
-/* Allocate space in the kernel heap, then initialize it to 0.
+/* Allocate whole kernel pages (never from the kernel heap), then initialize them to 0.
  * @param size              Size of requested space.
  * @param phys              Where physical address will be stored.
- * @return                  Pointer to newly allocated area.
+ * @return                  Pointer to newly allocated area (page-aligned).
  */
 void *kcalloc_ap(uint32_t size, physaddr_t *phys) {
-    void *allocated = alloc(kernel_heap, size, 1);
+    void *allocated = kpage_alloc(KPAGES(size), phys);
+    ALLOCTRACE(ALLOCTRACE_ALLOC, allocated, size);
     memset(allocated, 0, size);
-    *phys = (physaddr_t)allocated - 0xc0000000;
     return allocated;
 }
 
-/* Expand a previously allocated area to a new size.
- * @param p                 Pointer to already allocated area.
+/* Resize a previously allocated area, in place whenever possible.
+ * @param p                 Pointer to already allocated area (NULL to allocate a new one).
  * @param size              New size.
- * @return                  Pointer to the enlarged area.
+ * @return                  Pointer to the resized area.
  */
 void *krealloc(void *p, uint32_t size) {
-    heap_header_t *header = (heap_header_t *)((uint32_t)p - sizeof(heap_header_t));
-    uint32_t old_size = header->size - sizeof(heap_header_t) - sizeof(heap_footer_t);
-    void *allocated = alloc(kernel_heap, size, 0);
-    memcpy(p, allocated, old_size);
-    kfree(p);
-    return allocated;
+    void *q;
+    if (is_kpage(p)) { // Page-aligned blocks stay page-aligned
+        uint32_t old_size = kpage_size(p);
+        if (KPAGES(size) * 0x1000 == old_size) q = p; // Same number of pages
+        else {
+            q = kpage_alloc(KPAGES(size), NULL);
+            memcpy(q, p, (size < old_size)? size : old_size);
+            kpage_free(p);
+        }
+    } else {
+        uint32_t flags = spin_lock_irqsave(&kernel_heap_lock);
+        q = heap_realloc(kernel_heap, p, size);
+        spin_unlock_irqrestore(&kernel_heap_lock, flags);
+    }
+    if (p) ALLOCTRACE(ALLOCTRACE_FREE, p, 0); // Traced as a free followed by an allocation
+    ALLOCTRACE(ALLOCTRACE_ALLOC, q, size);
+    return q;
 }
 
-/* Free some space in the kernel heap.
+/* Free some space in the kernel heap (or kernel pages).
  * @param p                 Pointer to allocated space.
  */
 void kfree(void *p) {
-    free(kernel_heap, p);
+    if (p) ALLOCTRACE(ALLOCTRACE_FREE, p, 0);
+    if (is_kpage(p)) kpage_free(p);
+    else {
+        uint32_t flags = spin_lock_irqsave(&kernel_heap_lock);
+        heap_free(kernel_heap, p);
+        spin_unlock_irqrestore(&kernel_heap_lock, flags);
+    }
 }
\ No newline at end of file
@@ -6,37 +6,83 @@
 #define HEAP_H
 
 #include <stdint.h>
-#include "../data_structures/ordered_array.h"
 #include "../libc/assert.h"
+#include "../cpu/spinlock.h"
 #include "../libc/mem.h"
+#include "alloctrace.h"
 
-#define HEAP_MAGIC          0xdeadc0de // Magic number for the heap
+#define HEAP_MAGIC          0xdeadc0de // Magic number for the heap (checked only if HEAP_DEBUG is defined)
 #define KHEAP_INITIAL_SIZE  0x100000   // Initial size of the kernel heap
 #define KHEAP_MIN_SIZE      0x70000    // Minimum size for the kernel heap
 #define KHEAP_MAX_SIZE      0x3500000  // Maximum size for the kernel heap
-#define KHEAP_INDEX_SIZE    0x20000    // Index size for the kernel heap
+
+// Hole index (TLSF-like segregated free lists)
+#define HEAP_SL_COUNT_LOG2  4 // Each first-level class is split into 2^4 second-level classes
+#define HEAP_SL_COUNT       (1 << HEAP_SL_COUNT_LOG2)
+#define HEAP_FL_SHIFT       (HEAP_SL_COUNT_LOG2 + 3) // Blocks smaller than 2^7 bytes all share the first class (8 bytes per list)
+#define HEAP_FL_MAX         30 // Blocks must be smaller than 2^30 bytes
+#define HEAP_FL_COUNT       (HEAP_FL_MAX - HEAP_FL_SHIFT + 1)
+#define HEAP_SMALL_BLOCK    (1 << HEAP_FL_SHIFT)
+
+#define HEAP_STAT_BUCKETS   12 // Allocation size buckets: < 16, < 32, ..., < 16K, >= 16K
+
+// Block flags (stored in the low bits of the size, which is always a multiple of 4)
+#define HEAP_HOLE           0x1 // This block is a hole
+#define HEAP_PREV_HOLE      0x2 // The previous block is a hole (so its footer is valid)
+#define HEAP_FLAGS          (HEAP_HOLE | HEAP_PREV_HOLE)
 
 // Heap header
 typedef struct {
+#ifdef HEAP_DEBUG
     uint32_t magic; // Magic number
-    uint8_t is_hole; // Set if this block is a hole
-    uint32_t size; // Size of the block, including footer
+#endif
+    uint32_t size; // Size of the block (including header and footer) | flags
 } heap_header_t;
 
-// Heap footer
+// Heap footer (only holes have one)
 typedef struct {
+#ifdef HEAP_DEBUG
     uint32_t magic; // Magic number
+#endif
     heap_header_t *header; // Pointer to block header
 } heap_footer_t;
 
+// Heap hole (a free block, linked in its size class list through the header)
+typedef struct __heap_hole_t {
+    heap_header_t header;
+    struct __heap_hole_t *prev; // Previous hole in the same size class
+    struct __heap_hole_t *next; // Next hole in the same size class
+} heap_hole_t;
+
+#define HEAP_MIN_BLOCK_SIZE (sizeof(heap_hole_t) + sizeof(heap_footer_t)) // A block must be able to turn back into a hole
+
+// Heap statistics
+typedef struct {
+    uint32_t hole_count; // Number of holes
+    uint32_t hole_bytes; // Bytes in holes
+    uint32_t peak_in_use; // High-water mark of bytes in allocated blocks
+    uint32_t peak_size; // High-water mark of the heap size
+    uint32_t allocs; // Number of calls to heap_alloc()
+    uint32_t frees; // Number of calls to heap_free()
+    uint32_t reallocs; // Number of calls to heap_realloc()
+    uint32_t expansions; // Number of times the heap was expanded
+    uint32_t contractions; // Number of times the heap was contracted
+    uint32_t buckets[HEAP_STAT_BUCKETS]; // Allocations by size
+} heap_stats_t;
+
 // Heap
 typedef struct {
-    ordered_array_t index; // Heap blocks
-    uint32_t start_addr;
+    uint32_t fl_bitmap; // Bit i set if some list in first-level class i is not empty
+    uint32_t sl_bitmap[HEAP_FL_COUNT]; // Bit j of entry i set if list (i, j) is not empty
+    heap_hole_t *holes[HEAP_FL_COUNT][HEAP_SL_COUNT]; // Segregated lists of holes
+    uint32_t start_addr; // First block (right after this structure)
     uint32_t end_addr;
+    uint32_t min_addr; // The heap never contracts below this address
     uint32_t max_addr;
+    uint8_t last_is_hole; // Set if the last block of the heap is a hole
     uint8_t supervisor;
     uint8_t readonly;
+    heap_stats_t stats;
 } heap_t;
 
 /* Set the kernel data segment limit to a certain address.
@@ -66,8 +112,8 @@ void *dumb_kmalloc(size_t size, int align, physaddr_t *physical);
  */
 void *dumb_kcalloc(size_t size, int align, physaddr_t *physical);
 
-/* Create a new heap structure.
- * @param start         Address where to place the ordered array (must be page aligned).
+/* Create a new heap structure (placed at the beginning of the heap memory, so that many heaps can coexist).
+ * @param start         Start address of the heap (must be page aligned).
  * @param end           End of the allocated memory for the heap.
  * @param max           Maximum address the heap can reach.
  * @param supervisor    The requested pages will be in kernel (supervisor) mode?
@@ -82,13 +128,27 @@ heap_t *create_heap(void *start, void *end, void *max, uint8_t supervisor, uint8
  * @param page_align    Should the block be page-aligned?
  * @return              Pointer to the newly allocated block.
  */
-void *alloc(heap_t *heap, uint32_t size, uint8_t page_align);
+void *heap_alloc(heap_t *heap, uint32_t size, uint8_t page_align);
 
 /* Free some allocated space.
  * @param heap          Heap.
  * @param p             Pointer to allocated area.
  */
-void free(heap_t *heap, void *p);
+void heap_free(heap_t *heap, void *p);
+
+/* Resize an allocated block, in place whenever possible.
+ * @param heap          Heap.
+ * @param p             Pointer to allocated area (NULL to allocate a new one).
+ * @param size          New size.
+ * @return              Pointer to the resized area (may differ from #p).
+ */
+void *heap_realloc(heap_t *heap, void *p, uint32_t size);
+
+/* Compute the size of the largest hole of a heap.
+ * @param heap          Heap.
+ * @return              Size of the largest hole (0 if there are none).
+ */
+uint32_t largest_hole(heap_t *heap);
 
 /* Initialize kernel heap.
  */
@@ -100,10 +160,10 @@ void kheap_init();
  */
 void *kmalloc(uint32_t size);
 
-/* Allocate space in the kernel heap.
+/* Allocate whole kernel pages (never from the kernel heap, so alignment does not fragment it).
  * @param size              Size of requested space.
  * @param phys              Where physical address will be stored.
- * @return                  Pointer to newly allocated area.
+ * @return                  Pointer to newly allocated area (page-aligned).
  */
 void *kmalloc_ap(uint32_t size, physaddr_t *phys);
 
@@ -113,21 +173,21 @@ void *kmalloc_ap(uint32_t size, physaddr_t *phys);
  */
 void *kcalloc(uint32_t size);
 
-/* Allocate space in the kernel heap, then initialize it to 0.
+/* Allocate whole kernel pages (never from the kernel heap), then initialize them to 0.
  * @param size              Size of requested space.
  * @param phys              Where physical address will be stored.
- * @return                  Pointer to newly allocated area.
+ * @return                  Pointer to newly allocated area (page-aligned).
  */
 void *kcalloc_ap(uint32_t size, physaddr_t *phys);
 
-/* Expand a previously allocated area to a new size.
- * @param p                 Pointer to already allocated area.
+/* Resize a previously allocated area, in place whenever possible.
+ * @param p                 Pointer to already allocated area (NULL to allocate a new one).
  * @param size              New size.
- * @return                  Pointer to the enlarged area.
+ * @return                  Pointer to the resized area.
  */
 void *krealloc(void *p, uint32_t size);
 
-/* Free some space in the kernel heap.
+/* Free some space in the kernel heap (or kernel pages).
  * @param p                 Pointer to allocated space.
  */
 void kfree(void *p);
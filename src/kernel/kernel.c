@@ -3,11 +3,22 @@
 // @date     07/12/2019
 
 #include <stdint.h>
+#include "../cpu/apic.h"
+#include "../cpu/fpu.h"
 #include "../cpu/isr.h"
 #include "../cpu/paging.h"
+#include "../cpu/smp.h"
+#include "../cpu/tsc.h"
+#include "../drivers/keyboard.h"
+#include "../drivers/serial.h"
 #include "../drivers/vga.h"
+#include "../libc/printf.h"
 #include "heap.h"
+#include "klog.h"
 #include "processes.h"
+#include "softirq.h"
+#include "syscalls.h"
+#include "timers.h"
 
 /* Print "ScratchOS" ASCII art.
  */
@@ -28,30 +39,42 @@ extern page_directory_t *kernel_directory;
  * @param kpe       Kernel end physical address.
  */
 void kmain(void *kvs, void *kve, physaddr_t kps, physaddr_t kpe) {
+    smp_bsp_init(); // Per-processor data (the FPU code already uses it)
+    fpu_init(); // Enable the FPU and SSE (the memory primitives use it too)
+    if (!serial_init()) console_set_outputs(CONSOLE_VGA); // COM1 (its interrupt is enabled along with the others)
     clear_screen();
-    kprint("Booting ScratchOS v0.1...\n\n");
+    klog(KLOG_INFO, "Booting ScratchOS v0.1...\n");
     // Print some kernel info
     uint32_t kernel_size = ((kpe - kps) / 1024) - 4; // In KB, subtracting the size of kernel stack
-    char buf[10]; itoa(kps, buf, 16);
-    kprint("Kernel location: 0x"); kprint(buf); kprint(" - ");
-    itoa(kpe, buf, 16);
-    kprint("0x"); kprint(buf); kprint(".\n");
-    itoa(kernel_size, buf, 10);
-    kprint("Kernel approximate size: "); kprint(buf); kprint("KB.\n");
+    klog(KLOG_INFO, "Kernel location: 0x%x - 0x%x.\n", kps, kpe);
+    klog(KLOG_INFO, "Kernel approximate size: %uKB.\n", kernel_size);
+    // Calibrate the clock
+    tsc_init();
     // Install interrupt handlers
-    kprint("Installing interrupt vector and handlers...");
+    klog(KLOG_INFO, "Installing interrupt vector and handlers...\n");
+    softirq_init();
+    timers_init();
     isr_install();
     irq_init();
-    kprint(" Done!\n");
+    syscalls_init();
     // Setup paging
-    kprint("Setting up paging...");
+    klog(KLOG_INFO, "Setting up paging...\n");
     setup_paging(kvs, kve, kps, kpe);
-    kprint(" Done!\n");
+    // Prefer the APICs to the PICs
+    klog(KLOG_INFO, "Setting up interrupt controllers...\n");
+    if (!apic_init()) klog(KLOG_INFO, "No APIC found, using the 8259 PICs\n");
     // Setup kernel heap
-    kprint("Setting up kernel heap...");
+    klog(KLOG_INFO, "Setting up kernel heap...\n");
     kheap_init();
-    kprint(" Done!\n");
-    // Setup scheduling queue
+    // Setup kernel object caches
+    klog(KLOG_INFO, "Setting up kernel object caches...\n");
+    paging_caches_init();
+    // Keep the console history
+    vga_scrollback_init(kpage_alloc(VGA_SCROLLBACK_PAGES, NULL), VGA_SCROLLBACK_PAGES * 0x1000);
+    // Start the other processors
+    klog(KLOG_INFO, "Starting application processors...\n");
+    smp_init();
+    // Setup scheduling queue (not started yet: until it is, the application processors only come online and idle)
     // kprint("Setting up scheduling queue and structures...");
     // processes_init();
     // kprint(" Done!\n");
@@ -63,4 +86,17 @@ void kmain(void *kvs, void *kve, physaddr_t kps, physaddr_t kpe) {
     clear_screen();
     print_ascii_art();
     kprint("\n\n> ");
+    // Program the timer one event at a time from now on
+    timer_tickless_start();
+    // Idle: be the kernel worker from here on, along with idle application processors (interrupt handlers defer the input
+    // and the kernel log to it)
+    klog_defer();
+    while (1) {
+        asm volatile("cli");
+        if (softirq_pending() || work_pending()) {
+            asm volatile("sti");
+            do_softirq(); // Left over by interrupt handlers that raised too many
+            work_run();
+        } else asm volatile("sti; hlt"); // STI takes effect after HLT, so no interrupt is missed in between
+    }
 }
\ No newline at end of file
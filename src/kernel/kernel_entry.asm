@@ -14,6 +14,7 @@ KERNEL_STACK_SIZE equ 4*1024 ; In bytes
 
 global kernel_entry
 global read_eip
+global kernel_stack_top
 
 ; Higher-half kernel start
 ; Delete identity mapping, load labels and then call C code
@@ -47,4 +48,5 @@ read_eip:
 
 section .bss
 align 4
-KERNEL_STACK: resb KERNEL_STACK_SIZE ; Reserve space for kernel stack
\ No newline at end of file
+KERNEL_STACK: resb KERNEL_STACK_SIZE ; Reserve space for kernel stack
+kernel_stack_top: ; Top of the kernel stack of the boot processor
\ No newline at end of file
@@ -0,0 +1,171 @@
+// @desc     Kernel log
+// @author   Davide Della Giustina
+// @date     19/10/2026
+
+#include "klog.h"
+
+// Records are fixed-size slots of a ring. A writer reserves a slot with an atomic increment of klog_head, so writers
+// that interrupt each other never share one, and publishes it by storing its sequence number last. Readers copy a slot
+// and check the sequence number again, to notice records overwritten meanwhile. No writer ever waits, and none touches
+// an I/O port: the console reads the ring later, outside of interrupt handlers.
+
+klog_record_t klog_ring[KLOG_ENTRIES];
+volatile uint32_t klog_head = 0; // Next index to reserve
+uint32_t klog_console = 0; // Next index to print on the console
+uint32_t klog_lost = 0; // Records overwritten before the console printed them
+uint8_t klog_console_level = KLOG_INFO;
+uint8_t klog_deferred = 0; // Zero during boot (records are printed right away)
+volatile uint8_t klog_flushing = 0;
+
+static const char *level_names[] = { "emerg", "err", "warn", "info", "debug" };
+
+// Private functions
+
+static uint32_t klog_store(uint8_t level, const char *fmt, va_list args);
+static int klog_read(uint32_t index, klog_record_t *record);
+static void print_record(klog_record_t *record);
+static void klog_bottom_half(void *data);
+
+work_t klog_work = WORK_INIT(klog_bottom_half, NULL); // Prints the new records (once boot is over)
+
+// Public functions
+
+/* Log a message. Only formats it into the ring: the console prints it later (see klog_flush()), so this is cheap and
+ * safe to call from interrupt handlers.
+ * @param level     Severity (KLOG_*).
+ * @param fmt       Format string (see printf.h).
+ */
+void klog(uint8_t level, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    vklog(level, fmt, args);
+    va_end(args);
+}
+
+/* Log a message.
+ * @param level     Severity (KLOG_*).
+ * @param fmt       Format string (see printf.h).
+ * @param args      Arguments.
+ */
+void vklog(uint8_t level, const char *fmt, va_list args) {
+    klog_store(level, fmt, args);
+    if (!klog_deferred) klog_flush();
+    else work_queue(&klog_work);
+}
+
+/* Log a message and print it right away, whatever the console is doing (for panic(): the flush it interrupted, or a
+ * record still being written, would hold it back).
+ * @param level     Severity (KLOG_*).
+ * @param fmt       Format string (see printf.h).
+ */
+void klog_emergency(uint8_t level, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    uint32_t index = klog_store(level, fmt, args);
+    va_end(args);
+    klog_flush(); // The records before it, if possible
+    klog_record_t *record = &klog_ring[index % KLOG_ENTRIES];
+    if (klog_console <= index && record->seq == index + 1) kwrite(record->text, record->len); // Not printed by the flush
+}
+
+/* Print the records the console has not printed yet.
+ */
+void klog_flush() {
+    if (__sync_lock_test_and_set(&klog_flushing, 1)) return; // Already flushing (this call interrupted it)
+    klog_record_t record;
+    while (klog_console != klog_head) {
+        int status = klog_read(klog_console, &record);
+        if (status == 0) break; // Still being written: the next flush prints it
+        if (status < 0) { // Overwritten: skip to the oldest record left
+            uint32_t oldest = klog_head - KLOG_ENTRIES;
+            klog_lost += oldest - klog_console;
+            klog_console = oldest;
+            continue;
+        }
+        ++klog_console;
+        if (record.level <= klog_console_level) kwrite(record.text, record.len);
+    }
+    __sync_lock_release(&klog_flushing);
+}
+
+/* Stop printing each record as soon as it is logged (boot is over: the kernel worker prints them from now on).
+ */
+void klog_defer() {
+    klog_deferred = 1;
+}
+
+/* Set the most verbose level that is printed on the console (all the records go to the ring anyway).
+ * @param level     Severity (KLOG_*).
+ */
+void klog_set_console_level(uint8_t level) {
+    klog_console_level = level;
+}
+
+/* Print the whole ring, with timestamps and levels.
+ */
+void dmesg() {
+    uint32_t head = klog_head, index = (head > KLOG_ENTRIES)? head - KLOG_ENTRIES : 0;
+    klog_record_t record;
+    for (; index != head; ++index) {
+        if (klog_read(index, &record) > 0) print_record(&record);
+    }
+    if (klog_lost > 0) kprintf("(%u records were overwritten before reaching the console)\n", klog_lost);
+}
+
+// Private functions
+
+/* Format a message into the next slot of the ring.
+ * @param level     Severity (KLOG_*).
+ * @param fmt       Format string (see printf.h).
+ * @param args      Arguments.
+ * @return          Index of the record.
+ */
+static uint32_t klog_store(uint8_t level, const char *fmt, va_list args) {
+    uint32_t index = __sync_fetch_and_add(&klog_head, 1);
+    klog_record_t *record = &klog_ring[index % KLOG_ENTRIES];
+    record->seq = 0;
+    asm volatile("" : : : "memory");
+    record->time = read_tsc();
+    record->level = (level > KLOG_DEBUG)? KLOG_DEBUG : level;
+    record->len = vsnprintf(record->text, KLOG_TEXT_SIZE, fmt, args);
+    asm volatile("" : : : "memory"); // The record is complete before it is published
+    record->seq = index + 1;
+    return index;
+}
+
+/* Copy a record out of the ring.
+ * @param index     Index of the record.
+ * @param record    Where to copy it.
+ * @return          1 if copied, 0 if it is still being written, -1 if it was overwritten.
+ */
+static int klog_read(uint32_t index, klog_record_t *record) {
+    klog_record_t *slot = &klog_ring[index % KLOG_ENTRIES];
+    uint32_t seq = slot->seq;
+    if (seq != index + 1) return (seq == 0 || seq < index + 1)? 0 : -1;
+    asm volatile("" : : : "memory");
+    memcpy(record, slot, sizeof(klog_record_t));
+    asm volatile("" : : : "memory");
+    return (slot->seq == index + 1)? 1 : -1; // A writer may have taken the slot during the copy
+}
+
+/* Print a record with its timestamp and level.
+ * @param record    Record.
+ */
+static void print_record(klog_record_t *record) {
+    int len = record->len;
+    if (len > 0 && record->text[len - 1] == '\n') --len;
+    uint64_t time = cycles_to_ns(record->time);
+    div_u64(&time, 1000);
+    uint32_t us = div_u64(&time, 1000000);
+    kprintf("[%5llu.%06u] %-5s ", time, us, level_names[record->level]);
+    kwrite(record->text, len);
+    kprint("\n");
+}
+
+/* Print the new records (in the kernel worker).
+ * @param data      Unused.
+ */
+static void klog_bottom_half(void *data) {
+    klog_flush();
+    (void)(data); // Unused parameter
+}
@@ -0,0 +1,73 @@
+// @desc     Kernel log header
+// @author   Davide Della Giustina
+// @date     19/10/2026
+
+#ifndef KLOG_H
+#define KLOG_H
+
+#include <stdarg.h>
+#include <stdint.h>
+#include "../cpu/tsc.h"
+#include "../drivers/vga.h"
+#include "../libc/printf.h"
+#include "softirq.h"
+
+#define KLOG_ENTRIES        256 // Records in the ring (power of two); the oldest ones are overwritten
+#define KLOG_TEXT_SIZE      112 // Longer messages are truncated
+
+// Severity levels (lower is more severe)
+#define KLOG_EMERG          0 // The system is unusable
+#define KLOG_ERR            1
+#define KLOG_WARN           2
+#define KLOG_INFO           3
+#define KLOG_DEBUG          4 // Not printed on the console by default
+
+// Record of the kernel log (128 bytes)
+typedef struct {
+    volatile uint32_t seq; // Index of the record + 1, once it is complete (0 while it is being written)
+    uint16_t len; // Length of the text
+    uint8_t level; // Severity
+    uint8_t reserved;
+    uint64_t time; // Timestamp (TSC, see cycles_to_ns())
+    char text[KLOG_TEXT_SIZE];
+} klog_record_t;
+
+/* Log a message. Only formats it into the ring: the console prints it later (see klog_flush()), so this is cheap and
+ * safe to call from interrupt handlers.
+ * @param level     Severity (KLOG_*).
+ * @param fmt       Format string (see printf.h).
+ */
+void klog(uint8_t level, const char *fmt, ...);
+
+/* Log a message.
+ * @param level     Severity (KLOG_*).
+ * @param fmt       Format string (see printf.h).
+ * @param args      Arguments.
+ */
+void vklog(uint8_t level, const char *fmt, va_list args);
+
+/* Log a message and print it right away, whatever the console is doing (for panic(): the flush it interrupted, or a
+ * record still being written, would hold it back).
+ * @param level     Severity (KLOG_*).
+ * @param fmt       Format string (see printf.h).
+ */
+void klog_emergency(uint8_t level, const char *fmt, ...);
+
+/* Print the records the console has not printed yet.
+ */
+void klog_flush();
+
+/* Stop printing each record as soon as it is logged (boot is over: the kernel worker prints them from now on).
+ */
+void klog_defer();
+
+/* Set the most verbose level that is printed on the console (all the records go to the ring anyway).
+ * @param level     Severity (KLOG_*).
+ */
+void klog_set_console_level(uint8_t level);
+
+/* Print the whole ring, with timestamps and levels.
+ */
+void dmesg();
+
+#endif
@@ -0,0 +1,143 @@
+// @desc     Memory statistics
+// @author   Davide Della Giustina
+// @date     19/10/2026
+
+#include "meminfo.h"
+#include "../cpu/paging.h"
+
+extern heap_t *kernel_heap; // From heap.c
+extern spinlock_t kernel_heap_lock;
+
+// Private functions
+
+static void print_field(char *name, uint32_t n, char *unit);
+static void print_hex_byte(uint8_t b);
+
+// Public functions
+
+/* Take a snapshot of the memory statistics.
+ * @param info          Where the snapshot will be stored.
+ */
+void get_meminfo(meminfo_t *info) {
+    memset(info, 0, sizeof(meminfo_t));
+    info->version = MEMINFO_VERSION;
+    info->length = sizeof(meminfo_t);
+    uint32_t flags = spin_lock_irqsave(&kernel_heap_lock); // Other processors may be changing the hole lists
+    heap_stats_t *stats = &kernel_heap->stats;
+    info->heap_size = kernel_heap->end_addr - kernel_heap->start_addr;
+    info->heap_peak_size = stats->peak_size;
+    info->heap_in_use = info->heap_size - stats->hole_bytes;
+    info->heap_peak_in_use = stats->peak_in_use;
+    info->hole_count = stats->hole_count;
+    info->hole_bytes = stats->hole_bytes;
+    info->largest_hole = largest_hole(kernel_heap);
+    uint32_t largest = info->largest_hole, free = stats->hole_bytes;
+    while (largest > 0x400000) { // Keep largest * 1000 within 32 bits
+        largest >>= 1;
+        free >>= 1;
+    }
+    info->fragmentation = (free)? 1000 - (largest * 1000) / free : 0;
+    info->allocs = stats->allocs;
+    info->frees = stats->frees;
+    info->reallocs = stats->reallocs;
+    info->expansions = stats->expansions;
+    info->contractions = stats->contractions;
+    int i;
+    for (i = 0; i < HEAP_STAT_BUCKETS; ++i) info->buckets[i] = stats->buckets[i];
+    spin_unlock_irqrestore(&kernel_heap_lock, flags);
+    frame_stats_t frames;
+    get_frame_stats(&frames);
+    info->frames_total = frames.frames_total;
+    info->frames_used = frames.frames_used;
+    info->frames_peak = frames.frames_peak;
+    info->kpages_total = frames.kpages_total;
+    info->kpages_used = frames.kpages_used;
+    info->kpages_peak = frames.kpages_peak;
+}
+
+/* Copy a snapshot of the memory statistics into a buffer, in binary form.
+ * @param buf           Buffer.
+ * @param len           Size of the buffer.
+ * @return              Number of bytes written (at most sizeof(meminfo_t)).
+ */
+uint32_t meminfo_dump(void *buf, uint32_t len) {
+    meminfo_t info;
+    get_meminfo(&info);
+    if (len > sizeof(meminfo_t)) len = sizeof(meminfo_t);
+    memcpy(buf, &info, len);
+    return len;
+}
+
+/* Print the memory statistics.
+ * @param binary        Print a hex dump of the binary snapshot instead of a report.
+ */
+void meminfo(uint8_t binary) {
+    meminfo_t info;
+    if (binary) {
+        uint32_t len = meminfo_dump(&info, sizeof(meminfo_t)), i;
+        for (i = 0; i < len; ++i) {
+            print_hex_byte(((uint8_t *)&info)[i]);
+            kprint(((i & 0xf) == 0xf || i == len - 1)? "\n" : " ");
+        }
+        return;
+    }
+    get_meminfo(&info);
+    kprint("Kernel heap\n");
+    print_field("size", info.heap_size, " B");
+    print_field("peak size", info.heap_peak_size, " B");
+    print_field("in use", info.heap_in_use, " B");
+    print_field("peak in use", info.heap_peak_in_use, " B");
+    print_field("holes", info.hole_count, "");
+    print_field("free", info.hole_bytes, " B");
+    print_field("largest hole", info.largest_hole, " B");
+    print_field("fragmentation", info.fragmentation, " /1000");
+    print_field("allocs", info.allocs, "");
+    print_field("frees", info.frees, "");
+    print_field("reallocs", info.reallocs, "");
+    print_field("expansions", info.expansions, "");
+    print_field("contractions", info.contractions, "");
+    kprint("  sizes:");
+    int i;
+    for (i = 0; i < HEAP_STAT_BUCKETS; ++i) {
+        char buf[12];
+        kprint(" ");
+        kprint(itoa(info.buckets[i], buf, 10));
+    }
+    kprint("\nFrames\n");
+    print_field("total", info.frames_total, "");
+    print_field("used", info.frames_used, "");
+    print_field("peak", info.frames_peak, "");
+    print_field("kernel pages", info.kpages_total, "");
+    print_field("kernel used", info.kpages_used, "");
+    print_field("kernel peak", info.kpages_peak, "");
+}
+
+// Private functions
+
+/* Print a line of the report.
+ * @param name          Name of the field.
+ * @param n             Value.
+ * @param unit          Unit of measure.
+ */
+static void print_field(char *name, uint32_t n, char *unit) {
+    char buf[12];
+    kprint("  ");
+    kprint(name);
+    int i;
+    for (i = strlen(name); i < 16; ++i) kprint(" ");
+    kprint(itoa(n, buf, 10));
+    kprint(unit);
+    kprint("\n");
+}
+
+/* Print a byte as two hex digits.
+ * @param b             Byte.
+ */
+static void print_hex_byte(uint8_t b) {
+    char digits[] = "0123456789abcdef";
+    char str[3];
+    str[0] = digits[b >> 4];
+    str[1] = digits[b & 0xf];
+    str[2] = 0;
+    kprint(str);
+}
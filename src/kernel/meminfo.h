@@ -0,0 +1,54 @@
+// @desc     Memory statistics header
+// @author   Davide Della Giustina
+// @date     19/10/2026
+
+#ifndef MEMINFO_H
+#define MEMINFO_H
+
+#include <stdint.h>
+#include "../drivers/vga.h"
+#include "../libc/mem.h"
+#include "../libc/string.h"
+#include "heap.h"
+
+#define MEMINFO_VERSION     1 // Bump whenever the layout of meminfo_t changes
+
+// Snapshot of the memory statistics (stable binary layout, all fields are 32 bits wide)
+typedef struct {
+    uint32_t version; // MEMINFO_VERSION
+    uint32_t length; // sizeof(meminfo_t)
+    // Kernel heap
+    uint32_t heap_size; // Current size
+    uint32_t heap_peak_size; // High-water mark of the size
+    uint32_t heap_in_use; // Bytes in allocated blocks (headers included)
+    uint32_t heap_peak_in_use; // High-water mark of the bytes in allocated blocks
+    uint32_t hole_count; // Number of holes
+    uint32_t hole_bytes; // Bytes in holes
+    uint32_t largest_hole; // Size of the largest hole
+    uint32_t fragmentation; // External fragmentation (1 - largest hole / free bytes), in thousandths
+    uint32_t allocs, frees, reallocs; // Number of calls
+    uint32_t expansions, contractions; // Number of resizes
+    uint32_t buckets[HEAP_STAT_BUCKETS]; // Allocations by size (< 16, < 32, ..., >= 16K)
+    // Frame allocator
+    uint32_t frames_total, frames_used, frames_peak;
+    uint32_t kpages_total, kpages_used, kpages_peak;
+} __attribute__((packed)) meminfo_t;
+
+/* Take a snapshot of the memory statistics.
+ * @param info          Where the snapshot will be stored.
+ */
+void get_meminfo(meminfo_t *info);
+
+/* Copy a snapshot of the memory statistics into a buffer, in binary form.
+ * @param buf           Buffer.
+ * @param len           Size of the buffer.
+ * @return              Number of bytes written (at most sizeof(meminfo_t)).
+ */
+uint32_t meminfo_dump(void *buf, uint32_t len);
+
+/* Print the memory statistics.
+ * @param binary        Print a hex dump of the binary snapshot instead of a report.
+ */
+void meminfo(uint8_t binary);
+
+#endif
@@ -14,26 +14,56 @@ typedef struct __ready_queue_node_t {
     struct __ready_queue_node_t *next;
 } ready_queue_node_t;
 
+// Timeout of a sleep_on() call (on the stack of the sleeper, which waits for sleep_timeout() to be done with it)
+typedef struct __sleep_t {
+    pcb_t *process;
+    wait_queue_t *queue; // Queue of this sleep (the process may be on another one by the time the timer runs)
+    volatile uint8_t timed_out; // Set by sleep_timeout() if it woke the process up
+    volatile uint8_t done; // Set by sleep_timeout() once it no longer uses the sleep
+} sleep_t;
+
 extern page_directory_t *kernel_directory; // From paging.c
 
+cache_t *pcb_cache; // Process control blocks
+cache_t *ready_queue_node_cache; // Ready queue nodes
+
 pcb_t *init; // Init process
-pcb_t *current_process = NULL; // Currently executing process
-ready_queue_node_t *ready_queue = NULL; // Ready queue
+ready_queue_node_t *ready_queue = NULL; // Ready queue (the processes that are not running on any processor)
 ready_queue_node_t *endof_ready_queue = NULL;
+spinlock_t ready_lock = SPINLOCK_INIT; // Ready queue
 
 uint32_t next_available_pid = 1; // Next available PID
 
+// Private functions
+
+static page_t *get_process_page(pcb_t *process, uint32_t addr);
+static void ready_append(ready_queue_node_t *node);
+static uint8_t process_wake(pcb_t *process);
+static void kick_idle_cpu();
+static void sleep_timeout(void *data);
+
+// Public functions
+
 /* Initialize the structures needed for managing processes.
  */
 void processes_init() {
     asm volatile ("cli"); // Temporarily disable interrupts
+    // Create object caches
+    pcb_cache = cache_create("pcb", sizeof(pcb_t), 0, NULL);
+    ready_queue_node_cache = cache_create("ready_queue_node", sizeof(ready_queue_node_t), 0, NULL);
     // Initialize init process
-    init = (pcb_t *)kmalloc(sizeof(pcb_t));
+    init = (pcb_t *)cache_alloc(pcb_cache);
     init->pid = next_available_pid++;
     init->esp = 0xbfffffff;
     init->ebp = 0xbfffffff;
     init->eip = 0x0;
     init->page_directory = clone_page_directory(kernel_directory);
+    init->brk = USER_HEAP_START;
+    init->fpu = NULL;
+    init->state = PROCESS_RUNNABLE;
+    init->cpu = NULL;
+    init->wait_queue = NULL;
+    init->wait_next = NULL;
     // Add some mapping for text, data and stack sections
     uint32_t i = 0x0, j = (uint32_t)p_init_main;
     while (i < 0x8000) { // 32KiB for each process' text and data sections
@@ -41,7 +71,7 @@ void processes_init() {
         uint32_t pi = ((uint32_t)i >> 12) & 0x3ff; // Page index
         if (!init->page_directory->tables[pti]) { // If not already done, create page_table
             physaddr_t phys;
-            init->page_directory->tables[pti] = (page_table_t *)kcalloc_ap(sizeof(page_table_t), &phys);
+            init->page_directory->tables[pti] = alloc_page_table(&phys);
             init->page_directory->tables_physical[pti] = phys | 0x7;
         }
         physaddr_t addr = alloc_frame(&(init->page_directory->tables[pti]->pages[pi]), 0, 1);
@@ -49,7 +79,7 @@ void processes_init() {
         if (j < (uint32_t)p_init_end) {
             temp_map(addr);
             int nbytes = (((uint32_t)p_init_end - j > 0x1000)? 0x1000 : (uint32_t)p_init_end - j);
-            memcpy((void *)j, (void *)0xc3fff000, nbytes);
+            memcpy((void *)0xc3fff000, (void *)j, nbytes);
             temp_demap();
             j += 0x1000;
         }
@@ -62,7 +92,7 @@ void processes_init() {
         uint32_t pi = ((uint32_t)i >> 12) & 0x3ff; // Page index
         if (!init->page_directory->tables[pti]) {
             physaddr_t phys;
-            init->page_directory->tables[pti] = (page_table_t *)kcalloc_ap(sizeof(page_table_t), &phys);
+            init->page_directory->tables[pti] = alloc_page_table(&phys);
             init->page_directory->tables_physical[pti] = phys | 0x7;
         }
         alloc_frame(&(init->page_directory->tables[pti]->pages[pi]), 0, 1);
@@ -75,12 +105,9 @@ void processes_init() {
  */
 void launch_init() {
     asm volatile("cli");
-    ready_queue_node_t *first_node = kmalloc(sizeof(ready_queue_node_t));
-    first_node->process = init;
-    first_node->next = NULL;
-    endof_ready_queue = first_node;
-    ready_queue = first_node;
-    current_process = init;
+    this_cpu()->current_process = init; // Running, so not in the ready queue
+    init->cpu = this_cpu();
+    fpu_switch(&init->fpu);
     asm volatile("              \
         mov %0, %%ecx;          \
         mov %1, %%ebp;          \
@@ -88,38 +115,121 @@ void launch_init() {
         mov %3, %%cr3;          \
         sti;                    \
         jmp *%%ecx"
-        : : "r"(init->eip), "r"(init->ebp), "r"(init->esp), "r"(init->page_directory->physical_addr));
+        : : "r"(init->eip), "r"(init->ebp), "r"(init->esp), "r"(DIRECTORY_PHYS(init->page_directory)));
 }
 
-/* Perform a context switch.
+/* Perform a context switch on this processor (any processor may run any process in the ready queue).
  */
 void context_switch() {
-    if (ready_queue == NULL) return;
+    if (ready_queue == NULL) return; // Racy peek: the queue is checked again under the lock
+    if (this_cpu()->in_softirq) return; // Softirqs run on the stack of the interrupted process, which must stay here
     uint32_t eip, ebp, esp;
     asm volatile("mov %%ebp, %0" : "=r"(ebp));
     asm volatile("mov %%esp, %0" : "=r"(esp));
     eip = read_eip();
     if (eip == 0xdeadc0de) return; // Just switched process
-    if (current_process != NULL) {
-        current_process->eip = eip;
-        current_process->ebp = ebp;
-        current_process->esp = esp;
+    uint32_t flags = spin_lock_irqsave(&ready_lock);
+    if (ready_queue == NULL) {
+        spin_unlock_irqrestore(&ready_lock, flags);
+        return;
+    }
+    cpu_t *cpu = this_cpu();
+    pcb_t *prev = cpu->current_process, *next = ready_queue->process;
+    // Dequeue the next process, and queue the previous one unless it sleeps (reusing the node)
+    ready_queue_node_t *node = ready_queue;
+    ready_queue = node->next;
+    if (ready_queue == NULL) endof_ready_queue = NULL;
+    if (prev != NULL) {
+        prev->eip = eip;
+        prev->ebp = ebp;
+        prev->esp = esp;
+        prev->cpu = NULL; // Wakers see it only once the lock is released, off its stack
     }
-    current_process = ready_queue->process;
-    // Rotate ready queue
-    endof_ready_queue->next = ready_queue;
-    endof_ready_queue = endof_ready_queue->next;
-    ready_queue = ready_queue->next;
-    endof_ready_queue->next = NULL;
+    if (prev != NULL && prev->state == PROCESS_RUNNABLE) {
+        node->process = prev;
+        ready_append(node);
+    } else cache_free(ready_queue_node_cache, node);
+    cpu->current_process = next;
+    next->cpu = cpu;
+    ++cpu->switches;
     // Switch to the next task
-    asm volatile("cli");
-    switch_page_directory(current_process->page_directory);
-    asm volatile("mov %0, %%ecx" : : "r"(current_process->eip));
-    asm volatile("mov %0, %%ebp" : : "r"(current_process->ebp));
-    asm volatile("mov %0, %%esp" : : "r"(current_process->esp));
-    asm volatile("mov $0xdeadc0de, %eax");
+    fpu_switch(&next->fpu); // Registers are switched lazily, on the first FPU/SSE instruction
+    switch_page_directory(next->page_directory);
+    // The lock is released only once off the stack of the previous process: another processor may resume it right after
+    asm volatile("              \
+        mov %%esi, %%ebp;       \
+        mov %%edi, %%esp;       \
+        lock incl (%%edx);      \
+        mov $0xdeadc0de, %%eax; \
+        sti;                    \
+        jmp *%%ecx"
+        : : "c"(next->eip), "S"(next->ebp), "D"(next->esp), "d"(&ready_lock.owner) : "memory");
+}
+
+/* Check whether processes are waiting for a processor (the timers only need to end time slices then).
+ * @return              Nonzero if the ready queue is not empty.
+ */
+uint8_t processes_waiting() {
+    return ready_queue != NULL;
+}
+
+/* Check whether a processor has no process to run (none taken yet, or the one it holds sleeps in sleep_on()).
+ * @param cpu           Processor.
+ * @return              Nonzero if it would take a process from the ready queue right away.
+ */
+uint8_t cpu_idle(cpu_t *cpu) {
+    pcb_t *process = cpu->current_process;
+    return process == NULL || process->state == PROCESS_SLEEPING;
+}
+
+/* Put the current process to sleep on a wait queue, giving up its processor until woken up (interrupts must be
+ * enabled, and the caller must not be a softirq).
+ * @param queue         Wait queue.
+ * @param timeout       Ticks to wake up after anyway (see timer_add()), 0 for none.
+ * @return              0 if the timeout elapsed first, nonzero otherwise.
+ */
+uint8_t sleep_on(wait_queue_t *queue, uint32_t timeout) {
+    asm volatile("cli"); // Not switched away before the timeout is set
+    assert(!this_cpu()->in_softirq); // Softirqs cannot switch process
+    pcb_t *process = this_cpu()->current_process;
+    assert(process != NULL);
+    sleep_t sleep = { process, queue, 0, 0 };
+    ktimer_t timer = KTIMER_INIT(sleep_timeout, &sleep);
+    spin_lock(&ready_lock);
+    process->state = PROCESS_SLEEPING;
+    process->wait_queue = queue;
+    process->wait_next = queue->head;
+    queue->head = process;
+    spin_unlock(&ready_lock);
+    if (timeout != 0) timer_add(&timer, timeout);
+    while (process->state == PROCESS_SLEEPING) {
+        context_switch(); // Back here once woken up, unless no other process was ready
+        asm volatile("cli");
+        if (process->state == PROCESS_SLEEPING) asm volatile("sti; hlt; cli"); // Keep the processor until then
+    }
     asm volatile("sti");
-    asm volatile("jmp *%ecx");
+    if (timeout != 0 && !timer_del(&timer)) { // Expired: sleep_timeout() may still be running on another processor
+        while (!sleep.done) asm volatile("pause");
+    }
+    return !sleep.timed_out;
+}
+
+/* Wake up all the processes sleeping on a wait queue.
+ * @param queue         Wait queue.
+ * @return              Number of processes woken up.
+ */
+uint32_t wake_up(wait_queue_t *queue) {
+    uint32_t flags = spin_lock_irqsave(&ready_lock), n = 0;
+    uint8_t queued = 0;
+    while (queue->head != NULL) {
+        pcb_t *process = queue->head;
+        queue->head = process->wait_next;
+        queued |= process_wake(process);
+        ++n;
+    }
+    spin_unlock_irqrestore(&ready_lock, flags);
+    if (queued) timer_update(timer_get_ticks() + 1); // End the time slice of the running process
+    return n;
 }
 
 /* Fork POSIX call: create a new process.
@@ -139,9 +249,124 @@ void execv(char *program, char **args) {
     (void)program; (void)args;
 }
 
+/* Move the program break of a process, mapping or unmapping heap pages as needed.
+ * @param process       Process.
+ * @param incr          Number of bytes to add to the heap (negative to shrink it).
+ * @return              Previous program break, (void *)-1 if the new one would be outside the heap area.
+ */
+void *process_sbrk(pcb_t *process, int incr) {
+    uint32_t old_brk = process->brk;
+    uint32_t new_brk = old_brk + incr;
+    if ((incr > 0 && (new_brk < old_brk || new_brk > USER_HEAP_END)) || (incr < 0 && (new_brk > old_brk || new_brk < USER_HEAP_START))) return (void *)-1;
+    uint32_t old_end = (old_brk + 0xfff) & ~0xfff, new_end = (new_brk + 0xfff) & ~0xfff; // Heap pages are [USER_HEAP_START, end)
+    uint32_t addr;
+    for (addr = old_end; addr < new_end; addr += 0x1000) { // Grow
+        page_t *page = get_process_page(process, addr);
+        physaddr_t frame = alloc_frame(page, 0, 1);
+        if (process == this_cpu()->current_process) {
+            asm volatile("invlpg (%0)" : : "r"(addr) : "memory");
+            memset((void *)addr, 0, 0x1000); // Never leak the previous contents of the frame
+        } else { // Not mapped in this address space
+            temp_map(frame);
+            memset((void *)0xc3fff000, 0, 0x1000);
+            temp_demap();
+        }
+    }
+    for (addr = new_end; addr < old_end; addr += 0x1000) { // Shrink
+        page_t *page = get_process_page(process, addr);
+        free_frame(page);
+        page->present = 0;
+        if (process == this_cpu()->current_process) asm volatile("invlpg (%0)" : : "r"(addr) : "memory");
+    }
+    process->brk = new_brk;
+    return (void *)old_brk;
+}
+
 /* Retrieve the PID of the current process.
  * @return              PID.
  */
 int getpid() {
-    return current_process->pid;
-}
\ No newline at end of file
+    return this_cpu()->current_process->pid;
+}
+
+// Private functions
+
+/* Get the page table entry of an address in the address space of a process, creating its page table if needed.
+ * @param process       Process.
+ * @param addr          Virtual address.
+ * @return              Page table entry.
+ */
+static page_t *get_process_page(pcb_t *process, uint32_t addr) {
+    uint32_t pti = addr >> 22; // Page table index
+    uint32_t pi = (addr >> 12) & 0x3ff; // Page index
+    if (!process->page_directory->tables[pti]) {
+        physaddr_t phys;
+        process->page_directory->tables[pti] = alloc_page_table(&phys);
+        process->page_directory->tables_physical[pti] = phys | 0x7;
+    }
+    return &(process->page_directory->tables[pti]->pages[pi]);
+}
+
+/* Add a node at the end of the ready queue (with the ready lock held).
+ * @param node          Node (its process set).
+ */
+static void ready_append(ready_queue_node_t *node) {
+    node->next = NULL;
+    if (endof_ready_queue != NULL) endof_ready_queue->next = node;
+    else ready_queue = node;
+    endof_ready_queue = node;
+}
+
+/* Make a sleeping process runnable (with the ready lock held, after removing it from its wait queue).
+ * @param process       Process.
+ * @return              Nonzero if it was added to the ready queue (it had given up its processor).
+ */
+static uint8_t process_wake(pcb_t *process) {
+    process->state = PROCESS_RUNNABLE;
+    process->wait_queue = NULL;
+    process->wait_next = NULL;
+    if (process->cpu != NULL) { // Still halted in sleep_on()
+        smp_kick(process->cpu);
+        return 0;
+    }
+    ready_queue_node_t *node = (ready_queue_node_t *)cache_alloc(ready_queue_node_cache);
+    node->process = process;
+    ready_append(node);
+    kick_idle_cpu();
+    return 1;
+}
+
+/* Interrupt an idle application processor, for it to take the process just queued (the boot processor ends its time
+ * slice through timer_update() instead). In tickless mode nothing else would wake it up.
+ */
+static void kick_idle_cpu() {
+    cpu_t *self = this_cpu();
+    uint32_t i;
+    for (i = 1; i < smp_cpu_count(); ++i) {
+        cpu_t *cpu = smp_cpu(i);
+        if (cpu != self && cpu_idle(cpu)) {
+            smp_kick(cpu);
+            return;
+        }
+    }
+}
+
+/* Wake up a process at the end of its sleep_on() timeout.
+ * @param data          Sleep.
+ */
+static void sleep_timeout(void *data) {
+    sleep_t *sleep = (sleep_t *)data;
+    pcb_t *process = sleep->process;
+    uint32_t flags = spin_lock_irqsave(&ready_lock);
+    uint8_t queued = 0;
+    if (process->state == PROCESS_SLEEPING && process->wait_queue == sleep->queue) { // Not woken up meanwhile
+        pcb_t **link = &process->wait_queue->head;
+        while (*link != process) link = &(*link)->wait_next;
+        *link = process->wait_next;
+        queued = process_wake(process);
+        sleep->timed_out = 1;
+    }
+    spin_unlock_irqrestore(&ready_lock, flags);
+    sleep->done = 1; // The sleep is gone as soon as it is done
+    if (queued) timer_update(timer_get_ticks() + 1);
+}
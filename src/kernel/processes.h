@@ -6,19 +6,43 @@
 #define PROCESSES_H
 
 #include <stdint.h>
+#include "../cpu/fpu.h"
 #include "../cpu/isr.h"
 #include "../cpu/paging.h"
+#include "../cpu/smp.h"
+#include "../cpu/spinlock.h"
 #include "../libc/mem.h"
 #include "heap.h"
+#include "slab.h"
+#include "timers.h"
+
+#define USER_HEAP_START     0x8000 // The program break starts right after text and data sections...
+#define USER_HEAP_END       0xbf000000 // ... and cannot grow into the stack area
+
+#define PROCESS_RUNNABLE    0 // Running, or in the ready queue
+#define PROCESS_SLEEPING    1 // On a wait queue
 
 // Represent a process control block
-typedef struct {
+typedef struct __pcb_t {
     int pid; // Process ID
     uint32_t esp, ebp; // Stack pointers
     uint32_t eip; // Instruction pointer
     page_directory_t *page_directory; // Address space (page directory)
+    uint32_t brk; // Program break (end of the process' heap)
+    fpu_state_t *fpu; // FPU/SSE registers (allocated when the process first uses them)
+    volatile uint8_t state; // PROCESS_*
+    cpu_t *cpu; // Processor running the process (NULL if none)
+    struct __wait_queue_t *wait_queue; // Queue the process sleeps on (NULL if none)
+    struct __pcb_t *wait_next; // Next process on the same wait queue
 } pcb_t;
 
+// Processes waiting for an event (the ready lock of processes.c protects all the queues)
+typedef struct __wait_queue_t {
+    pcb_t *head;
+} wait_queue_t;
+
+#define WAIT_QUEUE_INIT     { NULL }
+
 /* Initialize the structures needed for managing processes.
  */
 void processes_init();
@@ -27,10 +51,35 @@ void processes_init();
  */
 void launch_init();
 
-/* Perform a context switch.
+/* Perform a context switch on this processor (any processor may run any process in the ready queue).
  */
 void context_switch();
 
+/* Check whether processes are waiting for a processor (the timers only need to end time slices then).
+ * @return              Nonzero if the ready queue is not empty.
+ */
+uint8_t processes_waiting();
+
+/* Check whether a processor has no process to run (none taken yet, or the one it holds sleeps in sleep_on()).
+ * @param cpu           Processor.
+ * @return              Nonzero if it would take a process from the ready queue right away.
+ */
+uint8_t cpu_idle(cpu_t *cpu);
+
+/* Put the current process to sleep on a wait queue, giving up its processor until woken up (interrupts must be
+ * enabled, and the caller must not be a softirq).
+ * @param queue         Wait queue.
+ * @param timeout       Ticks to wake up after anyway (see timer_add()), 0 for none.
+ * @return              0 if the timeout elapsed first, nonzero otherwise.
+ */
+uint8_t sleep_on(wait_queue_t *queue, uint32_t timeout);
+
+/* Wake up all the processes sleeping on a wait queue.
+ * @param queue         Wait queue.
+ * @return              Number of processes woken up.
+ */
+uint32_t wake_up(wait_queue_t *queue);
+
 /* Fork POSIX call: create a new process.
  * @return              0 to the child process, child PIC to the parent process.
  */
@@ -42,6 +91,13 @@ int fork();
  */
 void execv(char *program, char **args);
 
+/* Move the program break of a process, mapping or unmapping heap pages as needed.
+ * @param process       Process.
+ * @param incr          Number of bytes to add to the heap (negative to shrink it).
+ * @return              Previous program break, (void *)-1 if the new one would be outside the heap area.
+ */
+void *process_sbrk(pcb_t *process, int incr);
+
 /* Retrieve the PID of the current process.
  * @return              PID.
  */
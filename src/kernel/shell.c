@@ -6,16 +6,11 @@ extern void print_ascii_art();
 
 /* Parse basic shell commands.
  * @param cmd           Input command.
+ * @param len           Length of the command.
  */
-void parse_input(char *cmd) {
+void parse_input(char *cmd, size_t len) {
     if (strncmp(cmd, "echo ", 4) == 0) { // ECHO
-        int i;
-        for (i = 5; i < strlen(cmd); ++i) {
-            char c[2];
-            c[0] = cmd[i];
-            c[1] = 0;
-            kprint(c);
-        }
+        if (len > 5) kprint(cmd + 5);
         kprint("\n");
     } else if (strcmp(cmd, "clear") == 0) { // CLEAR
         clear_screen();
@@ -23,6 +18,29 @@ void parse_input(char *cmd) {
         kprint("\n\n");
     } else if (strcmp(cmd, "who") == 0) { // WHO
         kprint("root\n");
+    } else if (strcmp(cmd, "slabinfo") == 0) { // SLABINFO
+        slabinfo();
+    } else if (strcmp(cmd, "meminfo") == 0) { // MEMINFO
+        meminfo(0);
+    } else if (strcmp(cmd, "meminfo -b") == 0) { // MEMINFO (binary snapshot)
+        meminfo(1);
+    } else if (strcmp(cmd, "alloctrace") == 0) { // ALLOCTRACE
+        alloctrace_report();
+    } else if (strcmp(cmd, "alloctrace on") == 0 || strcmp(cmd, "alloctrace off") == 0) { // ALLOCTRACE (start / stop)
+        if (!alloctrace_enable(strcmp(cmd, "alloctrace on") == 0)) kprint("Allocation tracing is not compiled in (build with HEAP_TRACE=1)\n");
+    } else if (strcmp(cmd, "alloctrace clear") == 0) { // ALLOCTRACE (discard events)
+        alloctrace_clear();
+    } else if (strcmp(cmd, "dmesg") == 0) { // DMESG
+        dmesg();
+    } else if (strcmp(cmd, "irqstat") == 0 || strcmp(cmd, "irqstat -r") == 0) { // IRQSTAT (-r: reset afterwards)
+        irqstat(len > 7);
+    } else if (strcmp(cmd, "vgabench") == 0) { // VGABENCH
+        vga_bench();
+    } else if (strcmp(cmd, "console vga") == 0) { // CONSOLE (output on the screen)
+        console_set_outputs(CONSOLE_VGA);
+    } else if (strcmp(cmd, "console serial") == 0 || strcmp(cmd, "console both") == 0) { // CONSOLE (output on COM1, or both)
+        if (!serial_present()) kprint("No serial port\n");
+        else console_set_outputs(CONSOLE_SERIAL | ((cmd[8] == 'b')? CONSOLE_VGA : 0));
     } else if (strcmp(cmd, "shutdown") == 0) { // SHUTDOWN
         kprint("Shutting down the system...\n");
         outw(0x604, 0x2000); // QEMU specific instuction for shutdown
@@ -30,7 +48,7 @@ void parse_input(char *cmd) {
         outw(0x4004, 0x3400); // Virtualbox
     } else if (strcmp(cmd, "halt") == 0) { // HALT
         kprint("Halting the CPU...\n");
-        asm volatile("hlt");
+        asm volatile("cli; hlt"); // Commands run with interrupts enabled: without cli the next one would resume the CPU
     } else { // UNRECOGNISED COMMAND
         kprint("Unrecognised command\n");
     }
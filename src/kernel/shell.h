@@ -4,14 +4,20 @@
 #define SHELL_H
 
 #include <stdint.h>
+#include "../cpu/isr.h"
 #include "../drivers/vga.h"
+#include "../drivers/vga_bench.h"
 #include "../libc/mem.h"
 #include "../libc/string.h"
 #include "heap.h"
+#include "klog.h"
+#include "meminfo.h"
+#include "slab.h"
 
 /* Parse basic shell commands.
  * @param cmd           Input command.
+ * @param len           Length of the command.
  */
-void parse_input(char *cmd);
+void parse_input(char *cmd, size_t len);
 
 #endif
\ No newline at end of file
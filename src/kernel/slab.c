@@ -0,0 +1,229 @@
+// @desc     Slab allocator
+// @author   Davide Della Giustina
+// @date     19/10/2026
+
+#include "slab.h"
+#include "../cpu/paging.h"
+
+#define SLAB_PAGE_INDEX(p)  (((uint32_t)(p) - KPAGE_VIRT_START) / SLAB_PAGE_SIZE) // Kernel page of an address (see slab_pages)
+
+cache_t *caches = NULL; // List of all caches
+spinlock_t caches_lock = SPINLOCK_INIT; // List of all caches
+static cache_t slab_cache; // Cache of off-slab descriptors (statically allocated to break the recursion)
+slab_t **slab_pages = NULL; // Off-slab descriptor of each kernel page (indexed like kpage_runs), to find it from an object
+
+/* Insert a slab at the head of a list.
+ * @param list          List.
+ * @param slab          Slab.
+ */
+static void list_push(slab_t **list, slab_t *slab) {
+    slab->prev = NULL;
+    slab->next = *list;
+    if (*list) (*list)->prev = slab;
+    *list = slab;
+}
+
+/* Remove a slab from a list.
+ * @param list          List.
+ * @param slab          Slab.
+ */
+static void list_remove(slab_t **list, slab_t *slab) {
+    if (slab->next) slab->next->prev = slab->prev;
+    if (slab->prev) slab->prev->next = slab->next;
+    else *list = slab->next;
+}
+
+/* Fill in the geometry of a cache.
+ * @param cache         Cache.
+ * @param name          Name of the cache.
+ * @param size          Size of the objects.
+ * @param align         Alignment of the objects.
+ * @param ctor          Constructor.
+ */
+static void cache_setup(cache_t *cache, char *name, uint32_t size, uint32_t align, cache_ctor_t ctor) {
+    if (align < sizeof(void *)) align = sizeof(void *);
+    assert((align & (align - 1)) == 0); // Must be a power of two
+    memset(cache, 0, sizeof(cache_t));
+    strlcpy(cache->name, name, CACHE_NAME_LENGTH);
+    cache->object_size = size;
+    cache->align = align;
+    cache->ctor = ctor;
+    // Without a constructor the free pointer can overwrite the object, otherwise it goes right after it
+    cache->free_offset = ((ctor)? (size + sizeof(void *) - 1) & ~(sizeof(void *) - 1) : 0);
+    uint32_t slot = cache->free_offset + sizeof(void *);
+    if (slot < size) slot = size;
+    cache->stride = (slot + align - 1) & ~(align - 1);
+    if (size <= SLAB_SMALL_MAX) { // One page, descriptor at its beginning
+        uint32_t first = (sizeof(slab_t) + align - 1) & ~(align - 1);
+        cache->off_slab = 0;
+        cache->slab_size = SLAB_PAGE_SIZE;
+        cache->objects_per_slab = (SLAB_PAGE_SIZE - first) / cache->stride;
+    } else { // Enough pages for a few objects, descriptor allocated apart
+        cache->off_slab = 1;
+        cache->slab_size = (SLAB_MIN_OBJECTS * cache->stride + SLAB_PAGE_SIZE - 1) & ~(SLAB_PAGE_SIZE - 1);
+        cache->objects_per_slab = cache->slab_size / cache->stride;
+    }
+    uint32_t flags = spin_lock_irqsave(&caches_lock);
+    cache->next = caches;
+    caches = cache;
+    spin_unlock_irqrestore(&caches_lock, flags);
+}
+
+/* Create a new cache of objects.
+ * @param name          Name of the cache (shown by slabinfo).
+ * @param size          Size of the objects.
+ * @param align         Alignment of the objects (power of two, 0 for word alignment).
+ * @param ctor          Constructor, run once on every object when its slab is created (NULL for none).
+ * @return              Pointer to the new cache.
+ */
+cache_t *cache_create(char *name, uint32_t size, uint32_t align, cache_ctor_t ctor) {
+    if (slab_cache.object_size == 0) { // First cache ever
+        cache_setup(&slab_cache, "slab", sizeof(slab_t), 0, NULL);
+        slab_pages = (slab_t **)kcalloc(((KPAGE_PHYS_END - KPAGE_PHYS_START) / SLAB_PAGE_SIZE) * sizeof(slab_t *));
+    }
+    cache_t *cache = (cache_t *)kmalloc(sizeof(cache_t));
+    cache_setup(cache, name, size, align, ctor);
+    return cache;
+}
+
+/* Allocate and initialize a new (empty) slab for a cache.
+ * @param cache         Cache.
+ * @return              The new slab.
+ */
+static slab_t *cache_grow(cache_t *cache) {
+    void *mem = kpage_alloc(cache->slab_size / SLAB_PAGE_SIZE, NULL); // Slabs are page-aligned, so that descriptors can be found from objects
+    slab_t *slab;
+    uint32_t first, i;
+    if (cache->off_slab) {
+        slab = (slab_t *)cache_alloc(&slab_cache);
+        first = (uint32_t)mem;
+        for (i = 0; i < cache->slab_size / SLAB_PAGE_SIZE; ++i) slab_pages[SLAB_PAGE_INDEX(first) + i] = slab;
+    } else {
+        slab = (slab_t *)mem;
+        first = (uint32_t)mem + ((sizeof(slab_t) + cache->align - 1) & ~(cache->align - 1));
+    }
+    slab->cache = cache;
+    slab->mem = (void *)first;
+    slab->inuse = 0;
+    slab->free_list = NULL;
+    // Build the free list backwards, so that objects are handed out in address order
+    i = cache->objects_per_slab;
+    while (i-- > 0) {
+        void *obj = (void *)(first + i * cache->stride);
+        if (cache->ctor) cache->ctor(obj);
+        *(void **)((uint32_t)obj + cache->free_offset) = slab->free_list;
+        slab->free_list = obj;
+    }
+    list_push(&cache->empty, slab);
+    ++cache->nslabs;
+    return slab;
+}
+
+/* Find the slab an object belongs to.
+ * @param cache         Cache.
+ * @param obj           Object.
+ * @return              Slab.
+ */
+static slab_t *find_slab(cache_t *cache, void *obj) {
+    if (!cache->off_slab) return (slab_t *)((uint32_t)obj & ~(SLAB_PAGE_SIZE - 1)); // Descriptor at the beginning of the page
+    if (!is_kpage(obj)) return NULL;
+    return slab_pages[SLAB_PAGE_INDEX(obj)]; // Off-slab descriptor, recorded for every page of the slab
+}
+
+/* Allocate an object from a cache.
+ * @param cache         Cache.
+ * @return              Pointer to the object.
+ */
+void *cache_alloc(cache_t *cache) {
+    slab_t *slab;
+    uint32_t flags = spin_lock_irqsave(&cache->lock);
+    if (cache->partial) slab = cache->partial;
+    else {
+        slab = ((cache->empty)? cache->empty : cache_grow(cache));
+        list_remove(&cache->empty, slab);
+        list_push(&cache->partial, slab);
+    }
+    void *obj = slab->free_list;
+    slab->free_list = *(void **)((uint32_t)obj + cache->free_offset);
+    ++slab->inuse;
+    ++cache->active_objects;
+    if (slab->inuse == cache->objects_per_slab) { // Slab is now full
+        list_remove(&cache->partial, slab);
+        list_push(&cache->full, slab);
+    }
+    spin_unlock_irqrestore(&cache->lock, flags);
+    return obj;
+}
+
+/* Give an object back to its cache.
+ * Objects of caches with a constructor must be freed in their constructed state.
+ * @param cache         Cache.
+ * @param obj           Pointer to the object.
+ */
+void cache_free(cache_t *cache, void *obj) {
+    if (obj == NULL) return;
+    uint32_t flags = spin_lock_irqsave(&cache->lock);
+    slab_t *slab = find_slab(cache, obj);
+    assert(slab != NULL && slab->cache == cache);
+    if (slab->inuse == cache->objects_per_slab) { // Slab was full
+        list_remove(&cache->full, slab);
+        list_push(&cache->partial, slab);
+    }
+    *(void **)((uint32_t)obj + cache->free_offset) = slab->free_list;
+    slab->free_list = obj;
+    --slab->inuse;
+    --cache->active_objects;
+    if (slab->inuse == 0) { // Slab is now empty
+        list_remove(&cache->partial, slab);
+        list_push(&cache->empty, slab);
+    }
+    spin_unlock_irqrestore(&cache->lock, flags);
+}
+
+/* Release the empty slabs of a cache to the page allocator.
+ * @param cache         Cache.
+ */
+void cache_shrink(cache_t *cache) {
+    uint32_t flags = spin_lock_irqsave(&cache->lock);
+    while (cache->empty) {
+        slab_t *slab = cache->empty;
+        list_remove(&cache->empty, slab);
+        --cache->nslabs;
+        if (cache->off_slab) {
+            uint32_t i;
+            for (i = 0; i < cache->slab_size / SLAB_PAGE_SIZE; ++i) slab_pages[SLAB_PAGE_INDEX(slab->mem) + i] = NULL;
+            kpage_free(slab->mem);
+            cache_free(&slab_cache, slab);
+        } else kpage_free(slab);
+    }
+    spin_unlock_irqrestore(&cache->lock, flags);
+}
+
+/* Print a number, right-aligned in a column.
+ * @param n             Number.
+ * @param width         Column width.
+ */
+static void print_column(uint32_t n, int width) {
+    char buf[12];
+    itoa(n, buf, 10);
+    int i;
+    for (i = strlen(buf); i < width; ++i) kprint(" ");
+    kprint(buf);
+}
+
+/* Print statistics about every cache.
+ */
+void slabinfo() {
+    kprint("name             objsize  active   total   slabs\n");
+    cache_t *cache;
+    for (cache = caches; cache != NULL; cache = cache->next) {
+        kprint(cache->name);
+        int i;
+        for (i = strlen(cache->name); i < CACHE_NAME_LENGTH; ++i) kprint(" ");
+        print_column(cache->object_size, 8);
+        print_column(cache->active_objects, 8);
+        print_column(cache->nslabs * cache->objects_per_slab, 8);
+        print_column(cache->nslabs, 8);
+        kprint("\n");
+    }
+}
@@ -0,0 +1,83 @@
+// @desc     Slab allocator header
+// @author   Davide Della Giustina
+// @date     19/10/2026
+
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stdint.h>
+#include "../cpu/spinlock.h"
+#include "../drivers/vga.h"
+#include "../libc/assert.h"
+#include "../libc/mem.h"
+#include "../libc/string.h"
+#include "heap.h"
+
+#define SLAB_PAGE_SIZE      0x1000 // Slabs are made of whole pages
+#define SLAB_SMALL_MAX      (SLAB_PAGE_SIZE / 8) // Objects up to this size live in one-page slabs, with the slab descriptor on the slab itself
+#define SLAB_MIN_OBJECTS    4 // Minimum number of objects in a slab of large objects
+#define CACHE_NAME_LENGTH   16
+
+typedef void (*cache_ctor_t)(void *); // Object constructor
+
+struct __cache_t;
+
+// Slab (a contiguous group of pages split into objects)
+typedef struct __slab_t {
+    struct __slab_t *prev, *next; // Neighbours in the cache list the slab is in
+    struct __cache_t *cache; // Owner cache
+    void *mem; // Address of the first object
+    void *free_list; // Free objects, linked through their free pointer
+    uint32_t inuse; // Number of allocated objects
+} slab_t;
+
+// Cache of same-sized objects
+typedef struct __cache_t {
+    char name[CACHE_NAME_LENGTH];
+    uint32_t object_size; // Size of an object, as requested
+    uint32_t align; // Alignment of the objects
+    uint32_t stride; // Distance between two objects (object + free pointer, aligned)
+    uint32_t free_offset; // Offset of the free pointer inside an object slot
+    uint32_t objects_per_slab;
+    uint32_t slab_size; // Size of a slab (in bytes)
+    uint8_t off_slab; // Set if slab descriptors are allocated outside of the slabs
+    cache_ctor_t ctor; // Constructor (may be NULL)
+    slab_t *partial, *full, *empty; // Slab lists
+    uint32_t nslabs; // Number of slabs
+    uint32_t active_objects; // Number of allocated objects
+    struct __cache_t *next; // Next cache in the list of all caches
+    spinlock_t lock; // Slab lists and counters
+} cache_t;
+
+/* Create a new cache of objects.
+ * @param name          Name of the cache (shown by slabinfo).
+ * @param size          Size of the objects.
+ * @param align         Alignment of the objects (power of two, 0 for word alignment).
+ * @param ctor          Constructor, run once on every object when its slab is created (NULL for none).
+ * @return              Pointer to the new cache.
+ */
+cache_t *cache_create(char *name, uint32_t size, uint32_t align, cache_ctor_t ctor);
+
+/* Allocate an object from a cache.
+ * @param cache         Cache.
+ * @return              Pointer to the object.
+ */
+void *cache_alloc(cache_t *cache);
+
+/* Give an object back to its cache.
+ * Objects of caches with a constructor must be freed in their constructed state.
+ * @param cache         Cache.
+ * @param obj           Pointer to the object.
+ */
+void cache_free(cache_t *cache, void *obj);
+
+/* Release the empty slabs of a cache to the page allocator.
+ * @param cache         Cache.
+ */
+void cache_shrink(cache_t *cache);
+
+/* Print statistics about every cache.
+ */
+void slabinfo();
+
+#endif
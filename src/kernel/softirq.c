@@ -0,0 +1,197 @@
+// @desc     Deferred work (softirqs, tasklets and the kernel worker)
+// @author   Davide Della Giustina
+// @date     19/10/2026
+
+#include "softirq.h"
+#include "../cpu/smp.h"
+
+// Interrupt handlers are top halves: they acknowledge the device, save what cannot wait and defer the rest, so that
+// interrupts stay disabled only briefly. Softirqs run right after the outermost interrupt handler returns, with
+// interrupts enabled; work items run in the kernel worker, for anything that may block or take long (e.g. a shell
+// command).
+
+softirq_handler_t softirq_handlers[SOFTIRQ_VECTORS];
+work_t *work_head = NULL, *work_tail = NULL; // Queue of the kernel worker
+spinlock_t work_lock = SPINLOCK_INIT;
+volatile uint32_t work_running = 0; // Set while a processor is the kernel worker (only one at a time, so items run in order)
+
+// Private functions
+
+static void work_run_queue();
+static void tasklet_enqueue(tasklet_t *t, uint32_t list, uint32_t nr);
+static void tasklet_action(uint32_t list, uint32_t nr);
+static void tasklet_hi_softirq();
+static void tasklet_softirq();
+
+// Public functions
+
+/* Install the tasklet softirqs.
+ */
+void softirq_init() {
+    open_softirq(SOFTIRQ_HI, tasklet_hi_softirq);
+    open_softirq(SOFTIRQ_TASKLET, tasklet_softirq);
+}
+
+/* Set the handler of a softirq vector.
+ * @param nr            Vector (SOFTIRQ_*).
+ * @param handler       Handler (runs with interrupts enabled).
+ */
+void open_softirq(uint32_t nr, softirq_handler_t handler) {
+    assert(nr < SOFTIRQ_VECTORS);
+    softirq_handlers[nr] = handler;
+}
+
+/* Mark a softirq as pending on this processor (it runs when the current interrupt handler returns, or in the kernel
+ * worker).
+ * @param nr            Vector (SOFTIRQ_*).
+ */
+void raise_softirq(uint32_t nr) {
+    __sync_fetch_and_or(&this_cpu()->softirq_pending, 0x1 << nr);
+}
+
+/* Run the pending softirqs of this processor, with interrupts enabled (does nothing when called from a softirq).
+ */
+void do_softirq() {
+    uint32_t flags;
+    asm volatile("pushf; pop %0; cli" : "=r" (flags) : : "memory");
+    cpu_t *cpu = this_cpu(); // The caller cannot move while softirqs run (context_switch() checks in_softirq)
+    if (!cpu->in_softirq) {
+        cpu->in_softirq = 1;
+        uint32_t rounds = SOFTIRQ_MAX_RESTART, pending;
+        while (rounds-- > 0 && (pending = __sync_lock_test_and_set(&cpu->softirq_pending, 0)) != 0) {
+            asm volatile("sti");
+            uint32_t nr;
+            for (nr = 0; pending != 0; ++nr, pending >>= 1) {
+                if ((pending & 0x1) && softirq_handlers[nr] != NULL) softirq_handlers[nr]();
+            }
+            asm volatile("cli");
+        }
+        cpu->in_softirq = 0;
+    }
+    asm volatile("push %0; popf" : : "r" (flags) : "memory", "cc");
+}
+
+/* Check whether this processor has pending softirqs.
+ * @return              Nonzero if do_softirq() has something to do.
+ */
+uint8_t softirq_pending() {
+    return this_cpu()->softirq_pending != 0;
+}
+
+/* Schedule a tasklet on this processor (does nothing if it is already scheduled).
+ * @param t             Tasklet.
+ */
+void tasklet_schedule(tasklet_t *t) {
+    if (__sync_fetch_and_or(&t->state, TASKLET_SCHED) & TASKLET_SCHED) return;
+    tasklet_enqueue(t, 1, SOFTIRQ_TASKLET);
+}
+
+/* Schedule a tasklet on this processor, ahead of the other softirqs (does nothing if it is already scheduled).
+ * @param t             Tasklet.
+ */
+void tasklet_hi_schedule(tasklet_t *t) {
+    if (__sync_fetch_and_or(&t->state, TASKLET_SCHED) & TASKLET_SCHED) return;
+    tasklet_enqueue(t, 0, SOFTIRQ_HI);
+}
+
+/* Queue a work item for the kernel worker (does nothing if it is already queued).
+ * @param work          Work item.
+ */
+void work_queue(work_t *work) {
+    uint32_t flags = spin_lock_irqsave(&work_lock);
+    uint8_t kick = 0;
+    if (!work->queued) {
+        work->queued = 1;
+        work->next = NULL;
+        if (work_tail != NULL) work_tail->next = work;
+        else work_head = work;
+        work_tail = work;
+        kick = this_cpu()->index != 0;
+    }
+    spin_unlock_irqrestore(&work_lock, flags);
+    if (kick) smp_kick(smp_cpu(0)); // Its idle loop may be halted, with no interrupt coming in tickless mode
+}
+
+/* Check whether the kernel worker has something to do.
+ * @return              Nonzero if work items are queued, and no processor is running them already.
+ */
+uint8_t work_pending() {
+    return work_head != NULL && !work_running;
+}
+
+/* Run the queued work items, in order (the kernel worker: the idle loop of any processor, one at a time).
+ */
+void work_run() {
+    while (work_head != NULL && !__sync_lock_test_and_set(&work_running, 1)) { // Check again once released
+        work_run_queue();
+    }
+}
+
+// Private functions
+
+/* Run the queued work items until the queue is empty (as the kernel worker).
+ */
+static void work_run_queue() {
+    while (1) {
+        uint32_t flags = spin_lock_irqsave(&work_lock);
+        work_t *work = work_head;
+        if (work != NULL) {
+            work_head = work->next;
+            if (work_head == NULL) work_tail = NULL;
+            work->queued = 0; // It may be queued again while it runs
+        }
+        spin_unlock_irqrestore(&work_lock, flags);
+        if (work == NULL) break;
+        work->func(work->data);
+    }
+    __sync_lock_release(&work_running);
+}
+
+/* Add a scheduled tasklet to a list of this processor, and raise its softirq.
+ * @param t             Tasklet (with TASKLET_SCHED set).
+ * @param list          List (0 for high priority, 1 for normal).
+ * @param nr            Softirq of the list.
+ */
+static void tasklet_enqueue(tasklet_t *t, uint32_t list, uint32_t nr) {
+    uint32_t flags;
+    asm volatile("pushf; pop %0; cli" : "=r" (flags) : : "memory");
+    cpu_t *cpu = this_cpu();
+    t->next = cpu->tasklets[list];
+    cpu->tasklets[list] = t;
+    __sync_fetch_and_or(&cpu->softirq_pending, 0x1 << nr);
+    asm volatile("push %0; popf" : : "r" (flags) : "memory", "cc");
+}
+
+/* Run the tasklets scheduled on this processor.
+ * @param list          List (0 for high priority, 1 for normal).
+ * @param nr            Softirq of the list.
+ */
+static void tasklet_action(uint32_t list, uint32_t nr) {
+    asm volatile("cli");
+    cpu_t *cpu = this_cpu();
+    tasklet_t *t = cpu->tasklets[list];
+    cpu->tasklets[list] = NULL;
+    asm volatile("sti");
+    while (t != NULL) {
+        tasklet_t *next = t->next;
+        if (__sync_fetch_and_or(&t->state, TASKLET_RUN) & TASKLET_RUN) tasklet_enqueue(t, list, nr); // Running elsewhere: try again later
+        else {
+            __sync_fetch_and_and(&t->state, ~TASKLET_SCHED); // It may be scheduled again from now on
+            t->func(t->data);
+            __sync_fetch_and_and(&t->state, ~TASKLET_RUN);
+        }
+        t = next;
+    }
+}
+
+/* Softirq of the high priority tasklets.
+ */
+static void tasklet_hi_softirq() {
+    tasklet_action(0, SOFTIRQ_HI);
+}
+
+/* Softirq of the tasklets.
+ */
+static void tasklet_softirq() {
+    tasklet_action(1, SOFTIRQ_TASKLET);
+}
@@ -0,0 +1,95 @@
+// @desc     Deferred work (softirqs, tasklets and the kernel worker) header
+// @author   Davide Della Giustina
+// @date     19/10/2026
+
+#ifndef SOFTIRQ_H
+#define SOFTIRQ_H
+
+#include <stdint.h>
+#include "../cpu/spinlock.h"
+#include "../libc/assert.h"
+
+// Softirq vectors (lower numbers run first)
+#define SOFTIRQ_HI          0 // High priority tasklets
+#define SOFTIRQ_TIMER       1 // Expired timers
+#define SOFTIRQ_TASKLET     2 // Tasklets
+#define SOFTIRQ_VECTORS     32 // One bit each in cpu_t.softirq_pending
+#define SOFTIRQ_MAX_RESTART 10 // Rounds of do_softirq() before the rest is left to the kernel worker
+
+#define TASKLET_SCHED       0x1 // Queued on a processor
+#define TASKLET_RUN         0x2 // Running (on any processor)
+
+typedef void (*softirq_handler_t)();
+typedef void (*deferred_func_t)(void *data);
+
+// Tasklet: a function run once, soon, in softirq context, after being scheduled (from interrupt handlers, usually). The
+// same tasklet never runs on two processors at once.
+typedef struct __tasklet_t {
+    struct __tasklet_t *next; // Next tasklet queued on the same processor
+    deferred_func_t func;
+    void *data;
+    volatile uint32_t state; // TASKLET_* flags
+} tasklet_t;
+
+// Work item: a function run by the kernel worker (the idle loop of any processor, one at a time), with interrupts enabled
+// and outside of any interrupt handler, so it may take long
+typedef struct __work_t {
+    struct __work_t *next; // Next item in the queue
+    deferred_func_t func;
+    void *data;
+    uint8_t queued; // Set while in the queue (queueing it again does nothing)
+} work_t;
+
+#define TASKLET_INIT(func, data) { NULL, func, data, 0 }
+#define WORK_INIT(func, data) { NULL, func, data, 0 }
+
+/* Install the tasklet softirqs.
+ */
+void softirq_init();
+
+/* Set the handler of a softirq vector.
+ * @param nr            Vector (SOFTIRQ_*).
+ * @param handler       Handler (runs with interrupts enabled).
+ */
+void open_softirq(uint32_t nr, softirq_handler_t handler);
+
+/* Mark a softirq as pending on this processor (it runs when the current interrupt handler returns, or in the kernel
+ * worker).
+ * @param nr            Vector (SOFTIRQ_*).
+ */
+void raise_softirq(uint32_t nr);
+
+/* Run the pending softirqs of this processor, with interrupts enabled (does nothing when called from a softirq).
+ */
+void do_softirq();
+
+/* Check whether this processor has pending softirqs.
+ * @return              Nonzero if do_softirq() has something to do.
+ */
+uint8_t softirq_pending();
+
+/* Schedule a tasklet on this processor (does nothing if it is already scheduled).
+ * @param t             Tasklet.
+ */
+void tasklet_schedule(tasklet_t *t);
+
+/* Schedule a tasklet on this processor, ahead of the other softirqs (does nothing if it is already scheduled).
+ * @param t             Tasklet.
+ */
+void tasklet_hi_schedule(tasklet_t *t);
+
+/* Queue a work item for the kernel worker (does nothing if it is already queued).
+ * @param work          Work item.
+ */
+void work_queue(work_t *work);
+
+/* Check whether the kernel worker has something to do.
+ * @return              Nonzero if work items are queued, and no processor is running them already.
+ */
+uint8_t work_pending();
+
+/* Run the queued work items, in order (the kernel worker: the idle loop of any processor, one at a time).
+ */
+void work_run();
+
+#endif
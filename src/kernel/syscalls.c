@@ -0,0 +1,83 @@
+// @desc     System calls
+// @author   Davide Della Giustina
+// @date     19/10/2026
+
+#include "syscalls.h"
+
+// Private functions
+
+static void syscall_handler(registers_t *r);
+static int sys_write(int fd, const char *buf, uint32_t count);
+static int sys_brk(uint32_t addr);
+static uint32_t sys_sbrk(int incr);
+
+// Public functions
+
+/* Register the system call handler.
+ */
+void syscalls_init() {
+    register_interrupt_handler(SYSCALL_INT, syscall_handler);
+}
+
+// Private functions
+
+/* Dispatch a system call (number in eax, arguments in ebx, ecx, edx, result in eax).
+ * @param r             Registers.
+ */
+static void syscall_handler(registers_t *r) {
+    switch (r->eax) {
+        case SYS_WRITE:
+            r->eax = (uint32_t)sys_write((int)r->ebx, (const char *)r->ecx, r->edx);
+            break;
+        case SYS_BRK:
+            r->eax = (uint32_t)sys_brk(r->ebx);
+            break;
+        case SYS_SBRK:
+            r->eax = sys_sbrk((int)r->ebx);
+            break;
+        default:
+            r->eax = (uint32_t)-1;
+            break;
+    }
+}
+
+/* Write to the console.
+ * @param fd            File descriptor (stdout or stderr).
+ * @param buf           Data to write (in user space).
+ * @param count         Number of bytes.
+ * @return              Number of bytes written, -1 on error.
+ */
+static int sys_write(int fd, const char *buf, uint32_t count) {
+    if ((fd != STDOUT_FILENO && fd != STDERR_FILENO) || (uint32_t)buf + count < (uint32_t)buf || (uint32_t)buf + count > KERNEL_VIRT_BASE) return -1;
+    char chunk[64];
+    uint32_t done = 0;
+    while (done < count) { // kprint() wants NUL-terminated strings
+        uint32_t n = (count - done < sizeof(chunk) - 1)? count - done : sizeof(chunk) - 1;
+        uint32_t i;
+        for (i = 0; i < n; ++i) chunk[i] = buf[done + i];
+        chunk[n] = 0;
+        kprint(chunk);
+        done += n;
+    }
+    return (int)count;
+}
+
+/* Set the program break of the current process.
+ * @param addr          New program break.
+ * @return              0 on success, -1 on error.
+ */
+static int sys_brk(uint32_t addr) {
+    pcb_t *process = this_cpu()->current_process;
+    if (process == NULL) return -1;
+    return (process_sbrk(process, (int)(addr - process->brk)) == (void *)-1)? -1 : 0;
+}
+
+/* Move the program break of the current process.
+ * @param incr          Number of bytes to add to the heap.
+ * @return              Previous program break, -1 on error.
+ */
+static uint32_t sys_sbrk(int incr) {
+    pcb_t *process = this_cpu()->current_process;
+    if (process == NULL) return (uint32_t)-1;
+    return (uint32_t)process_sbrk(process, incr);
+}
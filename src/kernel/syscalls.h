@@ -0,0 +1,18 @@
+// @desc     System calls header
+// @author   Davide Della Giustina
+// @date     19/10/2026
+
+#ifndef SYSCALLS_H
+#define SYSCALLS_H
+
+#include <stdint.h>
+#include "../cpu/isr.h"
+#include "../drivers/vga.h"
+#include "../libc/unistd.h"
+#include "processes.h"
+
+/* Register the system call handler.
+ */
+void syscalls_init();
+
+#endif
@@ -0,0 +1,226 @@
+// @desc     Kernel timers (hierarchical timing wheel)
+// @author   Davide Della Giustina
+// @date     19/10/2026
+
+#include "timers.h"
+#include "../cpu/smp.h"
+#include "processes.h"
+
+// A timer expiring within WHEEL_ROOT_SIZE ticks of the wheel clock hashes into the root level, one slot per tick; a
+// later one into a slot of an upper level, where each slot spans a whole turn of the level below. So adding and
+// stopping a timer take O(1), whatever the number of pending ones. Each time the root level wraps, the next slot of
+// the first upper level is cascaded into it (and so on up, when that level wraps too): a timer moves at most
+// WHEEL_LEVELS times before it expires. Expired timers run in batch, a root slot per tick, in the timer softirq.
+
+// Sleeping outside of any process
+typedef struct __msleep_t {
+    volatile uint8_t done;
+    cpu_t *cpu; // Processor waiting
+} msleep_t;
+
+ktimer_t *wheel_root[WHEEL_ROOT_SIZE];
+ktimer_t *wheel_levels[WHEEL_LEVELS][WHEEL_LEVEL_SIZE];
+uint32_t wheel_clock; // Next tick to run the timers of
+uint32_t wheel_count = 0; // Pending timers
+spinlock_t wheel_lock = SPINLOCK_INIT;
+
+// Private functions
+
+static void wheel_insert(ktimer_t *timer);
+static void wheel_unlink(ktimer_t *timer);
+static uint32_t wheel_cascade(uint32_t level);
+static uint8_t wheel_levels_empty();
+static void timers_softirq();
+static void msleep_expired(void *data);
+
+// Public functions
+
+/* Install the timer softirq, and start the wheel at the current tick.
+ */
+void timers_init() {
+    wheel_clock = timer_get_ticks();
+    open_softirq(SOFTIRQ_TIMER, timers_softirq);
+}
+
+/* Start a timer (or restart it, if it is pending).
+ * @param timer         Timer.
+ * @param delay         Ticks from now (the tick in progress counts as the first one).
+ */
+void timer_add(ktimer_t *timer, uint32_t delay) {
+    uint32_t flags = spin_lock_irqsave(&wheel_lock);
+    if (timer->pprev != NULL) wheel_unlink(timer);
+    uint32_t now = timer_get_ticks(), expires = now + delay;
+    if (wheel_count == 0) wheel_clock = now; // The softirq may not have caught up, but there is nothing to catch up on
+    timer->expires = expires;
+    wheel_insert(timer);
+    spin_unlock_irqrestore(&wheel_lock, flags);
+    timer_update(expires); // The device may be programmed for later (or not at all)
+}
+
+/* Stop a timer (it may still be running on another processor when this returns).
+ * @param timer         Timer.
+ * @return              Nonzero if it was pending.
+ */
+uint8_t timer_del(ktimer_t *timer) {
+    uint32_t flags = spin_lock_irqsave(&wheel_lock);
+    uint8_t pending = timer->pprev != NULL;
+    if (pending) wheel_unlink(timer);
+    spin_unlock_irqrestore(&wheel_lock, flags);
+    return pending;
+}
+
+/* Check whether a timer is pending.
+ * @param timer         Timer.
+ * @return              Nonzero if added and not yet expired nor stopped.
+ */
+uint8_t timer_pending(ktimer_t *timer) {
+    return timer->pprev != NULL;
+}
+
+/* Check whether the wheel holds timers (racy, for the timer interrupt to decide whether to raise the softirq).
+ * @return              Nonzero if timers are pending.
+ */
+uint8_t timers_pending() {
+    return wheel_count != 0;
+}
+
+/* Get the tick the timer interrupt is needed by next.
+ * @param expires       Set to the tick (the expiry of the nearest timer, or earlier).
+ * @return              Nonzero if timers are pending (#expires is set only then).
+ */
+uint8_t timers_next(uint32_t *expires) {
+    uint32_t flags = spin_lock_irqsave(&wheel_lock), i;
+    uint8_t pending = wheel_count != 0;
+    if (pending) {
+        for (i = 0; i < WHEEL_ROOT_SIZE && wheel_root[(wheel_clock + i) % WHEEL_ROOT_SIZE] == NULL; ++i);
+        uint32_t wrap = (WHEEL_ROOT_SIZE - wheel_clock % WHEEL_ROOT_SIZE) % WHEEL_ROOT_SIZE; // Next cascade
+        if (i > wrap && !wheel_levels_empty()) i = wrap; // Upper level timers expire after it, but maybe not long after
+        *expires = wheel_clock + i;
+    }
+    spin_unlock_irqrestore(&wheel_lock, flags);
+    return pending;
+}
+
+/* Sleep for some milliseconds (rounded up to whole ticks). A process gives up its processor meanwhile; anything else
+ * (e.g. the kernel worker) halts until then.
+ * @param ms            Milliseconds.
+ */
+void msleep(uint32_t ms) {
+    uint32_t ticks = (ms + MS_PER_TICK - 1) / MS_PER_TICK + 1; // The tick in progress does not count
+    assert(!this_cpu()->in_softirq); // The timer would never run
+    if (this_cpu()->current_process != NULL) {
+        wait_queue_t queue = WAIT_QUEUE_INIT; // Nobody else wakes it up
+        sleep_on(&queue, ticks);
+        return;
+    }
+    msleep_t sleep;
+    ktimer_t timer = KTIMER_INIT(msleep_expired, &sleep);
+    asm volatile("cli");
+    sleep.done = 0;
+    sleep.cpu = this_cpu();
+    timer_add(&timer, ticks);
+    while (!sleep.done) asm volatile("sti; hlt; cli"); // STI takes effect after HLT, so the wakeup is not missed
+    asm volatile("sti");
+}
+
+// Private functions
+
+/* Hash a timer into its slot (with the wheel locked).
+ * @param timer         Timer (not pending).
+ */
+static void wheel_insert(ktimer_t *timer) {
+    uint32_t delta = timer->expires - wheel_clock;
+    ktimer_t **slot;
+    if ((int32_t)delta < 0) slot = &wheel_root[wheel_clock % WHEEL_ROOT_SIZE]; // Already expired: run it next
+    else if (delta < WHEEL_ROOT_SIZE) slot = &wheel_root[timer->expires % WHEEL_ROOT_SIZE];
+    else {
+        uint32_t level = 0, shift = WHEEL_ROOT_BITS;
+        while (level < WHEEL_LEVELS - 1 && delta >= (0x1u << (shift + WHEEL_LEVEL_BITS))) {
+            ++level;
+            shift += WHEEL_LEVEL_BITS;
+        }
+        slot = &wheel_levels[level][(timer->expires >> shift) % WHEEL_LEVEL_SIZE];
+    }
+    timer->next = *slot;
+    if (*slot != NULL) (*slot)->pprev = &timer->next;
+    *slot = timer;
+    timer->pprev = slot;
+    ++wheel_count;
+}
+
+/* Remove a timer from its slot (with the wheel locked).
+ * @param timer         Timer (pending).
+ */
+static void wheel_unlink(ktimer_t *timer) {
+    *timer->pprev = timer->next;
+    if (timer->next != NULL) timer->next->pprev = timer->pprev;
+    timer->next = NULL;
+    timer->pprev = NULL;
+    --wheel_count;
+}
+
+/* Move the timers of the current slot of an upper level down, as the level below wraps (with the wheel locked).
+ * @param level         Upper level.
+ * @return              Index of the slot (0 if this level wraps too, so the next one must be cascaded as well).
+ */
+static uint32_t wheel_cascade(uint32_t level) {
+    uint32_t index = (wheel_clock >> (WHEEL_ROOT_BITS + level * WHEEL_LEVEL_BITS)) % WHEEL_LEVEL_SIZE;
+    ktimer_t *timer = wheel_levels[level][index];
+    wheel_levels[level][index] = NULL;
+    while (timer != NULL) {
+        ktimer_t *next = timer->next;
+        --wheel_count; // Counted again by wheel_insert()
+        wheel_insert(timer);
+        timer = next;
+    }
+    return index;
+}
+
+/* Check whether all the upper levels are empty (with the wheel locked).
+ * @return              Nonzero if all the pending timers are in the root level.
+ */
+static uint8_t wheel_levels_empty() {
+    uint32_t i, j;
+    for (i = 0; i < WHEEL_LEVELS; ++i) {
+        for (j = 0; j < WHEEL_LEVEL_SIZE; ++j) if (wheel_levels[i][j] != NULL) return 0;
+    }
+    return 1;
+}
+
+/* Run the expired timers, catching up tick by tick (the timer softirq).
+ */
+static void timers_softirq() {
+    uint32_t flags = spin_lock_irqsave(&wheel_lock), now = timer_get_ticks();
+    while ((int32_t)(now - wheel_clock) >= 0) {
+        if (wheel_count == 0) { // Nothing to cascade nor to run
+            wheel_clock = now + 1;
+            break;
+        }
+        uint32_t index = wheel_clock % WHEEL_ROOT_SIZE, level;
+        if (index == 0) for (level = 0; level < WHEEL_LEVELS && wheel_cascade(level) == 0; ++level);
+        ktimer_t *expired = wheel_root[index]; // Detached, so timers added meanwhile go to later ticks
+        wheel_root[index] = NULL;
+        if (expired != NULL) expired->pprev = &expired;
+        ++wheel_clock;
+        while (expired != NULL) { // Still stoppable until it runs
+            ktimer_t *timer = expired;
+            deferred_func_t func = timer->func;
+            void *data = timer->data;
+            wheel_unlink(timer);
+            spin_unlock_irqrestore(&wheel_lock, flags); // From here on, the timer may be added again, or freed
+            func(data);
+            flags = spin_lock_irqsave(&wheel_lock);
+        }
+    }
+    spin_unlock_irqrestore(&wheel_lock, flags);
+}
+
+/* End the sleep of msleep() (outside of any process).
+ * @param data          Sleep.
+ */
+static void msleep_expired(void *data) {
+    msleep_t *sleep = (msleep_t *)data;
+    cpu_t *cpu = sleep->cpu; // The sleep is gone as soon as it is done
+    sleep->done = 1;
+    smp_kick(cpu); // Halted on another processor, maybe
+}
@@ -0,0 +1,72 @@
+// @desc     Kernel timers (hierarchical timing wheel) header
+// @author   Davide Della Giustina
+// @date     19/10/2026
+
+#ifndef TIMERS_H
+#define TIMERS_H
+
+#include <stdint.h>
+#include "../cpu/spinlock.h"
+#include "../cpu/timer.h"
+#include "../libc/assert.h"
+#include "softirq.h"
+
+#define WHEEL_ROOT_BITS     8 // Slots of the first level, one tick each
+#define WHEEL_LEVEL_BITS    6 // Slots of each further level, 64 times as long as those of the level below
+#define WHEEL_ROOT_SIZE     (0x1 << WHEEL_ROOT_BITS)
+#define WHEEL_LEVEL_SIZE    (0x1 << WHEEL_LEVEL_BITS)
+#define WHEEL_LEVELS        4 // Levels above the first one (8 + 4 * 6 bits cover any 32-bit delay)
+#define MS_PER_TICK         (1000 / TIMER_HZ)
+
+// Kernel timer: a function run once, in softirq context (on the boot processor), on the first tick at or after its
+// expiry
+typedef struct __ktimer_t {
+    struct __ktimer_t *next; // Next timer in the same slot
+    struct __ktimer_t **pprev; // Link pointing to this timer (NULL while not pending), to unlink it in O(1)
+    uint32_t expires; // Tick
+    deferred_func_t func;
+    void *data;
+} ktimer_t;
+
+#define KTIMER_INIT(func, data) { NULL, NULL, 0, func, data }
+
+/* Install the timer softirq, and start the wheel at the current tick.
+ */
+void timers_init();
+
+/* Start a timer (or restart it, if it is pending).
+ * @param timer         Timer.
+ * @param delay         Ticks from now (the tick in progress counts as the first one).
+ */
+void timer_add(ktimer_t *timer, uint32_t delay);
+
+/* Stop a timer (it may still be running on another processor when this returns).
+ * @param timer         Timer.
+ * @return              Nonzero if it was pending.
+ */
+uint8_t timer_del(ktimer_t *timer);
+
+/* Check whether a timer is pending.
+ * @param timer         Timer.
+ * @return              Nonzero if added and not yet expired nor stopped.
+ */
+uint8_t timer_pending(ktimer_t *timer);
+
+/* Check whether the wheel holds timers (racy, for the timer interrupt to decide whether to raise the softirq).
+ * @return              Nonzero if timers are pending.
+ */
+uint8_t timers_pending();
+
+/* Get the tick the timer interrupt is needed by next.
+ * @param expires       Set to the tick (the expiry of the nearest timer, or earlier).
+ * @return              Nonzero if timers are pending (#expires is set only then).
+ */
+uint8_t timers_next(uint32_t *expires);
+
+/* Sleep for some milliseconds (rounded up to whole ticks). A process gives up its processor meanwhile; anything else
+ * (e.g. the kernel worker) halts until then.
+ * @param ms            Milliseconds.
+ */
+void msleep(uint32_t ms);
+
+#endif
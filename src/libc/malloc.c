@@ -0,0 +1,283 @@
+// @desc     User-space memory allocator
+// @author   Davide Della Giustina
+// @date     19/10/2026
+
+#include "malloc.h"
+
+// Small requests are rounded up to a size class. Objects of a class are carved from spans of whole pages and kept in a
+// central free list; a per-class cache in front of it serves most calls with one array access. Pages come from the
+// program break, and a page map tells the class of every page, so that objects need no header.
+
+static const uint32_t class_size[MALLOC_CLASSES] = { 16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024, 1536, 2048 };
+static const uint8_t class_pages[MALLOC_CLASSES] = { 1, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 4, 4, 4 }; // Pages in a span (at most 6% wasted)
+
+static uint8_t size_class[MALLOC_SMALL_MAX / 16 + 1]; // Size class of every request size (in steps of 16 bytes)
+static malloc_cache_t class_cache[MALLOC_CLASSES];
+static void *central[MALLOC_CLASSES]; // Free objects not in a cache (linked through their first word)
+static uint8_t *page_map[256]; // Size class of every page (one leaf page for each 16MB, allocated on demand)
+static malloc_run_t *free_runs = NULL; // Free pages, ordered by address
+static uint32_t heap_end = 0; // Current program break, 0 if not initialized
+
+// Private functions
+
+static uint8_t malloc_init();
+static void *get_pages(uint32_t npages);
+static void put_pages(void *p, uint32_t npages);
+static uint8_t page_class(void *p);
+static uint8_t set_page_class(void *p, uint32_t npages, uint8_t c);
+static uint8_t new_span(uint32_t c);
+static void *refill(uint32_t c);
+static void flush(uint32_t c);
+static void *malloc_large(size_t size);
+static uint32_t usable_size(void *p);
+
+// Public functions
+
+/* Allocate memory.
+ * @param size          Size of the area.
+ * @return              Pointer to the area (16-byte aligned), NULL if out of memory.
+ */
+void *malloc(size_t size) {
+    if (heap_end == 0 && !malloc_init()) return NULL;
+    if (size <= MALLOC_SMALL_MAX) {
+        uint32_t c = size_class[(size + 15) >> 4];
+        malloc_cache_t *cache = &class_cache[c];
+        if (cache->count) return cache->objects[--cache->count]; // Fast path
+        return refill(c);
+    }
+    return malloc_large(size);
+}
+
+/* Allocate memory initialized to 0.
+ * @param n             Number of elements.
+ * @param size          Size of an element.
+ * @return              Pointer to the area, NULL if out of memory.
+ */
+void *calloc(size_t n, size_t size) {
+    if (size && n > (size_t)-1 / size) return NULL; // Overflow
+    void *p = malloc(n * size);
+    if (p) memset(p, 0, n * size);
+    return p;
+}
+
+/* Resize an allocated area.
+ * @param p             Pointer to the area (NULL to allocate a new one).
+ * @param size          New size (0 to free the area).
+ * @return              Pointer to the resized area (may differ from #p), NULL if out of memory.
+ */
+void *realloc(void *p, size_t size) {
+    if (p == NULL) return malloc(size);
+    if (size == 0) {
+        free(p);
+        return NULL;
+    }
+    uint32_t old_size = usable_size(p);
+    if (old_size == 0) return NULL; // Not allocated here
+    uint8_t c = page_class(p);
+    if (size <= old_size) { // Stay in place, unless a much smaller block would do
+        if ((c < MALLOC_CLASSES)? size_class[(size + 15) >> 4] == c : size > old_size / 2) return p;
+    }
+    void *q = malloc(size);
+    if (q == NULL) return NULL;
+    memcpy(q, p, (size < old_size)? size : old_size);
+    free(p);
+    return q;
+}
+
+/* Free an allocated area.
+ * @param p             Pointer to the area (may be NULL).
+ */
+void free(void *p) {
+    if (p == NULL) return;
+    uint8_t c = page_class(p);
+    if (c < MALLOC_CLASSES) {
+        malloc_cache_t *cache = &class_cache[c];
+        if (cache->count == MALLOC_CACHE_SIZE) flush(c);
+        cache->objects[cache->count++] = p; // Fast path
+    } else if (c == MALLOC_LARGE && ((uint32_t)p & (MALLOC_PAGE_SIZE - 1)) == MALLOC_LARGE_HEADER) {
+        uint8_t *base = (uint8_t *)p - MALLOC_LARGE_HEADER;
+        set_page_class(base, 1, MALLOC_NONE);
+        put_pages(base, *(uint32_t *)base);
+    } // Anything else was not allocated here
+}
+
+// Private functions
+
+/* Build the size class table and align the program break to a page.
+ * @return              Zero if the program break cannot be moved.
+ */
+static uint8_t malloc_init() {
+    uint32_t s, c = 0;
+    for (s = 0; s <= MALLOC_SMALL_MAX / 16; ++s) {
+        while (class_size[c] < s * 16) ++c;
+        size_class[s] = c;
+    }
+    uint32_t brk = (uint32_t)sbrk(0);
+    if (brk == (uint32_t)-1) return 0;
+    if (brk & (MALLOC_PAGE_SIZE - 1)) {
+        if (sbrk(MALLOC_PAGE_SIZE - (brk & (MALLOC_PAGE_SIZE - 1))) == (void *)-1) return 0;
+        brk = (brk + MALLOC_PAGE_SIZE - 1) & ~(MALLOC_PAGE_SIZE - 1);
+    }
+    heap_end = brk;
+    return 1;
+}
+
+/* Get some free pages, from the free runs or by moving the program break.
+ * @param npages        Number of pages.
+ * @return              Pointer to the first page, NULL if out of memory.
+ */
+static void *get_pages(uint32_t npages) {
+    malloc_run_t **link, *run;
+    for (link = &free_runs; (run = *link) != NULL; link = &run->next) { // First fit
+        if (run->npages < npages) continue;
+        if (run->npages == npages) {
+            *link = run->next;
+            return run;
+        }
+        run->npages -= npages; // Take the tail of the run
+        return (uint8_t *)run + run->npages * MALLOC_PAGE_SIZE;
+    }
+    if (npages >= 0x80000 || sbrk(npages * MALLOC_PAGE_SIZE) == (void *)-1) return NULL;
+    void *p = (void *)heap_end;
+    heap_end += npages * MALLOC_PAGE_SIZE;
+    return p;
+}
+
+/* Give back some pages, merging them with adjacent free runs and shrinking the heap if they are at its end.
+ * @param p             Pointer to the first page.
+ * @param npages        Number of pages.
+ */
+static void put_pages(void *p, uint32_t npages) {
+    malloc_run_t *run = (malloc_run_t *)p, *prev = NULL, *next = free_runs;
+    while (next != NULL && next < run) {
+        prev = next;
+        next = next->next;
+    }
+    run->npages = npages;
+    run->next = next;
+    if (next && (uint8_t *)run + npages * MALLOC_PAGE_SIZE == (uint8_t *)next) { // Merge with the next run
+        run->npages += next->npages;
+        run->next = next->next;
+    }
+    if (prev && (uint8_t *)prev + prev->npages * MALLOC_PAGE_SIZE == (uint8_t *)run) { // Merge with the previous run
+        prev->npages += run->npages;
+        prev->next = run->next;
+        run = prev;
+    } else if (prev) prev->next = run;
+    else free_runs = run;
+    if (run->next == NULL && (uint32_t)run + run->npages * MALLOC_PAGE_SIZE == heap_end) { // Last run: shrink the heap
+        if (sbrk(-(int)(run->npages * MALLOC_PAGE_SIZE)) == (void *)-1) return;
+        heap_end = (uint32_t)run;
+        malloc_run_t **link = &free_runs;
+        while (*link != run) link = &(*link)->next;
+        *link = NULL;
+    }
+}
+
+/* Look up the size class of the page an address belongs to.
+ * @param p             Address.
+ * @return              Size class, MALLOC_LARGE or MALLOC_NONE.
+ */
+static uint8_t page_class(void *p) {
+    uint8_t *leaf = page_map[(uint32_t)p >> 24];
+    return (leaf)? leaf[((uint32_t)p >> 12) & 0xfff] : MALLOC_NONE;
+}
+
+/* Record the size class of some pages.
+ * @param p             Pointer to the first page.
+ * @param npages        Number of pages.
+ * @param c             Size class, MALLOC_LARGE or MALLOC_NONE.
+ * @return              Zero if a leaf of the page map could not be allocated.
+ */
+static uint8_t set_page_class(void *p, uint32_t npages, uint8_t c) {
+    uint32_t addr = (uint32_t)p, i;
+    for (i = 0; i < npages; ++i, addr += MALLOC_PAGE_SIZE) {
+        uint8_t *leaf = page_map[addr >> 24];
+        if (leaf == NULL) {
+            if ((leaf = (uint8_t *)get_pages(1)) == NULL) return 0;
+            memset(leaf, MALLOC_NONE, MALLOC_PAGE_SIZE);
+            page_map[addr >> 24] = leaf;
+        }
+        leaf[(addr >> 12) & 0xfff] = c;
+    }
+    return 1;
+}
+
+/* Carve a new span into objects of a size class, and add them to its central free list.
+ * @param c             Size class.
+ * @return              Zero if out of memory.
+ */
+static uint8_t new_span(uint32_t c) {
+    uint32_t npages = class_pages[c], size = class_size[c];
+    uint8_t *span = (uint8_t *)get_pages(npages);
+    if (span == NULL) return 0;
+    if (!set_page_class(span, npages, c)) {
+        put_pages(span, npages);
+        return 0;
+    }
+    uint32_t i = (npages * MALLOC_PAGE_SIZE) / size;
+    while (i-- > 0) { // Link backwards, so that objects are handed out in address order
+        void **obj = (void **)(span + i * size);
+        *obj = central[c];
+        central[c] = obj;
+    }
+    return 1;
+}
+
+/* Move a batch of objects from a central free list into its (empty) cache, then take one.
+ * @param c             Size class.
+ * @return              Pointer to an object, NULL if out of memory.
+ */
+static void *refill(uint32_t c) {
+    malloc_cache_t *cache = &class_cache[c];
+    while (cache->count < MALLOC_BATCH) {
+        if (central[c] == NULL && !new_span(c)) break;
+        void **obj = (void **)central[c];
+        central[c] = *obj;
+        cache->objects[cache->count++] = obj;
+    }
+    return (cache->count)? cache->objects[--cache->count] : NULL;
+}
+
+/* Move the oldest batch of objects from a (full) cache back to its central free list.
+ * @param c             Size class.
+ */
+static void flush(uint32_t c) {
+    malloc_cache_t *cache = &class_cache[c];
+    uint32_t i;
+    for (i = 0; i < MALLOC_BATCH; ++i) {
+        void **obj = (void **)cache->objects[i];
+        *obj = central[c];
+        central[c] = obj;
+    }
+    for (i = MALLOC_BATCH; i < cache->count; ++i) cache->objects[i - MALLOC_BATCH] = cache->objects[i];
+    cache->count -= MALLOC_BATCH;
+}
+
+/* Allocate whole pages for a large request.
+ * @param size          Size of the area.
+ * @return              Pointer to the area, NULL if out of memory.
+ */
+static void *malloc_large(size_t size) {
+    if (size > 0x7fff0000) return NULL;
+    uint32_t npages = (size + MALLOC_LARGE_HEADER + MALLOC_PAGE_SIZE - 1) / MALLOC_PAGE_SIZE;
+    uint8_t *base = (uint8_t *)get_pages(npages);
+    if (base == NULL) return NULL;
+    if (!set_page_class(base, 1, MALLOC_LARGE)) { // Only the first page is looked up
+        put_pages(base, npages);
+        return NULL;
+    }
+    *(uint32_t *)base = npages;
+    return base + MALLOC_LARGE_HEADER;
+}
+
+/* Get the usable size of an allocated area.
+ * @param p             Pointer to the area.
+ * @return              Usable size (0 if #p was not allocated here).
+ */
+static uint32_t usable_size(void *p) {
+    uint8_t c = page_class(p);
+    if (c < MALLOC_CLASSES) return class_size[c];
+    if (c == MALLOC_LARGE) return *(uint32_t *)((uint8_t *)p - MALLOC_LARGE_HEADER) * MALLOC_PAGE_SIZE - MALLOC_LARGE_HEADER;
+    return 0;
+}
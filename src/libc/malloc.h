@@ -0,0 +1,59 @@
+// @desc     User-space memory allocator header
+// @author   Davide Della Giustina
+// @date     19/10/2026
+
+#ifndef MALLOC_H
+#define MALLOC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "mem.h"
+#include "unistd.h"
+
+#define MALLOC_PAGE_SIZE    0x1000
+#define MALLOC_CLASSES      14 // Number of size classes
+#define MALLOC_SMALL_MAX    2048 // Larger requests get whole pages of their own
+#define MALLOC_CACHE_SIZE   32 // Objects kept by the cache of every size class
+#define MALLOC_BATCH        16 // Objects moved at once between a cache and its central free list
+#define MALLOC_LARGE        0xfe // Page map entry for the first page of a large allocation
+#define MALLOC_NONE         0xff // Page map entry for pages not owned by the allocator
+#define MALLOC_LARGE_HEADER 16 // Header before large allocations (keeps them 16-byte aligned)
+
+// Cache of free objects of a size class (the fast path: no locking, no list walking, no system calls)
+typedef struct {
+    void *objects[MALLOC_CACHE_SIZE];
+    uint32_t count;
+} malloc_cache_t;
+
+// Run of free pages
+typedef struct __malloc_run_t {
+    struct __malloc_run_t *next; // Next run (by address)
+    uint32_t npages;
+} malloc_run_t;
+
+/* Allocate memory.
+ * @param size          Size of the area.
+ * @return              Pointer to the area (16-byte aligned), NULL if out of memory.
+ */
+void *malloc(size_t size);
+
+/* Allocate memory initialized to 0.
+ * @param n             Number of elements.
+ * @param size          Size of an element.
+ * @return              Pointer to the area, NULL if out of memory.
+ */
+void *calloc(size_t n, size_t size);
+
+/* Resize an allocated area.
+ * @param p             Pointer to the area (NULL to allocate a new one).
+ * @param size          New size (0 to free the area).
+ * @return              Pointer to the resized area (may differ from #p), NULL if out of memory.
+ */
+void *realloc(void *p, size_t size);
+
+/* Free an allocated area.
+ * @param p             Pointer to the area (may be NULL).
+ */
+void free(void *p);
+
+#endif
@@ -0,0 +1,32 @@
+// @desc     64-bit arithmetic
+// @author   Davide Della Giustina
+// @date     19/10/2026
+
+#include "math.h"
+
+// Public functions
+
+/* Divide a 64-bit number by a 32-bit one, without the compiler runtime (32-bit targets have no 64-bit division).
+ * @param n             Dividend, replaced by the quotient.
+ * @param d             Divisor.
+ * @return              Remainder.
+ */
+uint32_t div_u64(uint64_t *n, uint32_t d) {
+    uint32_t high = (uint32_t)(*n >> 32), low = (uint32_t)*n, rem = high % d;
+    high /= d;
+    asm("divl %4" : "=a" (low), "=d" (rem) : "0" (low), "1" (rem), "rm" (d)); // rem < d, so the quotient fits in 32 bits
+    *n = ((uint64_t)high << 32) | low;
+    return rem;
+}
+
+/* Multiply a 64-bit number by a 32-bit one and shift the product right, without losing its high bits.
+ * @param a             64-bit factor.
+ * @param mul           32-bit factor.
+ * @param shift         Right shift (at most 32).
+ * @return              (a * mul) >> shift, truncated to 64 bits.
+ */
+uint64_t mul_u64_u32_shr(uint64_t a, uint32_t mul, uint32_t shift) {
+    uint64_t low = (uint64_t)(uint32_t)a * mul, high = (a >> 32) * mul; // The 96-bit product is high << 32 | low
+    if (shift == 0) return (high << 32) + low;
+    return (high << (32 - shift)) + (low >> shift);
+}
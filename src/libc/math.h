@@ -0,0 +1,25 @@
+// @desc     64-bit arithmetic header
+// @author   Davide Della Giustina
+// @date     19/10/2026
+
+#ifndef MATH_H
+#define MATH_H
+
+#include <stdint.h>
+
+/* Divide a 64-bit number by a 32-bit one, without the compiler runtime (32-bit targets have no 64-bit division).
+ * @param n             Dividend, replaced by the quotient.
+ * @param d             Divisor.
+ * @return              Remainder.
+ */
+uint32_t div_u64(uint64_t *n, uint32_t d);
+
+/* Multiply a 64-bit number by a 32-bit one and shift the product right, without losing its high bits.
+ * @param a             64-bit factor.
+ * @param mul           32-bit factor.
+ * @param shift         Right shift (at most 32).
+ * @return              (a * mul) >> shift, truncated to 64 bits.
+ */
+uint64_t mul_u64_u32_shr(uint64_t a, uint32_t mul, uint32_t shift);
+
+#endif
@@ -4,25 +4,169 @@
 
 #include "mem.h"
 
-/* Copy a portion of memory from a source to a destination.
- * @param source        Source address.
+typedef uint32_t __attribute__((may_alias)) mem_word_t; // Word that may alias any other type
+
+uint8_t mem_sse = 0; // Set if SSE2 can be used without trapping (managed by fpu.c)
+
+// Private functions
+
+static void copy_sse(void *dst, const void *src, size_t blocks);
+static void fill_sse(void *dst, uint32_t pattern, size_t blocks);
+
+// Public functions
+
+/* Copy a portion of memory from a source to a destination (the two must not overlap).
  * @param destination   Destination address.
+ * @param source        Source address.
  * @param nbytes        Number of bytes to copy.
+ * @return              Destination address.
  */
-void memcpy(void *source, void *destination, int nbytes) {
-    uint8_t *src = (uint8_t *)source, *dst = (uint8_t *)destination;
-    int i;
-    for (i = 0; i < nbytes; ++i) {
-        *(dst + i) = *(src + i);
+void *memcpy(void *destination, const void *source, size_t nbytes) {
+    uint8_t *dst = (uint8_t *)destination;
+    const uint8_t *src = (const uint8_t *)source;
+    if (nbytes >= MEM_SSE_THRESHOLD && mem_sse && (nbytes < MEM_REP_THRESHOLD || (((uintptr_t)dst ^ (uintptr_t)src) & 0x3))) {
+        size_t head = (-(uintptr_t)dst) & 0xf; // Align the destination to 16 bytes
+        nbytes -= head;
+        asm volatile("rep movsb" : "+D" (dst), "+S" (src), "+c" (head) : : "memory");
+        copy_sse(dst, src, nbytes >> 6);
+        dst += nbytes & ~0x3f;
+        src += nbytes & ~0x3f;
+        nbytes &= 0x3f;
+    }
+    if (nbytes >= 16) {
+        size_t head = (-(uintptr_t)dst) & 0x3, words; // Align the destination to 4 bytes
+        nbytes -= head;
+        words = nbytes >> 2;
+        asm volatile("rep movsb" : "+D" (dst), "+S" (src), "+c" (head) : : "memory");
+        asm volatile("rep movsl" : "+D" (dst), "+S" (src), "+c" (words) : : "memory");
+        nbytes &= 0x3;
     }
+    asm volatile("rep movsb" : "+D" (dst), "+S" (src), "+c" (nbytes) : : "memory");
+    return destination;
+}
+
+/* Copy a portion of memory from a source to a destination (the two may overlap).
+ * @param destination   Destination address.
+ * @param source        Source address.
+ * @param nbytes        Number of bytes to copy.
+ * @return              Destination address.
+ */
+void *memmove(void *destination, const void *source, size_t nbytes) {
+    if ((uintptr_t)destination - (uintptr_t)source >= nbytes) return memcpy(destination, source, nbytes); // A forward copy never overwrites bytes still to be read
+    uint8_t *dst = (uint8_t *)destination + nbytes - 1;
+    const uint8_t *src = (const uint8_t *)source + nbytes - 1;
+    size_t tail = nbytes & 0x3, words = nbytes >> 2;
+    asm volatile("std\n\t"
+                 "rep movsb\n\t" // Copy backwards: first the odd bytes at the end...
+                 "sub $3, %0\n\t"
+                 "sub $3, %1\n\t"
+                 "mov %3, %2\n\t"
+                 "rep movsl\n\t" // ... then whole words
+                 "cld"
+                 : "+D" (dst), "+S" (src), "+c" (tail) : "r" (words) : "memory", "cc");
+    return destination;
 }
 
 /* Set a certain portion of memory to a value.
  * @param destination   Base memory address.
  * @param val           Value to set.
  * @param len           Length of memory portion (in bytes).
+ * @return              Base memory address.
  */
-void memset(void *destination, uint8_t val, size_t len) {
-    uint8_t *temp = (uint8_t *)destination;
-    for (; len != 0; --len) *temp++ = val;
-}
\ No newline at end of file
+void *memset(void *destination, uint8_t val, size_t len) {
+    uint8_t *dst = (uint8_t *)destination;
+    uint32_t pattern = val * 0x01010101;
+    if (len >= MEM_SSE_THRESHOLD && len < MEM_REP_THRESHOLD && mem_sse) {
+        size_t head = (-(uintptr_t)dst) & 0xf; // Align the destination to 16 bytes
+        len -= head;
+        asm volatile("rep stosb" : "+D" (dst), "+c" (head) : "a" (pattern) : "memory");
+        fill_sse(dst, pattern, len >> 6);
+        dst += len & ~0x3f;
+        len &= 0x3f;
+    }
+    if (len >= 16) {
+        size_t head = (-(uintptr_t)dst) & 0x3, words; // Align the destination to 4 bytes
+        len -= head;
+        words = len >> 2;
+        asm volatile("rep stosb" : "+D" (dst), "+c" (head) : "a" (pattern) : "memory");
+        asm volatile("rep stosl" : "+D" (dst), "+c" (words) : "a" (pattern) : "memory");
+        len &= 0x3;
+    }
+    asm volatile("rep stosb" : "+D" (dst), "+c" (len) : "a" (pattern) : "memory");
+    return destination;
+}
+
+/* Compare two portions of memory.
+ * @param a             First portion.
+ * @param b             Second portion.
+ * @param nbytes        Number of bytes to compare.
+ * @return              Zero if equal, otherwise the difference between the first two bytes that differ.
+ */
+int memcmp(const void *a, const void *b, size_t nbytes) {
+    const uint8_t *p = (const uint8_t *)a, *q = (const uint8_t *)b;
+    while (nbytes >= 4 && *(const mem_word_t *)p == *(const mem_word_t *)q) { // Skip equal words
+        p += 4;
+        q += 4;
+        nbytes -= 4;
+    }
+    for (; nbytes > 0; --nbytes, ++p, ++q) {
+        if (*p != *q) return (int)*p - (int)*q;
+    }
+    return 0;
+}
+
+// Private functions
+
+/* Copy 64-byte blocks with SSE2 (the registers used are preserved, so that interrupt handlers can copy too).
+ * @param dst           Destination address (16-byte aligned).
+ * @param src           Source address.
+ * @param blocks        Number of blocks (nonzero).
+ */
+static void copy_sse(void *dst, const void *src, size_t blocks) {
+    uint8_t saved[64];
+    asm volatile("movdqu %%xmm0, 0(%3)\n\t"
+                 "movdqu %%xmm1, 16(%3)\n\t"
+                 "movdqu %%xmm2, 32(%3)\n\t"
+                 "movdqu %%xmm3, 48(%3)\n\t"
+                 "1:\n\t"
+                 "movdqu 0(%1), %%xmm0\n\t"
+                 "movdqu 16(%1), %%xmm1\n\t"
+                 "movdqu 32(%1), %%xmm2\n\t"
+                 "movdqu 48(%1), %%xmm3\n\t"
+                 "movdqa %%xmm0, 0(%0)\n\t"
+                 "movdqa %%xmm1, 16(%0)\n\t"
+                 "movdqa %%xmm2, 32(%0)\n\t"
+                 "movdqa %%xmm3, 48(%0)\n\t"
+                 "add $64, %1\n\t"
+                 "add $64, %0\n\t"
+                 "dec %2\n\t"
+                 "jnz 1b\n\t"
+                 "movdqu 0(%3), %%xmm0\n\t"
+                 "movdqu 16(%3), %%xmm1\n\t"
+                 "movdqu 32(%3), %%xmm2\n\t"
+                 "movdqu 48(%3), %%xmm3"
+                 : "+r" (dst), "+r" (src), "+r" (blocks) : "r" (saved) : "memory", "cc");
+}
+
+/* Fill 64-byte blocks with SSE2 (the register used is preserved).
+ * @param dst           Destination address (16-byte aligned).
+ * @param pattern       Value to store, repeated in every word.
+ * @param blocks        Number of blocks.
+ */
+static void fill_sse(void *dst, uint32_t pattern, size_t blocks) {
+    if (blocks == 0) return;
+    uint8_t saved[16];
+    asm volatile("movdqu %%xmm0, (%3)\n\t"
+                 "movd %2, %%xmm0\n\t"
+                 "pshufd $0, %%xmm0, %%xmm0\n\t"
+                 "1:\n\t"
+                 "movdqa %%xmm0, 0(%0)\n\t"
+                 "movdqa %%xmm0, 16(%0)\n\t"
+                 "movdqa %%xmm0, 32(%0)\n\t"
+                 "movdqa %%xmm0, 48(%0)\n\t"
+                 "add $64, %0\n\t"
+                 "dec %1\n\t"
+                 "jnz 1b\n\t"
+                 "movdqu (%3), %%xmm0"
+                 : "+r" (dst), "+r" (blocks) : "r" (pattern), "r" (saved) : "memory", "cc");
+}
@@ -8,20 +8,41 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#define MEM_SSE_THRESHOLD   256 // Shorter areas are not worth saving and restoring SSE registers
+#define MEM_REP_THRESHOLD   2048 // From here on, string instructions beat SSE (unless source and destination are misaligned)
+
 typedef uint32_t physaddr_t; // Typedef for physical addresses (i.e. 32bit unsigned integers)
 
-/* Copy a portion of memory from a source to a destination.
+/* Copy a portion of memory from a source to a destination (the two must not overlap).
+ * @param destination   Destination address.
  * @param source        Source address.
+ * @param nbytes        Number of bytes to copy.
+ * @return              Destination address.
+ */
+void *memcpy(void *destination, const void *source, size_t nbytes);
+
+/* Copy a portion of memory from a source to a destination (the two may overlap).
  * @param destination   Destination address.
+ * @param source        Source address.
  * @param nbytes        Number of bytes to copy.
+ * @return              Destination address.
  */
-void memcpy(void *source, void *destination, int nbytes);
+void *memmove(void *destination, const void *source, size_t nbytes);
 
 /* Set a certain portion of memory to a value.
  * @param destination   Base memory address.
  * @param val           Value to set.
  * @param len           Length of memory portion (in bytes).
+ * @return              Base memory address.
+ */
+void *memset(void *destination, uint8_t val, size_t len);
+
+/* Compare two portions of memory.
+ * @param a             First portion.
+ * @param b             Second portion.
+ * @param nbytes        Number of bytes to compare.
+ * @return              Zero if equal, otherwise the difference between the first two bytes that differ.
  */
-void memset(void *destination, uint8_t val, size_t len);
+int memcmp(const void *a, const void *b, size_t nbytes);
 
-#endif
\ No newline at end of file
+#endif
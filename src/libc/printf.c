@@ -0,0 +1,172 @@
+// @desc     Formatted output
+// @author   Davide Della Giustina
+// @date     19/10/2026
+
+#include "printf.h"
+
+#define FLAG_LEFT           0x1 // Pad on the right
+#define FLAG_ZERO           0x2 // Pad with zeros
+#define FLAG_SIGNED         0x4 // Conversion of a signed integer
+#define FLAG_UPPER          0x8 // Upper case hex digits
+
+// Private functions
+
+static void format_number(strbuf_t *sb, uint64_t n, uint32_t base, uint8_t flags, uint32_t width);
+static void pad(strbuf_t *sb, char c, uint32_t n);
+
+// Public functions
+
+/* Format a string into a buffer.
+ * @param buf           Buffer.
+ * @param size          Size of the buffer (at least 1); the output is truncated to fit, and always terminated.
+ * @param fmt           Format string.
+ * @param args          Arguments.
+ * @return              Length of the formatted (possibly truncated) string.
+ */
+int vsnprintf(char *buf, size_t size, const char *fmt, va_list args) {
+    strbuf_t sb;
+    strbuf_init(&sb, buf, size);
+    while (*fmt != '\0') {
+        const char *start = fmt;
+        while (*fmt != '\0' && *fmt != '%') ++fmt;
+        strbuf_append_n(&sb, start, fmt - start); // Literal text, in one go
+        if (*fmt == '\0') break;
+        ++fmt;
+        // Flags and width
+        uint8_t flags = 0, longs = 0;
+        uint32_t width = 0;
+        for (;; ++fmt) {
+            if (*fmt == '-') flags |= FLAG_LEFT;
+            else if (*fmt == '0') flags |= FLAG_ZERO;
+            else break;
+        }
+        if (*fmt == '*') {
+            int w = va_arg(args, int);
+            if (w < 0) {
+                flags |= FLAG_LEFT;
+                w = -w;
+            }
+            width = w;
+            ++fmt;
+        } else {
+            while (*fmt >= '0' && *fmt <= '9') width = width * 10 + (*fmt++ - '0');
+        }
+        while (*fmt == 'l') {
+            ++longs;
+            ++fmt;
+        }
+        // Conversion
+        uint64_t n;
+        switch (*fmt) {
+            case 'd':
+            case 'i':
+                n = (longs > 1)? (uint64_t)va_arg(args, int64_t) : (uint64_t)(int64_t)va_arg(args, int32_t);
+                format_number(&sb, n, 10, flags | FLAG_SIGNED, width);
+                break;
+            case 'u':
+                n = (longs > 1)? va_arg(args, uint64_t) : va_arg(args, uint32_t);
+                format_number(&sb, n, 10, flags, width);
+                break;
+            case 'X':
+                flags |= FLAG_UPPER; // Fall through
+            case 'x':
+                n = (longs > 1)? va_arg(args, uint64_t) : va_arg(args, uint32_t);
+                format_number(&sb, n, 16, flags, width);
+                break;
+            case 'p':
+                strbuf_append(&sb, "0x");
+                format_number(&sb, (uintptr_t)va_arg(args, void *), 16, FLAG_ZERO, 2 * sizeof(void *));
+                break;
+            case 'c':
+                if (!(flags & FLAG_LEFT)) pad(&sb, ' ', (width > 1)? width - 1 : 0);
+                strbuf_putc(&sb, (char)va_arg(args, int));
+                if (flags & FLAG_LEFT) pad(&sb, ' ', (width > 1)? width - 1 : 0);
+                break;
+            case 's': {
+                const char *s = va_arg(args, const char *);
+                if (s == NULL) s = "(null)";
+                uint32_t len = strnlen(s, sb.size);
+                if (!(flags & FLAG_LEFT)) pad(&sb, ' ', (width > len)? width - len : 0);
+                strbuf_append_n(&sb, s, len);
+                if (flags & FLAG_LEFT) pad(&sb, ' ', (width > len)? width - len : 0);
+                break;
+            }
+            case '%':
+                strbuf_putc(&sb, '%');
+                break;
+            case '\0': // Dangling '%'
+                --fmt;
+                break;
+            default: // Unknown conversion: print it as is
+                strbuf_putc(&sb, '%');
+                strbuf_putc(&sb, *fmt);
+        }
+        ++fmt;
+    }
+    return sb.len;
+}
+
+/* Format a string into a buffer.
+ * @param buf           Buffer.
+ * @param size          Size of the buffer (at least 1); the output is truncated to fit, and always terminated.
+ * @param fmt           Format string.
+ * @return              Length of the formatted (possibly truncated) string.
+ */
+int snprintf(char *buf, size_t size, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int len = vsnprintf(buf, size, fmt, args);
+    va_end(args);
+    return len;
+}
+
+/* Format a string and print it on the console with a single write.
+ * @param fmt           Format string.
+ * @return              Number of characters printed.
+ */
+int kprintf(const char *fmt, ...) {
+    char buf[KPRINTF_BUFFER_SIZE];
+    va_list args;
+    va_start(args, fmt);
+    int len = vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    kwrite(buf, len);
+    return len;
+}
+
+// Private functions
+
+/* Append an integer.
+ * @param sb            String builder.
+ * @param n             Integer (sign-extended to 64 bits if FLAG_SIGNED is set).
+ * @param base          Base (10 or 16).
+ * @param flags         Flags.
+ * @param width         Minimum width.
+ */
+static void format_number(strbuf_t *sb, uint64_t n, uint32_t base, uint8_t flags, uint32_t width) {
+    const char *digits = (flags & FLAG_UPPER)? "0123456789ABCDEF" : "0123456789abcdef";
+    char buf[24];
+    uint32_t i = sizeof(buf), len;
+    uint8_t negative = (flags & FLAG_SIGNED) && (int64_t)n < 0;
+    if (negative) n = -n;
+    do {
+        buf[--i] = digits[(base == 16)? (uint32_t)n & 0xf : div_u64(&n, 10)];
+        if (base == 16) n >>= 4;
+    } while (n != 0);
+    len = sizeof(buf) - i + negative;
+    if (flags & FLAG_LEFT) flags &= ~FLAG_ZERO;
+    if (!(flags & (FLAG_LEFT | FLAG_ZERO))) pad(sb, ' ', (width > len)? width - len : 0);
+    if (negative) strbuf_putc(sb, '-');
+    if (flags & FLAG_ZERO) pad(sb, '0', (width > len)? width - len : 0);
+    strbuf_append_n(sb, buf + i, sizeof(buf) - i);
+    if (flags & FLAG_LEFT) pad(sb, ' ', (width > len)? width - len : 0);
+}
+
+/* Append a character several times.
+ * @param sb            String builder.
+ * @param c             Character.
+ * @param n             Number of times.
+ */
+static void pad(strbuf_t *sb, char c, uint32_t n) {
+    while (n-- > 0 && strbuf_putc(sb, c));
+}
@@ -0,0 +1,43 @@
+// @desc     Formatted output header
+// @author   Davide Della Giustina
+// @date     19/10/2026
+
+#ifndef PRINTF_H
+#define PRINTF_H
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "../drivers/vga.h"
+#include "math.h"
+#include "strbuf.h"
+
+#define KPRINTF_BUFFER_SIZE 256 // Longer kprintf() output is truncated
+
+// Supported conversions: %d %i %u %x %X %p %s %c %%, with the '-' (left-justify) and '0' (zero-pad) flags, a width
+// (a number or '*') and the 'l' and 'll' length modifiers (the latter for 64-bit integers).
+
+/* Format a string into a buffer.
+ * @param buf           Buffer.
+ * @param size          Size of the buffer (at least 1); the output is truncated to fit, and always terminated.
+ * @param fmt           Format string.
+ * @param args          Arguments.
+ * @return              Length of the formatted (possibly truncated) string.
+ */
+int vsnprintf(char *buf, size_t size, const char *fmt, va_list args);
+
+/* Format a string into a buffer.
+ * @param buf           Buffer.
+ * @param size          Size of the buffer (at least 1); the output is truncated to fit, and always terminated.
+ * @param fmt           Format string.
+ * @return              Length of the formatted (possibly truncated) string.
+ */
+int snprintf(char *buf, size_t size, const char *fmt, ...);
+
+/* Format a string and print it on the console with a single write.
+ * @param fmt           Format string.
+ * @return              Number of characters printed.
+ */
+int kprintf(const char *fmt, ...);
+
+#endif
@@ -0,0 +1,70 @@
+// @desc     String builder
+// @author   Davide Della Giustina
+// @date     19/10/2026
+
+#include "strbuf.h"
+
+/* Initialize an empty string builder over a buffer.
+ * @param sb            String builder.
+ * @param buf           Buffer.
+ * @param size          Size of the buffer (at least 1).
+ */
+void strbuf_init(strbuf_t *sb, char *buf, size_t size) {
+    sb->buf = buf;
+    sb->len = 0;
+    sb->size = size;
+    buf[0] = '\0';
+}
+
+/* Append the first #n characters of a string (or fewer, if there is no room for them).
+ * @param sb            String builder.
+ * @param str           String (need not be terminated).
+ * @param n             Number of characters.
+ * @return              Number of characters appended.
+ */
+size_t strbuf_append_n(strbuf_t *sb, const char *str, size_t n) {
+    size_t room = sb->size - 1 - sb->len;
+    if (n > room) n = room;
+    memcpy(sb->buf + sb->len, str, n);
+    sb->len += n;
+    sb->buf[sb->len] = '\0';
+    return n;
+}
+
+/* Append a string (or part of it, if there is no room for all of it).
+ * @param sb            String builder.
+ * @param str           String.
+ * @return              Number of characters appended.
+ */
+size_t strbuf_append(strbuf_t *sb, const char *str) {
+    return strbuf_append_n(sb, str, strnlen(str, sb->size - 1 - sb->len));
+}
+
+/* Append a character.
+ * @param sb            String builder.
+ * @param c             Character.
+ * @return              Zero if there was no room for it.
+ */
+uint8_t strbuf_putc(strbuf_t *sb, char c) {
+    if (sb->len + 1 >= sb->size) return 0;
+    sb->buf[sb->len++] = c;
+    sb->buf[sb->len] = '\0';
+    return 1;
+}
+
+/* Delete the last #n characters.
+ * @param sb            String builder.
+ * @param n             Number of characters to delete.
+ */
+void strbuf_truncate(strbuf_t *sb, size_t n) {
+    sb->len -= (n < sb->len)? n : sb->len;
+    sb->buf[sb->len] = '\0';
+}
+
+/* Delete all the characters.
+ * @param sb            String builder.
+ */
+void strbuf_clear(strbuf_t *sb) {
+    sb->len = 0;
+    sb->buf[0] = '\0';
+}
@@ -0,0 +1,60 @@
+// @desc     String builder header
+// @author   Davide Della Giustina
+// @date     19/10/2026
+
+#ifndef STRBUF_H
+#define STRBUF_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "mem.h"
+#include "string.h"
+
+// String built in a fixed-size buffer: the length is tracked, so appending never rescans the string
+typedef struct {
+    char *buf; // Always terminated
+    size_t len; // Length of the string
+    size_t size; // Size of the buffer (at least 1)
+} strbuf_t;
+
+/* Initialize an empty string builder over a buffer.
+ * @param sb            String builder.
+ * @param buf           Buffer.
+ * @param size          Size of the buffer (at least 1).
+ */
+void strbuf_init(strbuf_t *sb, char *buf, size_t size);
+
+/* Append the first #n characters of a string (or fewer, if there is no room for them).
+ * @param sb            String builder.
+ * @param str           String (need not be terminated).
+ * @param n             Number of characters.
+ * @return              Number of characters appended.
+ */
+size_t strbuf_append_n(strbuf_t *sb, const char *str, size_t n);
+
+/* Append a string (or part of it, if there is no room for all of it).
+ * @param sb            String builder.
+ * @param str           String.
+ * @return              Number of characters appended.
+ */
+size_t strbuf_append(strbuf_t *sb, const char *str);
+
+/* Append a character.
+ * @param sb            String builder.
+ * @param c             Character.
+ * @return              Zero if there was no room for it.
+ */
+uint8_t strbuf_putc(strbuf_t *sb, char c);
+
+/* Delete the last #n characters.
+ * @param sb            String builder.
+ * @param n             Number of characters to delete.
+ */
+void strbuf_truncate(strbuf_t *sb, size_t n);
+
+/* Delete all the characters.
+ * @param sb            String builder.
+ */
+void strbuf_clear(strbuf_t *sb);
+
+#endif
@@ -4,6 +4,14 @@
 
 #include "string.h"
 
+#define ONES                0x01010101 // 0x01 in every byte of a word
+#define HAS_ZERO(v)         (((v) - ONES) & ~(v) & (ONES << 7)) // Nonzero if any byte of word #v is zero
+
+typedef uint32_t __attribute__((may_alias)) str_word_t; // Word that may alias any other type
+
+// Strings are scanned a word at a time once the pointer is aligned: an aligned word never crosses a page boundary, so
+// reading past the terminator (but within its word) is always safe.
+
 /* Convert an integer value to an ASCII string.
  * @param n             Integer value.
  * @param str           String to put the value to.
@@ -45,8 +53,22 @@ int atoi(const char *str) {
  * @return              Length of the string.
  */
 int strlen(const char *str) {
-    int i = 0;
-    while (str[i] != '\0') ++i;
+    const char *p = str;
+    for (; (uintptr_t)p & 0x3; ++p)
+        if (*p == '\0') return p - str;
+    while (!HAS_ZERO(*(const str_word_t *)p)) p += 4;
+    while (*p != '\0') ++p;
+    return p - str;
+}
+
+/* Compute the length of a string, but look at no more than #max characters.
+ * @param str           String.
+ * @param max           Maximum number of characters to look at.
+ * @return              Length of the string, or #max if it is longer.
+ */
+size_t strnlen(const char *str, size_t max) {
+    size_t i = 0;
+    while (i < max && str[i] != '\0') ++i;
     return i;
 }
 
@@ -56,10 +78,18 @@ int strlen(const char *str) {
  * @return              Negative => str1 < str2, zero => str1 = str2, positive => str1 > str2.
  */
 int strcmp(const char *str1, const char *str2) {
-    int i;
-    for (i = 0; str1[i] == str2[i]; ++i)
-        if (str1[i] == '\0') return 0;
-    return (str1[i] - str2[i]);
+    const uint8_t *p = (const uint8_t *)str1, *q = (const uint8_t *)str2;
+    if ((((uintptr_t)p ^ (uintptr_t)q) & 0x3) == 0) { // Same alignment: compare a word at a time
+        for (; (uintptr_t)p & 0x3; ++p, ++q)
+            if (*p != *q || *p == '\0') return (*p - *q);
+        while (*(const str_word_t *)p == *(const str_word_t *)q && !HAS_ZERO(*(const str_word_t *)p)) {
+            p += 4;
+            q += 4;
+        }
+    }
+    for (; *p == *q; ++p, ++q)
+        if (*p == '\0') return 0;
+    return (*p - *q);
 }
 
 /* Compare two strings until a certain character (position #n).
@@ -75,6 +105,25 @@ int strncmp(const char *str1, const char *str2, int n) {
     return (str1[i] - str2[i]);
 }
 
+/* Find the first occurrence of a character in a string.
+ * @param str           String.
+ * @param c             Character (may be the terminator).
+ * @return              Pointer to the character, NULL if not found.
+ */
+char *strchr(const char *str, int c) {
+    const uint8_t *p = (const uint8_t *)str;
+    uint8_t ch = (uint8_t)c;
+    for (; (uintptr_t)p & 0x3; ++p) {
+        if (*p == ch) return (char *)p;
+        if (*p == '\0') return NULL;
+    }
+    uint32_t pattern = ch * ONES;
+    while (!HAS_ZERO(*(const str_word_t *)p) && !HAS_ZERO(*(const str_word_t *)p ^ pattern)) p += 4;
+    for (; *p != ch; ++p)
+        if (*p == '\0') return NULL;
+    return (char *)p;
+}
+
 /* Copy string #src to #dst.
  * @param src           Source string.
  * @param dst           Destination string.
@@ -129,6 +178,34 @@ char *strncat(char *dst, const char *src, int n) {
     return dst;
 }
 
+/* Copy string #src to a buffer of #size bytes, truncating it if needed (the result is always terminated).
+ * @param dst           Destination buffer.
+ * @param src           Source string.
+ * @param size          Size of the destination buffer.
+ * @return              Length of #src (truncation happened if not less than #size).
+ */
+size_t strlcpy(char *dst, const char *src, size_t size) {
+    size_t len = strlen(src);
+    if (size > 0) {
+        size_t n = (len < size)? len : size - 1;
+        memcpy(dst, src, n);
+        dst[n] = '\0';
+    }
+    return len;
+}
+
+/* Append string #src to the string in a buffer of #size bytes, truncating it if needed (the result is always terminated).
+ * @param dst           Destination buffer.
+ * @param src           String to be appended.
+ * @param size          Size of the destination buffer.
+ * @return              Length of the string it tried to create (truncation happened if not less than #size).
+ */
+size_t strlcat(char *dst, const char *src, size_t size) {
+    size_t len = strnlen(dst, size);
+    if (len == size) return size + strlen(src); // Not terminated: nothing can be appended
+    return len + strlcpy(dst + len, src, size - len);
+}
+
 /* Reverse a string.
  * @param str           String to reverse.
  * @return              Pointer to #str.
@@ -5,7 +5,9 @@
 #ifndef STRINGS_H
 #define STRINGS_H
 
+#include <stddef.h>
 #include <stdint.h>
+#include "mem.h"
 
 /* Convert an integer value to an ASCII string.
  * @param n             Integer value.
@@ -27,6 +29,13 @@ int atoi(const char *str);
  */
 int strlen(const char *str);
 
+/* Compute the length of a string, but look at no more than #max characters.
+ * @param str           String.
+ * @param max           Maximum number of characters to look at.
+ * @return              Length of the string, or #max if it is longer.
+ */
+size_t strnlen(const char *str, size_t max);
+
 /* Compare two strings.
  * @param str1          First string.
  * @param str2          Second string.
@@ -42,6 +51,13 @@ int strcmp(const char *str1, const char *str2);
  */
 int strncmp(const char *str1, const char *str2, int n);
 
+/* Find the first occurrence of a character in a string.
+ * @param str           String.
+ * @param c             Character (may be the terminator).
+ * @return              Pointer to the character, NULL if not found.
+ */
+char *strchr(const char *str, int c);
+
 /* Copy string #src to #dst.
  * @param src           Source string.
  * @param dst           Destination string.
@@ -72,6 +88,22 @@ char *strcat(char *dst, const char *src);
  */
 char *strncat(char *dst, const char *src, int n);
 
+/* Copy string #src to a buffer of #size bytes, truncating it if needed (the result is always terminated).
+ * @param dst           Destination buffer.
+ * @param src           Source string.
+ * @param size          Size of the destination buffer.
+ * @return              Length of #src (truncation happened if not less than #size).
+ */
+size_t strlcpy(char *dst, const char *src, size_t size);
+
+/* Append string #src to the string in a buffer of #size bytes, truncating it if needed (the result is always terminated).
+ * @param dst           Destination buffer.
+ * @param src           String to be appended.
+ * @param size          Size of the destination buffer.
+ * @return              Length of the string it tried to create (truncation happened if not less than #size).
+ */
+size_t strlcat(char *dst, const char *src, size_t size);
+
 /* Reverse a string.
  * @param str           String to reverse.
  * @return              Pointer to #str.
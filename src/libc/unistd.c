@@ -0,0 +1,52 @@
+// @desc     System calls (user space)
+// @author   Davide Della Giustina
+// @date     19/10/2026
+
+#include "unistd.h"
+
+// Private functions
+
+static uint32_t syscall(uint32_t n, uint32_t a, uint32_t b, uint32_t c);
+
+// Public functions
+
+/* Write to a file (only the console is supported: stdout and stderr).
+ * @param fd            File descriptor.
+ * @param buf           Data to write.
+ * @param count         Number of bytes.
+ * @return              Number of bytes written, -1 on error.
+ */
+int write(int fd, const void *buf, size_t count) {
+    return (int)syscall(SYS_WRITE, (uint32_t)fd, (uint32_t)buf, (uint32_t)count);
+}
+
+/* Set the program break of the calling process.
+ * @param addr          New program break.
+ * @return              0 on success, -1 on error.
+ */
+int brk(void *addr) {
+    return (int)syscall(SYS_BRK, (uint32_t)addr, 0, 0);
+}
+
+/* Move the program break of the calling process.
+ * @param incr          Number of bytes to add to the heap (negative to shrink it).
+ * @return              Previous program break, (void *)-1 on error.
+ */
+void *sbrk(int incr) {
+    return (void *)syscall(SYS_SBRK, (uint32_t)incr, 0, 0);
+}
+
+// Private functions
+
+/* Trap into the kernel.
+ * @param n             System call number.
+ * @param a             First argument.
+ * @param b             Second argument.
+ * @param c             Third argument.
+ * @return              Result of the system call.
+ */
+static uint32_t syscall(uint32_t n, uint32_t a, uint32_t b, uint32_t c) {
+    uint32_t result;
+    asm volatile("int $0x80" : "=a" (result) : "a" (n), "b" (a), "c" (b), "d" (c) : "memory");
+    return result;
+}
@@ -0,0 +1,39 @@
+// @desc     System calls header (user space)
+// @author   Davide Della Giustina
+// @date     19/10/2026
+
+#ifndef UNISTD_H
+#define UNISTD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// System call numbers (passed in eax, arguments in ebx, ecx, edx, result in eax)
+#define SYS_WRITE           1
+#define SYS_BRK             2
+#define SYS_SBRK            3
+
+#define STDOUT_FILENO       1
+#define STDERR_FILENO       2
+
+/* Write to a file (only the console is supported: stdout and stderr).
+ * @param fd            File descriptor.
+ * @param buf           Data to write.
+ * @param count         Number of bytes.
+ * @return              Number of bytes written, -1 on error.
+ */
+int write(int fd, const void *buf, size_t count);
+
+/* Set the program break of the calling process.
+ * @param addr          New program break.
+ * @return              0 on success, -1 on error.
+ */
+int brk(void *addr);
+
+/* Move the program break of the calling process.
+ * @param incr          Number of bytes to add to the heap (negative to shrink it).
+ * @return              Previous program break, (void *)-1 on error.
+ */
+void *sbrk(int incr);
+
+#endif